@@ -1,548 +1,8377 @@
-#include <iostream>
-#include <fstream>
-#include <string>
-#include <vector>
-#include <algorithm>
-#include <iomanip>
-#include <ctime>
-#include <limits>
-#include <sstream>
-
-using namespace std;
-
-/**
- * @brief Represents an item in the inventory.
- */
-struct Item {
-    int id;                 ///< Unique ID of the item
-    string name;            ///< Name of the item
-    string size_color;      ///< Size or Color variant
-    int quantity;           ///< Current stock quantity
-    double purchase_price;  ///< Cost price
-    double selling_price;   ///< Selling price
-};
-
-/**
- * @brief Represents a sales record.
- */
-struct Sale {
-    int id;                 ///< Unique ID of the sale
-    int item_id;            ///< ID of the item sold
-    string item_name;       ///< Name of the item sold (snapshot)
-    int quantity_sold;      ///< Quantity sold
-    double profit;          ///< Profit made from this sale
-    string date_sold;       ///< Timestamp of the sale
-};
-
-// Global In-Memory Storage
-vector<Item> items; ///< Global list of inventory items
-vector<Sale> sales; ///< Global list of sales records
-int nextItemId = 1; ///< Auto-increment counter for Item IDs
-int nextSaleId = 1; ///< Auto-increment counter for Sale IDs
-
-// Files
-const string ITEMS_FILE = "items.csv";
-const string SALES_FILE = "sales.csv";
-
-// Helper utilities
-static inline string trim(const string &s) {
-    size_t start = s.find_first_not_of(" \t\n\r");
-    if (start == string::npos) return "";
-    size_t end = s.find_last_not_of(" \t\n\r");
-    return s.substr(start, end - start + 1);
-}
-
-static inline string toLowerStr(string s) {
-    transform(s.begin(), s.end(), s.begin(), [](unsigned char c){ return tolower(c); });
-    return s;
-}
-
-static inline bool isCancel(const string &s) {
-    string t = toLowerStr(trim(s));
-    return (t == "cancel" || t == "c");
-}
-
-static inline bool toInt(const string &s, int &out) {
-    try {
-        size_t idx;
-        long v = stol(trim(s), &idx);
-        if (idx != trim(s).size()) return false;
-        out = static_cast<int>(v);
-        return true;
-    } catch (...) { return false; }
-}
-
-static inline bool toDouble(const string &s, double &out) {
-    try {
-        size_t idx;
-        double v = stod(trim(s), &idx);
-        if (idx != trim(s).size()) return false;
-        out = v;
-        return true;
-    } catch (...) { return false; }
-}
-
-static inline string promptLine(const string &msg) {
-    string s;
-    cout << msg;
-    if (!getline(cin, s)) return string();
-    return s;
-}
-
-static string getCurrentDate() {
-    time_t now = time(0);
-    tm *ltm = localtime(&now);
-    stringstream ss;
-    ss << 1900 + ltm->tm_year << "-"
-       << setfill('0') << setw(2) << 1 + ltm->tm_mon << "-"
-       << setw(2) << ltm->tm_mday << " "
-       << setw(2) << ltm->tm_hour << ":"
-       << setw(2) << ltm->tm_min << ":"
-       << setw(2) << ltm->tm_sec;
-    return ss.str();
-}
-
-/* ================= CORE LOGIC FUNCTIONS (TESTABLE) ================= */
-
-/**
- * @brief Adds a new item to the inventory.
- * 
- * @param name Name of the item.
- * @param size Size or color description.
- * @param qty Initial quantity.
- * @param buy Purchase price.
- * @param sell Selling price.
- * @return int The ID of the newly added item.
- */
-int logic_addItem(string name, string size, int qty, double buy, double sell) {
-    int id = nextItemId++;
-    items.push_back({id, name, size, qty, buy, sell});
-    return id;
-}
-
-/**
- * @brief Deletes an item by ID.
- * 
- * @param id The ID of the item to delete.
- * @return true If item was found and deleted.
- * @return false If item was not found.
- */
-bool logic_deleteItem(int id) {
-    auto it = find_if(items.begin(), items.end(), [id](const Item& item) { return item.id == id; });
-    if (it != items.end()) {
-        items.erase(it);
-        return true;
-    }
-    return false;
-}
-
-/**
- * @brief Updates an existing item.
- * 
- * @param id The ID of the item to update.
- * @param qty New quantity.
- * @param buy New purchase price.
- * @param sell New selling price.
- * @return true If update was successful.
- * @return false If item was not found.
- */
-bool logic_updateItem(int id, int qty, double buy, double sell) {
-    auto it = find_if(items.begin(), items.end(), [id](const Item& item) { return item.id == id; });
-    if (it != items.end()) {
-        it->quantity = qty;
-        it->purchase_price = buy;
-        it->selling_price = sell;
-        return true;
-    }
-    return false;
-}
-
-/**
- * @brief Processes a sale transaction.
- * 
- * @param id The ID of the item to sell.
- * @param qty The quantity to sell.
- * @param profitOut Output parameter to store the calculated profit.
- * @return int 0 = Success, 1 = Item not found, 2 = Not enough stock.
- */
-int logic_sellItem(int id, int qty, double& profitOut) {
-    auto it = find_if(items.begin(), items.end(), [id](const Item& item) { return item.id == id; });
-    if (it == items.end()) return 1; // Not found
-
-    if (qty > it->quantity) return 2; // Not enough stock
-
-    double profit = (it->selling_price - it->purchase_price) * qty;
-    it->quantity -= qty;
-    
-    // Record sale
-    sales.push_back({nextSaleId++, it->id, it->name, qty, profit, getCurrentDate()});
-    
-    profitOut = profit;
-    return 0; // Success
-}
-
-/* ================= FILE PERSISTENCE ================= */
-
-/**
- * @brief Saves all items and sales to CSV files.
- */
-void saveData() {
-    // Save Items
-    ofstream itemFile(ITEMS_FILE);
-    if (itemFile.is_open()) {
-        for (const auto& item : items) {
-            itemFile << item.id << "," 
-                     << item.name << "," 
-                     << item.size_color << "," 
-                     << item.quantity << "," 
-                     << item.purchase_price << "," 
-                     << item.selling_price << "\n";
-        }
-        itemFile.close();
-        cout << " [Saved] Items to " << ITEMS_FILE << endl;
-    } else {
-        cout << " [Error] Could not save items!\n";
-    }
-
-    // Save Sales
-    ofstream saleFile(SALES_FILE);
-    if (saleFile.is_open()) {
-        for (const auto& sale : sales) {
-            saleFile << sale.id << "," 
-                     << sale.item_id << "," 
-                     << sale.item_name << "," 
-                     << sale.quantity_sold << "," 
-                     << sale.profit << "," 
-                     << sale.date_sold << "\n";
-        }
-        saleFile.close();
-        cout << " [Saved] Sales to " << SALES_FILE << endl;
-    } else {
-        cout << " [Error] Could not save sales!\n";
-    }
-}
-
-// Helper to parse CSV line
-vector<string> parseCSV(string line) {
-    vector<string> result;
-    stringstream ss(line);
-    string item;
-    while (getline(ss, item, ',')) {
-        result.push_back(item);
-    }
-    return result;
-}
-
-/**
- * @brief Seeds the database with default data if empty.
- */
-void seedData() {
-    items.push_back({nextItemId++, "Widget", "Small", 10, 5.0, 8.0});
-    items.push_back({nextItemId++, "Bolt", "Red", 3, 0.5, 1.0});
-    items.push_back({nextItemId++, "Gadget", "Blue", 20, 10.0, 15.0});
-    cout << " [Info] No previous data found. Seeded default items.\n";
-}
-
-/**
- * @brief Loads data from CSV files into memory.
- */
-void loadData() {
-    items.clear();
-    sales.clear();
-    nextItemId = 1;
-    nextSaleId = 1;
-
-    // Load Items
-    ifstream itemFile(ITEMS_FILE);
-    if (itemFile.is_open()) {
-        string line;
-        while (getline(itemFile, line)) {
-            if (trim(line).empty()) continue;
-            vector<string> data = parseCSV(line);
-            if (data.size() >= 6) {
-                Item it;
-                it.id = stoi(data[0]);
-                it.name = data[1];
-                it.size_color = data[2];
-                it.quantity = stoi(data[3]);
-                it.purchase_price = stod(data[4]);
-                it.selling_price = stod(data[5]);
-                items.push_back(it);
-                if (it.id >= nextItemId) nextItemId = it.id + 1;
-            }
-        }
-        itemFile.close();
-        cout << " [Loaded] " << items.size() << " items.\n";
-    }
-
-    // Load Sales
-    ifstream saleFile(SALES_FILE);
-    if (saleFile.is_open()) {
-        string line;
-        while (getline(saleFile, line)) {
-            if (trim(line).empty()) continue;
-            vector<string> data = parseCSV(line);
-            if (data.size() >= 6) {
-                Sale s;
-                s.id = stoi(data[0]);
-                s.item_id = stoi(data[1]);
-                s.item_name = data[2];
-                s.quantity_sold = stoi(data[3]);
-                s.profit = stod(data[4]);
-                s.date_sold = data[5]; 
-                sales.push_back(s);
-                if (s.id >= nextSaleId) nextSaleId = s.id + 1;
-            }
-        }
-        saleFile.close();
-        cout << " [Loaded] " << sales.size() << " sales records.\n";
-    }
-
-    if (items.empty() && sales.empty()) {
-        seedData();
-    }
-}
-
-/* ================= UI FUNCTIONS ================= */
-
-void ui_addItem() {
-    string name, size, line;
-    int qty;
-    double buy, sell;
-
-    cin.ignore(numeric_limits<streamsize>::max(), '\n');
-
-    name = promptLine("Item name (or type 'cancel' to return): ");
-    if (isCancel(name) || trim(name).empty()) { cout << "Cancelled.\n"; return; }
-    replace(name.begin(), name.end(), ',', ' ');
-
-    size = promptLine("Size/Color (or type 'cancel' to return): ");
-    if (isCancel(size)) { cout << "Cancelled.\n"; return; }
-    replace(size.begin(), size.end(), ',', ' ');
-
-    line = promptLine("Quantity (or type 'cancel' to return): ");
-    if (isCancel(line) || !toInt(line, qty)) { cout << "Cancelled or invalid quantity.\n"; return; }
-
-    line = promptLine("Purchase price (or type 'cancel' to return): ");
-    if (isCancel(line) || !toDouble(line, buy)) { cout << "Cancelled or invalid purchase price.\n"; return; }
-
-    line = promptLine("Selling price (or type 'cancel' to return): ");
-    if (isCancel(line) || !toDouble(line, sell)) { cout << "Cancelled or invalid selling price.\n"; return; }
-
-    int newId = logic_addItem(name, size, qty, buy, sell);
-    cout << "Item added successfully! Assigned ID: " << newId << "\n";
-}
-
-void ui_updateItem() {
-    string line;
-    int id, qty;
-    double buy, sell;
-
-    cin.ignore(numeric_limits<streamsize>::max(), '\n');
-
-    line = promptLine("Item ID (or type 'cancel' to return): ");
-    if (isCancel(line) || !toInt(line, id)) { cout << "Cancelled or invalid ID.\n"; return; }
-
-    // Check existence visually first (optional, logic handles it too)
-    // Here we just ask for data then call logic
-    
-    line = promptLine("New quantity (or type 'cancel' to return): ");
-    if (isCancel(line) || !toInt(line, qty)) { cout << "Cancelled or invalid quantity.\n"; return; }
-
-    line = promptLine("New purchase price (or type 'cancel' to return): ");
-    if (isCancel(line) || !toDouble(line, buy)) { cout << "Cancelled or invalid purchase price.\n"; return; }
-
-    line = promptLine("New selling price (or type 'cancel' to return): ");
-    if (isCancel(line) || !toDouble(line, sell)) { cout << "Cancelled or invalid selling price.\n"; return; }
-
-    if (logic_updateItem(id, qty, buy, sell)) {
-        cout << "Item updated!\n";
-    } else {
-        cout << "Item not found.\n";
-    }
-}
-
-void ui_searchItem() {
-    string key;
-    cin.ignore(numeric_limits<streamsize>::max(), '\n');
-    key = promptLine("Search name (or type 'cancel' to return): ");
-    if (isCancel(key) || trim(key).empty()) { cout << "Cancelled.\n"; return; }
-
-    string lowerKey = toLowerStr(key);
-    cout << "\n--- SEARCH RESULTS ---\n";
-    bool found = false;
-    for (const auto& item : items) {
-        if (toLowerStr(item.name).find(lowerKey) != string::npos) {
-            cout << "ID: " << item.id
-                 << " | " << item.name
-                 << " | " << item.size_color
-                 << " | Qty: " << item.quantity
-                 << " | Buy: " << item.purchase_price
-                 << " | Sell: " << item.selling_price << endl;
-            found = true;
-        }
-    }
-    if (!found) cout << "No matches found.\n";
-}
-
-void ui_lowStock() {
-    string line = promptLine("Show low stock items? Press Enter to continue or type 'cancel' to return: ");
-    if (isCancel(line)) { cout << "Cancelled.\n"; return; }
-
-    cout << "\n--- LOW STOCK ITEMS ---\n";
-    bool found = false;
-    for (const auto& item : items) {
-        if (item.quantity <= 5) {
-            cout << item.name << " | Qty: " << item.quantity << " ⚠️\n";
-            found = true;
-        }
-    }
-    if (!found) cout << "No low stock items.\n";
-
-    promptLine("Press Enter to return to menu...");
-}
-
-void ui_sellItem() {
-    string line;
-    int id, qty;
-
-    cin.ignore(numeric_limits<streamsize>::max(), '\n');
-
-    line = promptLine("Item ID (or type 'cancel' to return): ");
-    if (isCancel(line) || !toInt(line, id)) { cout << "Cancelled or invalid ID.\n"; return; }
-
-    line = promptLine("Quantity sold (or type 'cancel' to return): ");
-    if (isCancel(line) || !toInt(line, qty)) { cout << "Cancelled or invalid quantity.\n"; return; }
-
-    double profit = 0.0;
-    int result = logic_sellItem(id, qty, profit);
-
-    if (result == 0) {
-        cout << "Item sold! Profit: " << profit << endl;
-    } else if (result == 1) {
-        cout << "Item not found!\n";
-    } else if (result == 2) {
-        cout << "Not enough stock!\n";
-    }
-}
-
-void ui_salesHistory() {
-    string line = promptLine("Show sales history? Press Enter to continue or type 'cancel' to return: ");
-    if (isCancel(line)) { cout << "Cancelled.\n"; return; }
-
-    cout << "\n--- SALES HISTORY ---\n";
-    if (sales.empty()) {
-        cout << "No sales recorded yet.\n";
-    } else {
-        for (auto it = sales.rbegin(); it != sales.rend(); ++it) {
-            cout << "SaleID: " << it->id
-                 << " | " << it->item_name
-                 << " | Qty: " << it->quantity_sold
-                 << " | Profit: " << it->profit
-                 << " | Date: " << it->date_sold << endl;
-        }
-    }
-
-    promptLine("Press Enter to return to menu...");
-}
-
-void ui_listItems() {
-    cout << "\n--- ITEM LIST ---\n";
-    if (items.empty()) {
-        cout << "No items in inventory.\n";
-    } else {
-        for (const auto& item : items) {
-            cout << "ID: " << item.id
-                 << " | " << item.name
-                 << " | " << item.size_color
-                 << " | Qty: " << item.quantity
-                 << " | Buy: " << item.purchase_price
-                 << " | Sell: " << item.selling_price << endl;
-        }
-    }
-    promptLine("Press Enter to return to menu...");
-}
-
-void ui_checkConnection() {
-    cout << "\nChecking database connection...\n";
-    cout << " [OK] Application memory initialized.\n";
-    cout << " [OK] Item storage active (" << items.size() << " items).\n";
-    cout << " [OK] Sales storage active (" << sales.size() << " records).\n";
-    cout << "Database connection is HEALTHY (Local Mode).\n";
-    promptLine("Press Enter to return to menu...");
-}
-
-void ui_deleteItem() {
-    string line;
-    int id;
-
-    cin.ignore(numeric_limits<streamsize>::max(), '\n');
-
-    line = promptLine("Item ID to DELETE (or type 'cancel' to return): ");
-    if (isCancel(line) || !toInt(line, id)) { cout << "Cancelled or invalid ID.\n"; return; }
-
-    // Check existence first to show details before deleting
-    auto it = find_if(items.begin(), items.end(), [id](const Item& item) { return item.id == id; });
-    if (it == items.end()) {
-        cout << "Item not found.\n";
-        return;
-    }
-
-    cout << "Deleting Item: " << it->name << " (Qty: " << it->quantity << ")\n";
-    string confirm = promptLine("Are you sure? (y/n): ");
-    if (toLowerStr(trim(confirm)) != "y") {
-        cout << "Deletion cancelled.\n";
-        return;
-    }
-
-    if (logic_deleteItem(id)) {
-        cout << "Item deleted successfully.\n";
-    } else {
-        cout << "Error deleting item.\n";
-    }
-}
-
-/* ================= MAIN MENU ================= */
-
-#ifndef UNIT_TEST
-int main() {
-    cout << "Running in STANDALONE mode (In-Memory + CSV Persistence)\n";
-    loadData();
-
-    int choice;
-    do {
-        cout << "\n===== INVENTORY MANAGER (Local Storage) =====\n";
-        cout << "1. Add Item\n";
-        cout << "2. Update Item\n";
-        cout << "3. Delete Item\n";
-        cout << "4. Search Item\n";
-        cout << "5. Low Stock Alert\n";
-        cout << "6. Sell Item\n";
-        cout << "7. Sales History\n";
-        cout << "8. List All Items\n";
-        cout << "9. Check System Status\n";
-        cout << "10. Save & Exit\n";
-        cout << "Choice: ";
-        if (!(cin >> choice)) {
-            cin.clear();
-            cin.ignore(numeric_limits<streamsize>::max(), '\n');
-            choice = 0;
-        }
-
-        switch (choice) {
-        case 1: ui_addItem(); break;
-        case 2: ui_updateItem(); break;
-        case 3: ui_deleteItem(); break;
-        case 4: ui_searchItem(); break;
-        case 5: ui_lowStock(); break;
-        case 6: ui_sellItem(); break;
-        case 7: ui_salesHistory(); break;
-        case 8: ui_listItems(); break;
-        case 9: ui_checkConnection(); break;
-        case 10: saveData(); break;
-        }
-    } while (choice != 10);
-
-    return 0;
-}
-#endif
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <iomanip>
+#include <ctime>
+#include <limits>
+#include <sstream>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <condition_variable>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <stdexcept>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <string_view>
+#include <unordered_set>
+#include <unordered_map>
+#include <memory_resource>
+#include <cstdlib>
+#include <new>
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <charconv>
+#include <tuple>
+#include <type_traits>
+#include <random>
+#include <csignal>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <pthread.h>
+#include <sched.h>
+#endif
+#ifdef _WIN32
+#include <io.h>
+#endif
+
+using namespace std;
+
+/// Offset of a string in a store's cold string heap (see StringPool).
+using StrRef = uint32_t;
+
+/**
+ * @brief Represents an item in the inventory.
+ *
+ * Only the fields a sale or a stock scan touches live in the record; the text
+ * sits in the owning store's string heap. 32-byte alignment packs exactly two
+ * records per cache line without straddling.
+ */
+struct alignas(32) Item {
+    int32_t id;             ///< Unique ID of the item
+    int32_t quantity;       ///< Current stock quantity
+    double purchase_price;  ///< Cost price
+    double selling_price;   ///< Selling price
+    StrRef name;            ///< Name of the item (offset into the owning store's strings)
+    StrRef size_color;      ///< Size or Color variant (offset)
+};
+static_assert(sizeof(Item) == 32, "Item must stay one half cache line");
+
+/**
+ * @brief Represents a sales record.
+ */
+struct Sale {
+    int id;                 ///< Unique ID of the sale
+    int item_id;            ///< ID of the item sold
+    string_view item_name;  ///< Name of the item sold (snapshot, interned)
+    int quantity_sold;      ///< Quantity sold
+    double profit;          ///< Profit made from this sale
+    char date_sold[20];     ///< Timestamp of the sale, "YYYY-MM-DD HH:MM:SS"
+};
+
+/**
+ * @brief Interned copies of the names and variants used by a store: the cold
+ * string heap behind Item::name and Item::size_color.
+ *
+ * Each distinct text is stored once, as a u32 length followed by the bytes,
+ * in 64 KB chunks that never move. A StrRef is chunk << 16 | position; text
+ * longer than a chunk gets a chunk of its own. Items and their sales share
+ * the text, so recording a sale never copies or allocates a string. Refs and
+ * views stay valid until clear().
+ */
+struct StringPool {
+    static constexpr size_t CHUNK_BYTES = 1 << 16;
+
+    struct Chunk {
+        char* data;
+        size_t size;
+        size_t used;
+    };
+
+    pmr::memory_resource* resource;
+    pmr::vector<Chunk> chunks;                     ///< Owns the text
+    pmr::unordered_map<string_view, StrRef> index; ///< Views into chunks, for lookup
+
+    explicit StringPool(pmr::memory_resource* mr) : resource(mr), chunks(mr), index(mr) {}
+    ~StringPool() { clear(); }
+    StringPool(const StringPool&) = delete;
+    StringPool& operator=(const StringPool&) = delete;
+
+    StrRef intern(string_view text) {
+        auto found = index.find(text);
+        if (found != index.end()) return found->second;
+        size_t need = sizeof(uint32_t) + text.size();
+        if (chunks.empty() || chunks.back().size - chunks.back().used < need || chunks.back().size > CHUNK_BYTES) {
+            if (chunks.size() >= (1u << 16)) throw length_error("string heap full");
+            size_t size = max(need, CHUNK_BYTES);
+            chunks.push_back({static_cast<char*>(resource->allocate(size, alignof(uint32_t))), size, 0});
+        }
+        Chunk& chunk = chunks.back();
+        StrRef ref = static_cast<StrRef>((chunks.size() - 1) << 16 | chunk.used);
+        uint32_t length = static_cast<uint32_t>(text.size());
+        memcpy(chunk.data + chunk.used, &length, sizeof(length));
+        memcpy(chunk.data + chunk.used + sizeof(length), text.data(), text.size());
+        chunk.used += need;
+        index.emplace(string_view(chunk.data + chunk.used - text.size(), text.size()), ref);
+        return ref;
+    }
+
+    /// Interns and returns the stored copy, for records that keep a view (Sale).
+    string_view internView(string_view text) { return view(intern(text)); }
+
+    string_view view(StrRef ref) const {
+        const char* p = chunks[ref >> 16].data + (ref & 0xFFFF);
+        uint32_t length;
+        memcpy(&length, p, sizeof(length));
+        return string_view(p + sizeof(length), length);
+    }
+
+    size_t reservedBytes() const {
+        size_t bytes = 0;
+        for (const auto& chunk : chunks) bytes += chunk.size;
+        return bytes;
+    }
+
+    size_t usedBytes() const {
+        size_t bytes = 0;
+        for (const auto& chunk : chunks) bytes += chunk.used;
+        return bytes;
+    }
+
+    void clear() {
+        index.clear();
+        for (const auto& chunk : chunks) resource->deallocate(chunk.data, chunk.size, alignof(uint32_t));
+        chunks.clear();
+    }
+};
+
+/**
+ * @brief Memory resource that counts the bytes it obtains from the system.
+ */
+class CountingResource : public pmr::memory_resource {
+public:
+    size_t bytesInUse() const { return inUse_.load(memory_order_relaxed); }
+    size_t peakBytes() const { return peak_.load(memory_order_relaxed); }
+    size_t allocations() const { return allocations_.load(memory_order_relaxed); }  ///< Blocks obtained so far
+    /// Where blocks come from (new/delete by default). Only switch while nothing is allocated.
+    void setUpstream(pmr::memory_resource* upstream) { upstream_ = upstream; }
+private:
+    void* do_allocate(size_t bytes, size_t align) override {
+        void* p = upstream_->allocate(bytes, align);
+        // One thread allocates at a time; the atomics are for readers such as the status screen
+        allocations_.fetch_add(1, memory_order_relaxed);
+        size_t inUse = inUse_.fetch_add(bytes, memory_order_relaxed) + bytes;
+        if (inUse > peak_.load(memory_order_relaxed)) peak_.store(inUse, memory_order_relaxed);
+        return p;
+    }
+    void do_deallocate(void* p, size_t bytes, size_t align) override {
+        upstream_->deallocate(p, bytes, align);
+        inUse_.fetch_sub(bytes, memory_order_relaxed);
+    }
+    bool do_is_equal(const pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+    pmr::memory_resource* upstream_ = pmr::new_delete_resource();
+    atomic<size_t> inUse_{0};
+    atomic<size_t> peak_{0};
+    atomic<size_t> allocations_{0};
+};
+
+/**
+ * @brief Memory resource that backs large blocks with 2 MB pages.
+ *
+ * Blocks of at least LARGE_BLOCK bytes (the big tables: item and sale arrays,
+ * hash buckets, string heap growth) are mapped separately and marked with
+ * madvise(MADV_HUGEPAGE), so transparent huge pages can back them even when
+ * THP is in "madvise" mode. With prefault set, a background thread asks the
+ * kernel to populate each new block (MADV_POPULATE_WRITE) so first-touch page
+ * faults leave the load path; populating never changes contents, so it can run
+ * beside the thread filling the block. Small blocks, and every block on
+ * platforms without these calls, come from new/delete.
+ */
+class HugePageResource : public pmr::memory_resource {
+public:
+    static constexpr size_t PAGE_2M = 2 << 20;
+    static constexpr size_t LARGE_BLOCK = 1 << 20;
+
+    HugePageResource() {}
+    ~HugePageResource() override {
+        {
+            lock_guard<mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        if (worker_.joinable()) worker_.join();
+    }
+
+    /// Populate new large blocks in the background. Set before allocating.
+    void setPrefault(bool on) { prefault_ = on; }
+    size_t hugeBlocks() const { return hugeBlocks_; }        ///< Blocks mapped with MADV_HUGEPAGE
+    size_t prefaultedBytes() const { return prefaulted_; }   ///< Bytes populated by the background thread
+
+    /// Waits until every queued block has been populated.
+    void waitForPrefault() {
+        unique_lock<mutex> lock(mutex_);
+        idle_.wait(lock, [this]() { return queue_.empty() && !busy_; });
+    }
+
+private:
+    void* do_allocate(size_t bytes, size_t align) override {
+#ifdef __linux__
+        if (bytes >= LARGE_BLOCK && align <= PAGE_2M) {
+            size_t length = (bytes + PAGE_2M - 1) & ~(PAGE_2M - 1);
+            // Over-map by one huge page so the block can start on a 2 MB boundary
+            void* raw = mmap(nullptr, length + PAGE_2M, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (raw != MAP_FAILED) {
+                char* base = static_cast<char*>(raw);
+                char* aligned = reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(base) + PAGE_2M - 1) & ~(PAGE_2M - 1));
+                if (aligned > base) munmap(base, aligned - base);
+                size_t tail = (base + length + PAGE_2M) - (aligned + length);
+                if (tail) munmap(aligned + length, tail);
+                madvise(aligned, length, MADV_HUGEPAGE);
+                {
+                    lock_guard<mutex> lock(mutex_);
+                    mapped_.insert(aligned);
+                }
+                ++hugeBlocks_;
+                if (prefault_) enqueue(aligned, length);
+                return aligned;
+            }
+        }
+#endif
+        return pmr::new_delete_resource()->allocate(bytes, align);
+    }
+
+    void do_deallocate(void* p, size_t bytes, size_t align) override {
+#ifdef __linux__
+        // Large blocks came from new/delete too when mmap failed
+        if (bytes >= LARGE_BLOCK && align <= PAGE_2M) {
+            bool mapped;
+            {
+                lock_guard<mutex> lock(mutex_);
+                mapped = mapped_.erase(p) != 0;
+            }
+            if (mapped) {
+                munmap(p, (bytes + PAGE_2M - 1) & ~(PAGE_2M - 1));
+                return;
+            }
+        }
+#endif
+        pmr::new_delete_resource()->deallocate(p, bytes, align);
+    }
+
+    bool do_is_equal(const pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+#ifdef __linux__
+    void enqueue(void* p, size_t length) {
+        lock_guard<mutex> lock(mutex_);
+        queue_.push_back({p, length});
+        if (!worker_.joinable()) worker_ = thread([this]() { prefaultLoop(); });
+        wake_.notify_one();
+    }
+
+    void prefaultLoop() {
+#ifndef MADV_POPULATE_WRITE
+        const int MADV_POPULATE_WRITE = 23;  // Linux 5.14+
+#endif
+        unique_lock<mutex> lock(mutex_);
+        while (true) {
+            wake_.wait(lock, [this]() { return stop_ || !queue_.empty(); });
+            if (stop_) return;
+            pair<void*, size_t> block = queue_.front();
+            queue_.pop_front();
+            busy_ = true;
+            lock.unlock();
+            // A block freed meanwhile makes this fail harmlessly; older kernels reject the advice
+            if (madvise(block.first, block.second, MADV_POPULATE_WRITE) == 0) prefaulted_ += block.second;
+            lock.lock();
+            busy_ = false;
+            if (queue_.empty()) idle_.notify_all();
+        }
+    }
+#endif
+
+    bool prefault_ = false;
+    atomic<size_t> hugeBlocks_{0};
+    atomic<size_t> prefaulted_{0};
+    mutex mutex_;
+    condition_variable wake_, idle_;
+    deque<pair<void*, size_t>> queue_;
+    unordered_set<void*> mapped_;   ///< Blocks from mmap; the rest go back to new/delete
+    bool busy_ = false;
+    bool stop_ = false;
+    thread worker_;
+};
+
+HugePageResource hugePages; ///< Shared 2 MB page source for stores that opt in (--hugepages)
+
+/**
+ * @brief Finds key positions inside one B+tree node (at most 16 sorted keys).
+ *
+ * countLess() is the number of keys < k, countLessEqual() the number <= k.
+ * The int32 specialization compares four keys per SSE2 instruction.
+ */
+template <class Key, class Less>
+struct NodeSearch {
+    static int countLess(const Key* keys, int n, const Key& k, const Less& less) {
+        int i = 0;
+        while (i < n && less(keys[i], k)) ++i;
+        return i;
+    }
+    static int countLessEqual(const Key* keys, int n, const Key& k, const Less& less) {
+        int i = 0;
+        while (i < n && !less(k, keys[i])) ++i;
+        return i;
+    }
+};
+
+#ifdef __SSE2__
+template <>
+struct NodeSearch<int32_t, less<int32_t>> {
+    // Keys are sorted, so the matching lanes form a prefix and their count is the position
+    static int countMatching(const int32_t* keys, int n, int32_t k, bool orEqual) {
+        __m128i needle = _mm_set1_epi32(k);
+        unsigned mask = 0;
+        for (int i = 0; i < 16; i += 4) {
+            __m128i lane = _mm_load_si128(reinterpret_cast<const __m128i*>(keys + i));
+            __m128i hit = orEqual ? _mm_andnot_si128(_mm_cmpgt_epi32(lane, needle), _mm_set1_epi32(-1))
+                                  : _mm_cmplt_epi32(lane, needle);
+            mask |= static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps(hit))) << i;
+        }
+        mask &= (1u << n) - 1;
+        return __builtin_popcount(mask);
+    }
+    static int countLess(const int32_t* keys, int n, int32_t k, const less<int32_t>&) {
+        return countMatching(keys, n, k, false);
+    }
+    static int countLessEqual(const int32_t* keys, int n, int32_t k, const less<int32_t>&) {
+        return countMatching(keys, n, k, true);
+    }
+};
+#endif
+
+/**
+ * @brief In-memory B+tree mapping keys to int32 values (item IDs), for ordered
+ * iteration and range scans.
+ *
+ * Nodes hold up to 16 keys in a 64-byte-aligned array, so a search touches one
+ * or two cache lines per level; leaves are linked for range scans. Erase
+ * borrows from or merges with a sibling once a node drops below half full, so
+ * a tree stays as dense after deletes as after inserts. Bulk loading (used
+ * after loadData) rebuilds a compact tree. Nodes come from the memory
+ * resource given at construction.
+ */
+template <class Key, class Less = less<Key>>
+class BPlusTree {
+public:
+    static constexpr int FANOUT = 16;
+    static constexpr int MIN_KEYS = FANOUT / 2;  ///< Below this a non-root node borrows or merges
+
+    explicit BPlusTree(pmr::memory_resource* resource = pmr::get_default_resource()) : resource_(resource) {}
+    ~BPlusTree() { clear(); }
+    BPlusTree(const BPlusTree&) = delete;
+    BPlusTree& operator=(const BPlusTree&) = delete;
+
+    size_t size() const { return size_; }
+    size_t nodeBytes() const { return leaves_ * sizeof(Leaf) + inners_ * sizeof(Inner); }
+
+    void clear() {
+        if (root_) freeNode(root_, 0);
+        root_ = nullptr;
+        height_ = 0;
+        size_ = leaves_ = inners_ = 0;
+    }
+
+    /// Inserts a key, or replaces the value of an existing one.
+    void insert(const Key& key, int32_t value) {
+        if (!root_) {
+            root_ = newLeaf();
+            height_ = 1;
+        }
+        Key upKey;
+        void* upNode = nullptr;
+        if (insertInto(root_, 0, key, value, upKey, upNode)) {
+            Inner* root = newInner();
+            root->keys[0] = upKey;
+            root->children[0] = root_;
+            root->children[1] = upNode;
+            root->count = 1;
+            root_ = root;
+            ++height_;
+        }
+    }
+
+    bool erase(const Key& key) {
+        if (!root_) return false;
+        bool underfull = false;
+        if (!eraseFrom(root_, 0, key, underfull)) return false;
+        --size_;
+        // The root may shrink to one child (or, as a leaf, to nothing)
+        if (height_ > 1) {
+            Inner* root = static_cast<Inner*>(root_);
+            if (root->count == 0) {
+                root_ = root->children[0];
+                --height_;
+                deleteInner(root);
+            }
+        } else if (static_cast<Leaf*>(root_)->count == 0) {
+            deleteLeaf(static_cast<Leaf*>(root_));
+            root_ = nullptr;
+            height_ = 0;
+        }
+        return true;
+    }
+
+    /// Replaces the contents with already sorted, unique keys. Leaves are filled
+    /// to about 3/4 so later inserts rarely split; each level is spread evenly,
+    /// so no node is left with a single entry.
+    void bulkLoad(const vector<pair<Key, int32_t>>& sorted) {
+        clear();
+        if (sorted.empty()) return;
+        const size_t perLeaf = FANOUT * 3 / 4;
+        vector<pair<Key, void*>> level;  // (smallest key, node)
+        Leaf* prev = nullptr;
+        size_t leafCount = (sorted.size() + perLeaf - 1) / perLeaf;
+        for (size_t l = 0, i = 0; l < leafCount; ++l) {
+            Leaf* leaf = newLeaf();
+            size_t n = evenShare(sorted.size(), leafCount, l);
+            for (size_t j = 0; j < n; ++j) {
+                leaf->keys[j] = sorted[i + j].first;
+                leaf->values[j] = sorted[i + j].second;
+            }
+            leaf->count = static_cast<uint8_t>(n);
+            i += n;
+            if (prev) prev->next = leaf;
+            prev = leaf;
+            level.push_back({leaf->keys[0], leaf});
+        }
+        height_ = 1;
+        while (level.size() > 1) {
+            vector<pair<Key, void*>> parents;
+            size_t innerCount = (level.size() + FANOUT) / (FANOUT + 1);
+            for (size_t l = 0, i = 0; l < innerCount; ++l) {
+                Inner* inner = newInner();
+                size_t n = evenShare(level.size(), innerCount, l);
+                inner->children[0] = level[i].second;
+                for (size_t j = 1; j < n; ++j) {
+                    inner->keys[j - 1] = level[i + j].first;
+                    inner->children[j] = level[i + j].second;
+                }
+                inner->count = static_cast<uint8_t>(n - 1);
+                parents.push_back({level[i].first, inner});
+                i += n;
+            }
+            level.swap(parents);
+            ++height_;
+        }
+        root_ = level[0].second;
+        size_ = sorted.size();
+    }
+
+private:
+    struct alignas(64) Leaf {
+        Key keys[FANOUT];
+        int32_t values[FANOUT];
+        Leaf* next;
+        uint8_t count;
+    };
+
+public:
+    /**
+     * @brief Position in the leaf chain; next() steps through a leaf's arrays
+     * and follows the link at its end. Invalidated by any insert or erase.
+     */
+    class Cursor {
+    public:
+        bool valid() const { return leaf_ != nullptr; }
+        const Key& key() const { return leaf_->keys[pos_]; }
+        int32_t value() const { return leaf_->values[pos_]; }
+        void next() {
+            if (++pos_ == leaf_->count) {
+                leaf_ = leaf_->next;
+                pos_ = 0;
+            }
+        }
+    private:
+        friend class BPlusTree;
+        Cursor(const Leaf* leaf, int pos) : leaf_(leaf), pos_(pos) {
+            if (leaf_ && pos_ == leaf_->count) {  // past the leaf's last key: the answer starts the next one
+                leaf_ = leaf_->next;
+                pos_ = 0;
+            }
+        }
+        const Leaf* leaf_;
+        int pos_;
+    };
+
+    /// Cursor at the first key >= from.
+    Cursor lowerBound(const Key& from) const {
+        if (!root_) return Cursor(nullptr, 0);
+        const Leaf* leaf = findLeaf(from);
+        return Cursor(leaf, Search::countLess(leaf->keys, leaf->count, from, less_));
+    }
+
+    /// Cursor at the smallest key.
+    Cursor first() const {
+        if (!root_) return Cursor(nullptr, 0);
+        const void* node = root_;
+        for (int depth = 0; depth + 1 < height_; ++depth) node = static_cast<const Inner*>(node)->children[0];
+        return Cursor(static_cast<const Leaf*>(node), 0);
+    }
+
+private:
+    using Search = NodeSearch<Key, Less>;
+
+    struct alignas(64) Inner {
+        Key keys[FANOUT];        ///< children[i] holds keys < keys[i] <= keys of children[i + 1]
+        void* children[FANOUT + 1];
+        uint8_t count;           ///< Number of keys; count + 1 children
+    };
+
+    Leaf* newLeaf() {
+        ++leaves_;
+        return new (resource_->allocate(sizeof(Leaf), alignof(Leaf))) Leaf();
+    }
+
+    Inner* newInner() {
+        ++inners_;
+        return new (resource_->allocate(sizeof(Inner), alignof(Inner))) Inner();
+    }
+
+    void deleteLeaf(Leaf* leaf) {
+        --leaves_;
+        leaf->~Leaf();
+        resource_->deallocate(leaf, sizeof(Leaf), alignof(Leaf));
+    }
+
+    void deleteInner(Inner* inner) {
+        --inners_;
+        inner->~Inner();
+        resource_->deallocate(inner, sizeof(Inner), alignof(Inner));
+    }
+
+    void freeNode(void* node, int depth) {
+        if (depth + 1 < height_) {
+            Inner* inner = static_cast<Inner*>(node);
+            for (int i = 0; i <= inner->count; ++i) freeNode(inner->children[i], depth + 1);
+            deleteInner(inner);
+        } else {
+            deleteLeaf(static_cast<Leaf*>(node));
+        }
+    }
+
+    // Size of part `index` when total is split into `parts` near-equal parts.
+    static size_t evenShare(size_t total, size_t parts, size_t index) {
+        return total / parts + (index < total % parts ? 1 : 0);
+    }
+
+    Leaf* findLeaf(const Key& key) const {
+        void* node = root_;
+        for (int depth = 0; depth + 1 < height_; ++depth) {
+            const Inner* inner = static_cast<const Inner*>(node);
+            node = inner->children[Search::countLessEqual(inner->keys, inner->count, key, less_)];
+        }
+        return static_cast<Leaf*>(node);
+    }
+
+    // Inserts below node; returns true if node split, with the new right sibling and its separator.
+    bool insertInto(void* node, int depth, const Key& key, int32_t value, Key& upKey, void*& upNode) {
+        if (depth + 1 == height_) {
+            Leaf* leaf = static_cast<Leaf*>(node);
+            int pos = Search::countLess(leaf->keys, leaf->count, key, less_);
+            if (pos < leaf->count && !less_(key, leaf->keys[pos])) {
+                leaf->values[pos] = value;
+                return false;
+            }
+            ++size_;
+            if (leaf->count < FANOUT) {
+                insertAt(leaf, pos, key, value);
+                return false;
+            }
+            Leaf* right = newLeaf();
+            int half = FANOUT / 2;
+            for (int i = half; i < FANOUT; ++i) {
+                right->keys[i - half] = leaf->keys[i];
+                right->values[i - half] = leaf->values[i];
+            }
+            right->count = static_cast<uint8_t>(FANOUT - half);
+            leaf->count = static_cast<uint8_t>(half);
+            right->next = leaf->next;
+            leaf->next = right;
+            if (pos <= half) insertAt(leaf, pos, key, value);
+            else insertAt(right, pos - half, key, value);
+            upKey = right->keys[0];
+            upNode = right;
+            return true;
+        }
+
+        Inner* inner = static_cast<Inner*>(node);
+        int slot = Search::countLessEqual(inner->keys, inner->count, key, less_);
+        Key childKey;
+        void* childNode = nullptr;
+        if (!insertInto(inner->children[slot], depth + 1, key, value, childKey, childNode)) return false;
+
+        // Insert the child's separator, overflowing into scratch arrays before splitting
+        Key keys[FANOUT + 1];
+        void* children[FANOUT + 2];
+        int n = inner->count;
+        for (int i = 0, j = 0; i <= n; ++i, ++j) {
+            if (i == slot) keys[j++] = childKey;
+            if (i < n) keys[j] = inner->keys[i];
+        }
+        for (int i = 0, j = 0; i <= n; ++i, ++j) {
+            children[j] = inner->children[i];
+            if (i == slot) children[++j] = childNode;
+        }
+        ++n;
+        if (n <= FANOUT) {
+            for (int i = 0; i < n; ++i) inner->keys[i] = keys[i];
+            for (int i = 0; i <= n; ++i) inner->children[i] = children[i];
+            inner->count = static_cast<uint8_t>(n);
+            return false;
+        }
+        int mid = n / 2;
+        Inner* right = newInner();
+        for (int i = 0; i < mid; ++i) inner->keys[i] = keys[i];
+        for (int i = 0; i <= mid; ++i) inner->children[i] = children[i];
+        inner->count = static_cast<uint8_t>(mid);
+        for (int i = mid + 1; i < n; ++i) right->keys[i - mid - 1] = keys[i];
+        for (int i = mid + 1; i <= n; ++i) right->children[i - mid - 1] = children[i];
+        right->count = static_cast<uint8_t>(n - mid - 1);
+        upKey = keys[mid];
+        upNode = right;
+        return true;
+    }
+
+    // Erases below node; false if the key is absent. Sets underfull when node drops below MIN_KEYS.
+    bool eraseFrom(void* node, int depth, const Key& key, bool& underfull) {
+        if (depth + 1 == height_) {
+            Leaf* leaf = static_cast<Leaf*>(node);
+            int pos = Search::countLess(leaf->keys, leaf->count, key, less_);
+            if (pos == leaf->count || less_(key, leaf->keys[pos])) return false;
+            for (int i = pos + 1; i < leaf->count; ++i) {
+                leaf->keys[i - 1] = leaf->keys[i];
+                leaf->values[i - 1] = leaf->values[i];
+            }
+            --leaf->count;
+            underfull = leaf->count < MIN_KEYS;
+            return true;
+        }
+        Inner* inner = static_cast<Inner*>(node);
+        int slot = Search::countLessEqual(inner->keys, inner->count, key, less_);
+        bool childUnderfull = false;
+        if (!eraseFrom(inner->children[slot], depth + 1, key, childUnderfull)) return false;
+        if (childUnderfull) rebalance(inner, slot, depth + 1 == height_ - 1);
+        underfull = inner->count < MIN_KEYS;
+        return true;
+    }
+
+    // Refills parent's underfull child at slot from a neighbour: merges the two
+    // when they fit in one node, otherwise moves one entry across.
+    void rebalance(Inner* parent, int slot, bool leaves) {
+        int left = slot > 0 ? slot - 1 : slot;  // the pair is children[left], children[left + 1]
+        if (leaves) {
+            Leaf* l = static_cast<Leaf*>(parent->children[left]);
+            Leaf* r = static_cast<Leaf*>(parent->children[left + 1]);
+            if (l->count + r->count <= FANOUT) {
+                for (int i = 0; i < r->count; ++i) {
+                    l->keys[l->count + i] = r->keys[i];
+                    l->values[l->count + i] = r->values[i];
+                }
+                l->count = static_cast<uint8_t>(l->count + r->count);
+                l->next = r->next;
+                deleteLeaf(r);
+                removeSeparator(parent, left);
+                return;
+            }
+            if (l->count < r->count) {
+                insertAt(l, l->count, r->keys[0], r->values[0]);
+                for (int i = 1; i < r->count; ++i) {
+                    r->keys[i - 1] = r->keys[i];
+                    r->values[i - 1] = r->values[i];
+                }
+                --r->count;
+            } else {
+                insertAt(r, 0, l->keys[l->count - 1], l->values[l->count - 1]);
+                --l->count;
+            }
+            parent->keys[left] = r->keys[0];
+            return;
+        }
+
+        // Inner nodes rotate through the parent's separator
+        Inner* l = static_cast<Inner*>(parent->children[left]);
+        Inner* r = static_cast<Inner*>(parent->children[left + 1]);
+        if (l->count + r->count + 1 <= FANOUT) {
+            l->keys[l->count] = parent->keys[left];
+            for (int i = 0; i < r->count; ++i) l->keys[l->count + 1 + i] = r->keys[i];
+            for (int i = 0; i <= r->count; ++i) l->children[l->count + 1 + i] = r->children[i];
+            l->count = static_cast<uint8_t>(l->count + r->count + 1);
+            deleteInner(r);
+            removeSeparator(parent, left);
+            return;
+        }
+        if (l->count < r->count) {
+            l->keys[l->count] = parent->keys[left];
+            l->children[l->count + 1] = r->children[0];
+            ++l->count;
+            parent->keys[left] = r->keys[0];
+            for (int i = 1; i < r->count; ++i) r->keys[i - 1] = r->keys[i];
+            for (int i = 1; i <= r->count; ++i) r->children[i - 1] = r->children[i];
+            --r->count;
+        } else {
+            for (int i = r->count; i > 0; --i) r->keys[i] = r->keys[i - 1];
+            for (int i = r->count + 1; i > 0; --i) r->children[i] = r->children[i - 1];
+            r->keys[0] = parent->keys[left];
+            r->children[0] = l->children[l->count];
+            ++r->count;
+            parent->keys[left] = l->keys[l->count - 1];
+            --l->count;
+        }
+    }
+
+    // Drops keys[at] and children[at + 1] after that child was merged into its left neighbour.
+    static void removeSeparator(Inner* inner, int at) {
+        for (int i = at + 1; i < inner->count; ++i) inner->keys[i - 1] = inner->keys[i];
+        for (int i = at + 2; i <= inner->count; ++i) inner->children[i - 1] = inner->children[i];
+        --inner->count;
+    }
+
+    static void insertAt(Leaf* leaf, int pos, const Key& key, int32_t value) {
+        for (int i = leaf->count; i > pos; --i) {
+            leaf->keys[i] = leaf->keys[i - 1];
+            leaf->values[i] = leaf->values[i - 1];
+        }
+        leaf->keys[pos] = key;
+        leaf->values[pos] = value;
+        ++leaf->count;
+    }
+
+    pmr::memory_resource* resource_;
+    void* root_ = nullptr;
+    int height_ = 0;   ///< Levels including the leaves; 0 when empty
+    size_t size_ = 0;
+    size_t leaves_ = 0;
+    size_t inners_ = 0;
+    Less less_;
+};
+
+/// Name-index key: items ordered case-insensitively by name, then by ID.
+struct ItemNameKey {
+    string_view name;
+    int32_t id;
+};
+
+struct ItemNameLess {
+    bool operator()(const ItemNameKey& a, const ItemNameKey& b) const {
+        int c = compareNoCase(a.name, b.name);
+        return c != 0 ? c < 0 : a.id < b.id;
+    }
+    static int compareNoCase(string_view a, string_view b) {
+        size_t n = min(a.size(), b.size());
+        for (size_t i = 0; i < n; ++i) {
+            int ca = tolower(static_cast<unsigned char>(a[i])), cb = tolower(static_cast<unsigned char>(b[i]));
+            if (ca != cb) return ca < cb ? -1 : 1;
+        }
+        return a.size() == b.size() ? 0 : (a.size() < b.size() ? -1 : 1);
+    }
+};
+
+struct MemoryUsage;
+class InventoryStore;
+class Transaction;
+
+/**
+ * @brief One change applied to a store, as handed to storage backends.
+ *
+ * Records carry the resulting state rather than the request, so replaying
+ * them reproduces the store exactly (same IDs, prices, profit and dates).
+ */
+struct Mutation {
+    enum Kind : uint8_t { ADD_ITEM = 1, UPDATE_ITEM = 2, DELETE_ITEM = 3, SELL_ITEM = 4 };
+    Kind kind;
+    Item item;               ///< ADD/UPDATE/SELL: the item after the change; DELETE: only id
+    Sale sale;               ///< SELL only: the recorded sale
+    string_view name;        ///< Text of item.name (its StrRef is only meaningful in the source store)
+    string_view size_color;  ///< Text of item.size_color
+};
+
+/// Receives an item read straight from storage; its StrRefs are not set, the text comes alongside.
+using ItemVisitor = function<void(const Item& item, string_view name, string_view sizeColor)>;
+
+/// How long a journaled mutation waits for its record to be safe before the call returns.
+enum class Durability {
+    None,   ///< Handed to the OS: survives an app crash, not a power cut
+    Async,  ///< As None, and a background thread fsyncs every interval
+    Group,  ///< Waits for an fsync, shared with every mutation that arrived in the meantime
+    PerOp   ///< Waits for an fsync of its own
+};
+
+static const char* durabilityName(Durability mode) {
+    switch (mode) {
+        case Durability::None: return "none";
+        case Durability::Async: return "async";
+        case Durability::Group: return "group";
+        default: return "fsync";
+    }
+}
+
+// Reads a --durability value; main() is its only caller, and UNIT_TEST builds leave main() out.
+[[maybe_unused]] static bool parseDurability(const string& name, Durability& mode) {
+    for (Durability m : {Durability::None, Durability::Async, Durability::Group, Durability::PerOp}) {
+        if (name == durabilityName(m)) {
+            mode = m;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Where and how a store's data is persisted.
+ *
+ * load() and checkpoint() move whole tables; backends that journal also get
+ * every mutation through append() as it happens, so nothing is lost between
+ * checkpoints.
+ */
+class StorageBackend {
+public:
+    virtual ~StorageBackend() {}
+    virtual const char* name() const = 0;
+    /// Prepares the backend's files. False if they cannot be used.
+    virtual bool open() = 0;
+    /// Replaces the store's tables with the persisted state. False if nothing was persisted yet.
+    virtual bool load(InventoryStore& store) = 0;
+    /// True if append() should be called for every mutation.
+    virtual bool journals() const { return false; }
+    /// True if items can be read one at a time (readItem(), scanItems()). InventoryStore::load()
+    /// then leaves them in the backend and reads each one in when it is first needed.
+    virtual bool servesItems() const { return false; }
+    /// Calls visit with item id if the backend holds it; false if it does not.
+    virtual bool readItem(int /*id*/, const ItemVisitor& /*visit*/) { return false; }
+    /// Calls visit for every item, in ID order.
+    virtual void scanItems(const ItemVisitor& /*visit*/) {}
+    /// Records one mutation that was just applied to the store.
+    virtual bool append(const Mutation&) { return true; }
+    /// Records mutations that were applied together (a transaction). Journals
+    /// persist them as one record, so after a crash either all or none replay.
+    virtual bool appendBatch(const Mutation* m, size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            if (!append(m[i])) return false;
+        }
+        return true;
+    }
+    /// Chooses how long mutations wait in waitDurable(). False if the backend has no such choice.
+    virtual bool setDurability(Durability, int /*intervalMs*/) { return false; }
+    /// Ticket covering every mutation appended so far; read under the store's lock.
+    virtual uint64_t appendedTicket() const { return 0; }
+    /// Returns once the mutations up to ticket are as safe as the durability mode
+    /// promises, or on disk whatever the mode if sync is set. Called without the
+    /// store's lock, so concurrent callers can share one fsync.
+    virtual bool waitDurable(uint64_t /*ticket*/, bool /*sync*/ = false) { return true; }
+    /// Durability mode and fsyncs so far, for the status screen; empty if not applicable.
+    virtual string durabilityStatus() const { return string(); }
+    /// Persists the store's full state; a journal is emptied afterwards.
+    virtual bool checkpoint(const InventoryStore& store) = 0;
+    /// Files holding nothing but sales rows in the export format (sales.csv
+    /// rows, optionally followed by a checksum footer), in order, as of the
+    /// last checkpoint; exportSales() sends them without the footer. Empty if
+    /// the sales are stored any other way and must be formatted.
+    virtual vector<string> salesSegments() const { return {}; }
+    virtual void close() {}
+};
+
+unique_ptr<StorageBackend> makeCsvBackend(const string& itemsPath, const string& salesPath);
+unique_ptr<StorageBackend> makeLsmBackend(const string& dir);
+/// Sharded backend under dir; workers 0 means one per core, which is also how many shards per table it aims for.
+unique_ptr<StorageBackend> makeShardedBackend(const string& dir, unsigned workers = 0);
+
+const size_t SALES_HEADROOM = 4096; ///< Free sale slots kept reserved so selling rarely grows the vector
+const size_t STRING_COMPACT_MIN_ERASED = 1024; ///< Deletions before the string heap is worth compacting
+const size_t SEARCH_GRAIN = 16384;   ///< Items per scheduler task when a search scans the table
+const size_t SUM_GRAIN = 1 << 20;    ///< Sales per piece of a profit total
+const size_t EXPORT_GRAIN = 65536;   ///< Sales formatted per task by a CSV export
+
+// Files
+const string ITEMS_FILE = "items.csv";
+const string SALES_FILE = "sales.csv";
+
+const int LOW_STOCK_THRESHOLD = 5; ///< Items at or below this quantity count as low stock
+const size_t MAX_LOAD_ISSUES = 100; ///< Bad rows remembered per load; the rest are only counted
+
+/**
+ * @brief A row load() could not use, with where it is.
+ */
+struct LoadIssue {
+    string file;
+    size_t line;     ///< 1-based
+    size_t column;   ///< 1-based byte column of the offending field
+    string message;
+};
+
+/**
+ * @brief One shop's inventory: its tables, ID counters, file paths and indexes.
+ *
+ * Every container allocates from the store's own pool (arena), so several
+ * stores can live in one process without sharing heap state, and all of a
+ * store's memory goes back to the system in one step when it is destroyed.
+ * The four mutators and Transaction::commit() are serialized by a per-store
+ * lock; everything else (reads, load, save) must not run alongside them.
+ * With backgroundIndexes set, load() returns before the indexes are built:
+ * reads may run alongside the build and scan the tables instead, and the
+ * mutators wait for it to finish.
+ *
+ * With a backend that serves items (lsm), load() leaves the items there and
+ * items holds only those read in so far: findItem() and the mutators read an
+ * item in on first use, and the query functions read in what they return, so
+ * with such a backend they must not run alongside other reads either.
+ * forEachItem() and forEachMatch() go through the backend without reading
+ * anything in.
+ */
+class InventoryStore {
+public:
+    explicit InventoryStore(const string& itemsPath = ITEMS_FILE, const string& salesPath = SALES_FILE);
+    ~InventoryStore();
+    InventoryStore(const InventoryStore&) = delete;
+    InventoryStore& operator=(const InventoryStore&) = delete;
+
+    // Core logic (see the logic_* wrappers for details). If persisted is given it
+    // is set to false when a journaling backend could not record the change.
+    int addItem(const string& name, const string& size, int qty, double buy, double sell, bool* persisted = nullptr);
+    bool deleteItem(int id, bool* persisted = nullptr);
+    bool updateItem(int id, int qty, double buy, double sell, bool* persisted = nullptr);
+    int sellItem(int id, int qty, double& profitOut, bool* persisted = nullptr);
+    /// Starts an empty transaction on this store (see Transaction).
+    Transaction begin();
+    vector<const Item*> searchItems(const string& keyword);
+    Item* findItem(int id);
+    double totalProfit() const;
+
+    // Ordered access through the B+tree indexes (sorted scans while they are being built)
+    vector<const Item*> itemsInIdRange(int from, int to);
+    vector<const Item*> itemsInNameRange(const string& from, const string& to);
+    vector<const Item*> itemsById();
+
+    /// Visits every item in ID order, through the backend if it serves them (nothing is read in).
+    void forEachItem(const ItemVisitor& visit) const;
+    /// Visits the items whose name contains keyword (case-insensitive), as searchItems() would list them.
+    void forEachMatch(const string& keyword, const ItemVisitor& visit) const;
+    /// True if the last load() left the items in the backend (see the class comment).
+    bool itemsServed() const { return itemsServed_; }
+
+    /// Build state of one index, for the status screen.
+    struct IndexProgress {
+        const char* name;
+        bool ready;
+        size_t done;   ///< Items taken in so far
+        size_t total;  ///< Items to take in
+    };
+    vector<IndexProgress> indexProgress() const;
+    bool indexesReady() const { return indexReady_[NAME_TREE].load(memory_order_acquire); }
+    /// Blocks until a background index build has finished; returns at once if none is running.
+    void waitForIndexes();
+    /// Duration of the last index build, background or not.
+    double indexBuildMs() const { return indexBuildUs_.load(memory_order_relaxed) / 1000.0; }
+
+    // Persistence through the store's backend (CSV unless replaced)
+    bool save();
+    bool load();
+    void seed();
+    void clear();
+    void setBackend(unique_ptr<StorageBackend> backend);
+    StorageBackend& backend() const { return *backend_; }
+    /// Applies a persisted mutation without reporting it back to the backend.
+    void applyMutation(const Mutation& m);
+    /// Called by backends for a row they cannot load; returns false if loading should stop.
+    bool reportBadRow(LoadIssue issue);
+    /// Called by backends for a file whose checksum does not match; returns false if loading should stop.
+    bool reportDamagedFile(LoadIssue issue);
+
+    vector<MemoryUsage> memoryUsage() const;
+    const CountingResource& arenaUpstream() const { return upstream_; }
+    /// Sources the arena's blocks from another resource (e.g. hugePages). Fails once anything is allocated.
+    bool setUpstream(pmr::memory_resource* upstream);
+    /// Rebuilds the string heap with only the text items and sales still use.
+    void compactStrings();
+
+private:
+    CountingResource upstream_;                 ///< Counts what the arena takes from the system
+    pmr::unsynchronized_pool_resource arena_;   ///< Backs every container below; declared first so it outlives them
+    size_t arenaOverhead_ = 0;                  ///< Bytes the empty arena holds for its own bookkeeping
+
+    unique_ptr<StorageBackend> backend_;
+    bool journaling_ = false;                   ///< Cached backend_->journals()
+    size_t erasedSinceCompaction_ = 0;          ///< Items deleted since the string heap was last compacted
+    bool loadAborted_ = false;                  ///< A strict load hit a bad row
+    mutex writeMutex_;                          ///< Held by each mutator and by a whole commit
+    vector<Mutation>* batch_ = nullptr;         ///< Set during a commit: record() collects here instead
+    bool appendFailed_ = false;                 ///< record() could not hand a mutation to the backend; under writeMutex_
+    bool itemsServed_ = false;                  ///< See itemsServed()
+
+    // Background index build, in this order; each index is marked ready as soon as it is complete
+    enum IndexKind { ID_INDEX, ID_TREE, NAME_TREE, INDEX_KINDS };
+    thread indexThread_;
+    mutex indexMutex_;                          ///< Serializes joining indexThread_
+    atomic<bool> indexBuilding_{false};         ///< indexThread_ started and not joined yet
+    atomic<bool> indexCancel_{false};           ///< Asks indexThread_ to stop early (clear(), destruction)
+    atomic<bool> indexReady_[INDEX_KINDS] = {{true}, {true}, {true}};
+    atomic<size_t> indexDone_[INDEX_KINDS] = {{0}, {0}, {0}};
+    atomic<int64_t> indexBuildUs_{0};
+
+    friend class Transaction;
+
+    // The *Locked mutators expect writeMutex_ to be held
+    int addItemLocked(string_view name, string_view size, int qty, double buy, double sell);
+    bool deleteItemLocked(int id);
+    bool updateItemLocked(int id, int qty, double buy, double sell);
+    int sellItemLocked(int id, int qty, double& profitOut);
+
+    // Runs apply under writeMutex_, then waits for the backend's durability without
+    // it. persisted (if given) is false when the append or the wait failed.
+    template <class Apply> auto mutate(Apply apply, bool* persisted) {
+        waitForIndexes();
+        unique_lock<mutex> lock(writeMutex_);
+        appendFailed_ = false;
+        auto result = apply();
+        bool ok = !appendFailed_;
+        uint64_t ticket = journaling_ && ok ? backend_->appendedTicket() : 0;
+        lock.unlock();
+        if (ticket) ok = backend_->waitDurable(ticket);
+        if (persisted) *persisted = ok;
+        return result;
+    }
+
+    void rebuildIndexes();
+    // Each builder reports progress in indexDone_ and returns early once indexCancel_ is set
+    void buildIdIndex();
+    void buildIdTree();
+    void buildNameTree();
+    void startIndexBuild();
+    void indexItem(const Item& item, size_t pos);
+    void eraseItemAt(size_t pos);
+    void compactIfWorthwhile();
+    const Item* itemById(int id) const;
+    bool indexedAt(size_t pos) const;
+    vector<const Item*> searchTable(const string& keyword) const;
+    vector<const Item*> sortedById() const;
+    Item* readInItem(const Item& item, string_view name, string_view sizeColor);
+    template <class Keep> vector<const Item*> readIn(Keep keep);
+    void record(Mutation::Kind kind, const Item& item, const Sale& sale = Sale{}) {
+        if (!journaling_) return;
+        bool text = kind != Mutation::DELETE_ITEM;
+        Mutation m{kind, item, sale, text ? strings.view(item.name) : string_view(),
+                   text ? strings.view(item.size_color) : string_view()};
+        if (batch_) {
+            batch_->push_back(m);
+        } else if (!backend_->append(m)) {
+            appendFailed_ = true;
+        }
+    }
+
+public:
+    pmr::vector<Item> items;            ///< Inventory items, in insertion/file order
+    pmr::vector<Sale> sales;            ///< Sales records, oldest first
+    int nextItemId = 1;                 ///< Auto-increment counter for Item IDs
+    int nextSaleId = 1;                 ///< Auto-increment counter for Sale IDs
+    StringPool strings;                 ///< Names and variants referenced by items and sales
+    pmr::unordered_map<int, size_t> idIndex; ///< Item ID -> position in items
+    BPlusTree<int32_t> idTree;          ///< Item IDs in order
+    BPlusTree<ItemNameKey, ItemNameLess> nameTree; ///< (name, ID) in case-insensitive name order -> ID
+    bool verbose = true;                ///< Print [Loaded]/[Saved] messages
+    bool publishMetrics = false;        ///< Feed the process-wide metrics (set for the default store)
+    bool seedWhenEmpty = true;          ///< load() seeds the default items when nothing was loaded
+    bool strictLoad = false;            ///< load() gives up at the first bad row instead of skipping it
+    bool backgroundIndexes = false;     ///< load() returns before the indexes are built (see waitForIndexes())
+    vector<LoadIssue> loadIssues;       ///< Bad rows seen by the last load() (the first MAX_LOAD_ISSUES)
+    size_t rowsSkipped = 0;             ///< Bad rows seen by the last load()
+};
+
+/// Outcome of Transaction::commit().
+enum class CommitStatus {
+    Committed,       ///< Every staged operation was applied (and journaled, if the backend journals)
+    ItemNotFound,    ///< An update, delete or sale names an item that does not exist at that point
+    NotEnoughStock,  ///< A sale asks for more than the stock left at that point
+    NotPersisted     ///< Applied in memory, but the journal write failed; the next save persists it
+};
+
+/**
+ * @brief A group of changes to one store that is applied all-or-nothing.
+ *
+ * Operations are only staged until commit(). commit() takes the store's lock
+ * once, checks every operation against the store as the earlier operations
+ * would leave it (an update after a delete of the same item fails, a sale
+ * sees the stock left by earlier sales), and applies nothing if any check
+ * fails. Otherwise everything is applied and handed to the backend as one
+ * batch: a journal writes it as a single record with one fsync, so a crash
+ * loses either the whole transaction or none of it.
+ *
+ * Either way the transaction is empty again afterwards and can be reused.
+ */
+class Transaction {
+public:
+    explicit Transaction(InventoryStore& store) : store_(store) {}
+
+    void stageAdd(const string& name, const string& size, int qty, double buy, double sell) {
+        ops_.push_back({Mutation::ADD_ITEM, 0, qty, buy, sell, text_.size(), name.size(), size.size()});
+        text_ += name;
+        text_ += size;
+    }
+    void stageUpdate(int id, int qty, double buy, double sell) {
+        ops_.push_back({Mutation::UPDATE_ITEM, id, qty, buy, sell, 0, 0, 0});
+    }
+    void stageDelete(int id) { ops_.push_back({Mutation::DELETE_ITEM, id, 0, 0, 0, 0, 0, 0}); }
+    void stageSell(int id, int qty) { ops_.push_back({Mutation::SELL_ITEM, id, qty, 0, 0, 0, 0, 0}); }
+
+    /// Validates and applies every staged operation, or none of them.
+    CommitStatus commit();
+    /// Drops every staged operation.
+    void abort() {
+        ops_.clear();
+        text_.clear();
+    }
+
+    size_t size() const { return ops_.size(); }
+    /// Index of the staged operation the last commit() rejected.
+    size_t failedAt() const { return failedAt_; }
+    /// IDs the last commit() gave the staged adds, in staging order.
+    const vector<int>& addedIds() const { return addedIds_; }
+    /// Profit of the sales in the last commit().
+    double profit() const { return profit_; }
+
+private:
+    struct Op {
+        Mutation::Kind kind;
+        int id;              ///< Unused for adds
+        int qty;             ///< New quantity (add/update) or quantity sold
+        double buy, sell;
+        size_t text;         ///< Adds only: name then size, at this offset in text_
+        size_t nameLength, sizeLength;
+    };
+
+    InventoryStore& store_;
+    vector<Op> ops_;
+    string text_;        ///< Names and sizes of the staged adds, back to back
+    size_t failedAt_ = 0;
+    vector<int> addedIds_;
+    double profit_ = 0;
+};
+
+// Global In-Memory Storage
+InventoryStore defaultStore;                    ///< The store behind the interactive app and the logic_* functions
+pmr::vector<Item>& items = defaultStore.items;  ///< Global list of inventory items (alias of defaultStore.items)
+pmr::vector<Sale>& sales = defaultStore.sales;  ///< Global list of sales records (alias of defaultStore.sales)
+int& nextItemId = defaultStore.nextItemId;      ///< Auto-increment counter for Item IDs
+int& nextSaleId = defaultStore.nextSaleId;      ///< Auto-increment counter for Sale IDs
+
+// Helper utilities
+static inline string trim(const string &s) {
+    size_t start = s.find_first_not_of(" \t\n\r");
+    if (start == string::npos) return "";
+    size_t end = s.find_last_not_of(" \t\n\r");
+    return s.substr(start, end - start + 1);
+}
+
+static inline string toLowerStr(string s) {
+    transform(s.begin(), s.end(), s.begin(), [](unsigned char c){ return tolower(c); });
+    return s;
+}
+
+static inline bool isCancel(const string &s) {
+    string t = toLowerStr(trim(s));
+    return (t == "cancel" || t == "c");
+}
+
+/// Why a number did not parse.
+enum class ParseError {
+    None,        ///< Parsed
+    Empty,       ///< Nothing but blanks
+    NotANumber,  ///< No digits where the number should start (also "nan"/"inf")
+    OutOfRange,  ///< Does not fit the target type
+    TrailingText ///< A number followed by something other than blanks
+};
+
+static const char* parseErrorText(ParseError error) {
+    switch (error) {
+        case ParseError::None: return "ok";
+        case ParseError::Empty: return "empty";
+        case ParseError::NotANumber: return "not a number";
+        case ParseError::OutOfRange: return "out of range";
+        default: return "unexpected text after the number";
+    }
+}
+
+static inline bool isBlank(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; }
+
+/**
+ * @brief from_chars for every number type this tree parses.
+ *
+ * Floating-point from_chars came to libstdc++ with GCC 11 (__cpp_lib_to_chars).
+ * Older toolchains, such as the Makefile's TDM-GCC 9.2, parse doubles with
+ * strtod on a NUL-terminated copy, reporting errors the way from_chars does.
+ */
+template <class T>
+static from_chars_result charsToNumber(const char* first, const char* last, T& value) {
+#ifndef __cpp_lib_to_chars
+    if constexpr (is_floating_point_v<T>) {
+        char buffer[64];
+        string longText;
+        size_t length = static_cast<size_t>(last - first);
+        const char* text = buffer;
+        if (length < sizeof(buffer)) {
+            memcpy(buffer, first, length);
+            buffer[length] = '\0';
+        } else {
+            longText.assign(first, last);
+            text = longText.c_str();
+        }
+        // strtod also takes leading spaces and hex; from_chars stops at the 'x' of "0x"
+        if (length == 0 || isspace(static_cast<unsigned char>(*text))) return {first, errc::invalid_argument};
+        const char* digits = text + (*text == '-');
+        if (digits[0] == '0' && (digits[1] == 'x' || digits[1] == 'X')) {
+            value = *text == '-' ? T(-0.0) : T(0);
+            return {first + (digits + 1 - text), errc()};
+        }
+        char* stop;
+        errno = 0;
+        double parsed = strtod(text, &stop);
+        if (stop == text) return {first, errc::invalid_argument};
+        if (errno == ERANGE) return {first + (stop - text), errc::result_out_of_range};
+        value = static_cast<T>(parsed);
+        return {first + (stop - text), errc()};
+    } else {
+        return from_chars(first, last, value);
+    }
+#else
+    return from_chars(first, last, value);
+#endif
+}
+
+/**
+ * @brief Parses a whole number or decimal with from_chars (charsToNumber): no
+ * exceptions, no allocation, no locale.
+ *
+ * Blanks around the number and one leading '+' are allowed. out is only
+ * written on success.
+ * @param errorAt If given, set to the offset of the offending character on failure.
+ */
+template <class T>
+static ParseError parseNumber(string_view text, T& out, size_t* errorAt = nullptr) {
+    const char* begin = text.data();
+    const char* end = begin + text.size();
+    const char* p = begin;
+    while (p < end && isBlank(*p)) ++p;
+    auto fail = [&](ParseError error, const char* at) {
+        if (errorAt) *errorAt = static_cast<size_t>(at - begin);
+        return error;
+    };
+    if (p == end) return fail(ParseError::Empty, p);
+    if (*p == '+' && p + 1 < end && *(p + 1) != '-') ++p;
+    T value{};
+    from_chars_result r = charsToNumber(p, end, value);
+    if (r.ec == errc::invalid_argument) return fail(ParseError::NotANumber, p);
+    if (r.ec == errc::result_out_of_range) return fail(ParseError::OutOfRange, p);
+    if constexpr (is_floating_point_v<T>) {
+        if (!isfinite(value)) return fail(ParseError::NotANumber, p);
+    }
+    const char* rest = r.ptr;
+    while (rest < end && isBlank(*rest)) ++rest;
+    if (rest != end) return fail(ParseError::TrailingText, r.ptr);
+    out = value;
+    return ParseError::None;
+}
+
+static inline bool toInt(const string &s, int &out) {
+    return parseNumber(s, out) == ParseError::None;
+}
+
+static inline bool toDouble(const string &s, double &out) {
+    return parseNumber(s, out) == ParseError::None;
+}
+
+static inline string promptLine(const string &msg) {
+    string s;
+    cout << msg;
+    if (!getline(cin, s)) return string();
+    return s;
+}
+
+/**
+ * @brief Thread-safe wall clock handing out nanosecond timestamps and local-time text.
+ *
+ * A UTC offset only changes on a minute boundary, so the local
+ * "YYYY-MM-DD HH:MM:" prefix is derived with localtime once per minute and
+ * shared through a seqlock; formatting any second of that minute only
+ * appends two digits. Readers never wait: one that finds the cache stale
+ * formats the prefix itself and publishes it with a single compare-and-swap.
+ */
+class WallClock {
+public:
+    static const size_t TEXT_SIZE = 20;     ///< "YYYY-MM-DD HH:MM:SS" plus NUL
+
+    /// Nanoseconds since the Unix epoch.
+    static long long nowNs() {
+        return chrono::duration_cast<chrono::nanoseconds>(chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    /// Writes the local time of a timestamp as "YYYY-MM-DD HH:MM:SS".
+    void format(long long ns, char out[TEXT_SIZE]) {
+        long long second = floorDiv(ns, 1000000000LL);
+        long long minute = floorDiv(second, 60);
+        int sec = static_cast<int>(second - minute * 60);
+
+        unsigned long long words[PREFIX_WORDS];
+        unsigned long long seq = seq_.load(memory_order_acquire);
+        bool cached = false;
+        if (!(seq & 1) && minute_.load(memory_order_relaxed) == minute) {
+            for (int i = 0; i < PREFIX_WORDS; ++i) words[i] = prefix_[i].load(memory_order_relaxed);
+            atomic_thread_fence(memory_order_acquire);
+            cached = seq_.load(memory_order_relaxed) == seq;
+        }
+        if (!cached) {
+            char prefix[sizeof(words)] = {};
+            formatPrefix(minute, prefix);
+            memcpy(words, prefix, sizeof(words));
+            // Publish only newer minutes, and only if no other thread is mid-update
+            if (!(seq & 1) && minute > minute_.load(memory_order_relaxed) &&
+                seq_.compare_exchange_strong(seq, seq + 1, memory_order_acquire)) {
+                atomic_thread_fence(memory_order_release);
+                minute_.store(minute, memory_order_relaxed);
+                for (int i = 0; i < PREFIX_WORDS; ++i) prefix_[i].store(words[i], memory_order_relaxed);
+                seq_.store(seq + 2, memory_order_release);
+            }
+        }
+        memcpy(out, words, PREFIX_LEN);
+        out[PREFIX_LEN] = static_cast<char>('0' + sec / 10);
+        out[PREFIX_LEN + 1] = static_cast<char>('0' + sec % 10);
+        out[PREFIX_LEN + 2] = '\0';
+    }
+
+private:
+    static const int PREFIX_WORDS = 3;      ///< Prefix stored as 3 x 8 bytes so it can live in atomics
+    static const size_t PREFIX_LEN = 17;    ///< strlen("YYYY-MM-DD HH:MM:")
+
+    static long long floorDiv(long long a, long long b) {
+        return a / b - ((a % b != 0) && ((a < 0) != (b < 0)));
+    }
+
+    static void formatPrefix(long long minute, char* prefix) {
+        time_t t = static_cast<time_t>(minute * 60);
+        tm local;
+#ifdef _WIN32
+        localtime_s(&local, &t);
+#else
+        localtime_r(&t, &local);
+#endif
+        strftime(prefix, PREFIX_WORDS * 8, "%Y-%m-%d %H:%M:", &local);
+    }
+
+    atomic<unsigned long long> seq_{0};                 ///< Odd while a writer is updating the cache
+    atomic<long long> minute_{numeric_limits<long long>::min()};
+    atomic<unsigned long long> prefix_[PREFIX_WORDS] = {};
+};
+
+WallClock wallClock; ///< Process-wide clock used for sale timestamps
+
+// Copies a timestamp into a sale's fixed-size date field, truncating if needed.
+static inline void setSaleDate(Sale& s, string_view date) {
+    size_t n = min(date.size(), sizeof(s.date_sold) - 1);
+    memcpy(s.date_sold, date.data(), n);
+    s.date_sold[n] = '\0';
+}
+
+/* ================= CPU DISPATCH ================= */
+
+// x86 kernels are compiled per ISA with target attributes and picked at
+// startup, so one binary runs on SSE2-only POS boxes and AVX-512 servers.
+// MinGW does not keep the stack 32-byte aligned for spilled AVX registers,
+// so Windows builds stop at SSE4.2.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SIMD_DISPATCH 1
+#include <immintrin.h>
+#if !defined(_WIN32)
+#define SIMD_DISPATCH_AVX 1
+#endif
+#endif
+
+/// Instruction set levels, lowest first.
+enum class CpuIsa { Scalar, SSE2, SSE42, AVX2, AVX512 };
+
+static const char* isaName(CpuIsa isa) {
+    switch (isa) {
+        case CpuIsa::SSE2: return "sse2";
+        case CpuIsa::SSE42: return "sse4.2";
+        case CpuIsa::AVX2: return "avx2";
+        case CpuIsa::AVX512: return "avx512";
+        default: return "scalar";
+    }
+}
+
+/**
+ * @brief The SIMD kernels bound for one instruction set.
+ *
+ * Every variant returns exactly what the scalar one does; sumStrided adds in
+ * eight fixed lanes combined in a fixed order, so even the double sums match
+ * bit for bit.
+ */
+struct SimdKernels {
+    CpuIsa isa;
+    /// Writes the offsets of every ',' and '\n' in p[0, n) to out (room for n) and returns how many.
+    size_t (*structuralIndex)(const char* p, size_t n, uint32_t* out);
+    /// Whether hay contains needle (already lower case), ASCII case-insensitively.
+    bool (*containsNoCase)(const char* hay, size_t n, const char* needle, size_t m);
+    /// Sum of count doubles, the first at base and each stride bytes after the last.
+    double (*sumStrided)(const char* base, size_t count, size_t stride);
+    /// CRC32C of p[0, n) continuing from crc (0 to start), like zlib's crc32().
+    uint32_t (*crc32c)(uint32_t crc, const char* p, size_t n);
+};
+
+static inline char foldAscii(char c) { return c >= 'A' && c <= 'Z' ? static_cast<char>(c + 32) : c; }
+
+static inline bool equalsNoCase(const char* hay, const char* needle, size_t m) {
+    for (size_t i = 0; i < m; ++i) {
+        if (foldAscii(hay[i]) != needle[i]) return false;
+    }
+    return true;
+}
+
+static inline double stridedAt(const char* base, size_t i, size_t stride) {
+    double v;
+    memcpy(&v, base + i * stride, sizeof(v));
+    return v;
+}
+
+// The fixed combine order every sumStrided variant ends with.
+static inline double combineLanes(const double* lane, const char* base, size_t i, size_t count, size_t stride) {
+    double total = ((lane[0] + lane[1]) + (lane[2] + lane[3])) + ((lane[4] + lane[5]) + (lane[6] + lane[7]));
+    for (; i < count; ++i) total += stridedAt(base, i, stride);
+    return total;
+}
+
+static size_t structuralIndexScalar(const char* p, size_t n, uint32_t* out) {
+    size_t count = 0;
+    for (size_t i = 0; i < n; ++i) {
+        out[count] = static_cast<uint32_t>(i);
+        count += (p[i] == ',') | (p[i] == '\n');
+    }
+    return count;
+}
+
+// Appends base + the position of every set bit of mask, lowest first.
+static inline size_t appendBits(uint64_t mask, size_t base, uint32_t* out, size_t count) {
+    for (; mask; mask &= mask - 1) out[count++] = static_cast<uint32_t>(base + __builtin_ctzll(mask));
+    return count;
+}
+
+static bool containsNoCaseScalar(const char* hay, size_t n, const char* needle, size_t m) {
+    if (m > n) return false;
+    for (size_t i = 0; i + m <= n; ++i) {
+        if (equalsNoCase(hay + i, needle, m)) return true;
+    }
+    return false;
+}
+
+static double sumStridedScalar(const char* base, size_t count, size_t stride) {
+    double lane[8] = {};
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        for (int k = 0; k < 8; ++k) lane[k] += stridedAt(base, i + k, stride);
+    }
+    return combineLanes(lane, base, i, count, stride);
+}
+
+// CRC32C (Castagnoli, reflected polynomial 0x82F63B78), the checksum of iSCSI and ext4.
+const uint32_t CRC32C_POLY = 0x82F63B78;
+const size_t CRC32C_LONG = 8192;  ///< Stream length of the 3-way hardware kernel's large blocks
+const size_t CRC32C_SHORT = 256;  ///< ... and of its small blocks
+
+/**
+ * @brief Lookup tables for CRC32C: slicing-by-8 for the software kernel, and
+ * operators that advance a raw CRC over a run of zero bytes, with which the
+ * hardware kernel joins three independent streams.
+ */
+struct Crc32cTables {
+    uint32_t bytes[8][256];
+    uint32_t longShift[4][256];   ///< Over CRC32C_LONG zero bytes
+    uint32_t shortShift[4][256];  ///< Over CRC32C_SHORT zero bytes
+
+    Crc32cTables() {
+        for (uint32_t n = 0; n < 256; ++n) {
+            uint32_t crc = n;
+            for (int k = 0; k < 8; ++k) crc = crc & 1 ? (crc >> 1) ^ CRC32C_POLY : crc >> 1;
+            bytes[0][n] = crc;
+        }
+        for (uint32_t n = 0; n < 256; ++n) {
+            for (int k = 1; k < 8; ++k) bytes[k][n] = (bytes[k - 1][n] >> 8) ^ bytes[0][bytes[k - 1][n] & 0xff];
+        }
+        zeroOperator(longShift, CRC32C_LONG);
+        zeroOperator(shortShift, CRC32C_SHORT);
+    }
+
+private:
+    // A raw CRC is linear in its state, so running each single-bit state over
+    // the zeros once gives the operator for every state.
+    void zeroOperator(uint32_t (&shift)[4][256], size_t zeros) const {
+        uint32_t bit[32];
+        for (int b = 0; b < 32; ++b) {
+            uint32_t crc = uint32_t(1) << b;
+            for (size_t i = 0; i < zeros; ++i) crc = bytes[0][crc & 0xff] ^ (crc >> 8);
+            bit[b] = crc;
+        }
+        for (int k = 0; k < 4; ++k) {
+            for (uint32_t n = 0; n < 256; ++n) {
+                uint32_t out = 0;
+                for (int b = 0; b < 8; ++b) {
+                    if (n >> b & 1) out ^= bit[8 * k + b];
+                }
+                shift[k][n] = out;
+            }
+        }
+    }
+};
+
+static const Crc32cTables& crc32cTables() {
+    static const Crc32cTables tables;
+    return tables;
+}
+
+static uint32_t crc32cScalar(uint32_t crc, const char* p, size_t n) {
+    const auto& t = crc32cTables().bytes;
+    crc = ~crc;
+    for (; n >= 8; p += 8, n -= 8) {
+        uint32_t lo, hi;
+        memcpy(&lo, p, 4);  // little-endian, like every target we ship
+        memcpy(&hi, p + 4, 4);
+        lo ^= crc;
+        crc = t[7][lo & 0xff] ^ t[6][(lo >> 8) & 0xff] ^ t[5][(lo >> 16) & 0xff] ^ t[4][lo >> 24] ^
+              t[3][hi & 0xff] ^ t[2][(hi >> 8) & 0xff] ^ t[1][(hi >> 16) & 0xff] ^ t[0][hi >> 24];
+    }
+    for (; n; --n) crc = t[0][(crc ^ static_cast<uint8_t>(*p++)) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+#ifdef SIMD_DISPATCH
+__attribute__((target("sse4.2")))
+static inline uint32_t crc32cWord(uint32_t crc, const char* p) {
+#ifdef __x86_64__
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return static_cast<uint32_t>(_mm_crc32_u64(crc, v));
+#else
+    uint32_t v[2];
+    memcpy(v, p, 8);
+    return _mm_crc32_u32(_mm_crc32_u32(crc, v[0]), v[1]);
+#endif
+}
+
+static inline uint32_t crc32cShift(const uint32_t (&shift)[4][256], uint32_t crc) {
+    return shift[0][crc & 0xff] ^ shift[1][(crc >> 8) & 0xff] ^ shift[2][(crc >> 16) & 0xff] ^ shift[3][crc >> 24];
+}
+
+// The crc32 instruction has a latency of three cycles but issues every cycle,
+// so three independent streams run at about three times the speed of one.
+// Each stream's CRC is then advanced past the streams after it and folded in.
+__attribute__((target("sse4.2")))
+static uint32_t crc32cSse42(uint32_t crc, const char* p, size_t n) {
+    const Crc32cTables& t = crc32cTables();
+    uint32_t c0 = ~crc;
+    for (size_t block : {CRC32C_LONG, CRC32C_SHORT}) {
+        const uint32_t (&shift)[4][256] = block == CRC32C_LONG ? t.longShift : t.shortShift;
+        for (; n >= 3 * block; p += 3 * block, n -= 3 * block) {
+            uint32_t c1 = 0, c2 = 0;
+            for (size_t i = 0; i < block; i += 8) {
+                c0 = crc32cWord(c0, p + i);
+                c1 = crc32cWord(c1, p + block + i);
+                c2 = crc32cWord(c2, p + 2 * block + i);
+            }
+            c0 = crc32cShift(shift, c0) ^ c1;
+            c0 = crc32cShift(shift, c0) ^ c2;
+        }
+    }
+    for (; n >= 8; p += 8, n -= 8) c0 = crc32cWord(c0, p);
+    for (; n; --n) c0 = _mm_crc32_u8(c0, static_cast<uint8_t>(*p++));
+    return ~c0;
+}
+
+__attribute__((target("sse2")))
+static size_t structuralIndexSse2(const char* p, size_t n, uint32_t* out) {
+    const __m128i comma = _mm_set1_epi8(','), newline = _mm_set1_epi8('\n');
+    size_t i = 0, count = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+        unsigned hits = static_cast<unsigned>(_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, comma), _mm_cmpeq_epi8(v, newline))));
+        count = appendBits(hits, i, out, count);
+    }
+    size_t tail = structuralIndexScalar(p + i, n - i, out + count);
+    for (size_t k = count; k < count + tail; ++k) out[k] += static_cast<uint32_t>(i);
+    return count + tail;
+}
+
+// 'A'..'Z' -> 'a'..'z' in every byte; bytes >= 0x80 compare as negative and stay put.
+__attribute__((target("sse2")))
+static inline __m128i foldSse2(__m128i v) {
+    __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('A' - 1)), _mm_cmplt_epi8(v, _mm_set1_epi8('Z' + 1)));
+    return _mm_or_si128(v, _mm_and_si128(upper, _mm_set1_epi8(0x20)));
+}
+
+// Candidates are positions whose first and last needle bytes both match; the rest is checked per candidate.
+__attribute__((target("sse2")))
+static bool containsNoCaseSse2(const char* hay, size_t n, const char* needle, size_t m) {
+    if (m == 0) return true;
+    if (m > n) return false;
+    const __m128i first = _mm_set1_epi8(needle[0]), last = _mm_set1_epi8(needle[m - 1]);
+    size_t i = 0;
+    for (; i + m - 1 + 16 <= n; i += 16) {
+        __m128i a = foldSse2(_mm_loadu_si128(reinterpret_cast<const __m128i*>(hay + i)));
+        __m128i b = foldSse2(_mm_loadu_si128(reinterpret_cast<const __m128i*>(hay + i + m - 1)));
+        unsigned hits = static_cast<unsigned>(_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last))));
+        for (; hits; hits &= hits - 1) {
+            if (equalsNoCase(hay + i + __builtin_ctz(hits), needle, m)) return true;
+        }
+    }
+    return containsNoCaseScalar(hay + i, n - i, needle, m);
+}
+
+__attribute__((target("sse2")))
+static double sumStridedSse2(const char* base, size_t count, size_t stride) {
+    __m128d acc[4] = {_mm_setzero_pd(), _mm_setzero_pd(), _mm_setzero_pd(), _mm_setzero_pd()};
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        for (int k = 0; k < 4; ++k) {
+            acc[k] = _mm_add_pd(acc[k], _mm_set_pd(stridedAt(base, i + 2 * k + 1, stride), stridedAt(base, i + 2 * k, stride)));
+        }
+    }
+    double lane[8];
+    for (int k = 0; k < 4; ++k) _mm_storeu_pd(lane + 2 * k, acc[k]);
+    return combineLanes(lane, base, i, count, stride);
+}
+#endif
+
+#ifdef SIMD_DISPATCH_AVX
+// The AVX variants hand their tails to narrower ones. GCC does not always
+// emit vzeroupper before such a tail call, and legacy SSE code running with
+// dirty upper halves is many times slower, so clear them explicitly.
+__attribute__((target("avx2")))
+static size_t structuralIndexAvx2(const char* p, size_t n, uint32_t* out) {
+    const __m256i comma = _mm256_set1_epi8(','), newline = _mm256_set1_epi8('\n');
+    size_t i = 0, count = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+        unsigned hits = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(v, comma), _mm256_cmpeq_epi8(v, newline))));
+        count = appendBits(hits, i, out, count);
+    }
+    _mm256_zeroupper();
+    size_t tail = structuralIndexSse2(p + i, n - i, out + count);
+    for (size_t k = count; k < count + tail; ++k) out[k] += static_cast<uint32_t>(i);
+    return count + tail;
+}
+
+__attribute__((target("avx2")))
+static inline __m256i foldAvx2(__m256i v) {
+    __m256i upper = _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8('A' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('Z' + 1), v));
+    return _mm256_or_si256(v, _mm256_and_si256(upper, _mm256_set1_epi8(0x20)));
+}
+
+__attribute__((target("avx2")))
+static bool containsNoCaseAvx2(const char* hay, size_t n, const char* needle, size_t m) {
+    if (m == 0) return true;
+    if (m > n) return false;
+    const __m256i first = _mm256_set1_epi8(needle[0]), last = _mm256_set1_epi8(needle[m - 1]);
+    size_t i = 0;
+    for (; i + m - 1 + 32 <= n; i += 32) {
+        __m256i a = foldAvx2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(hay + i)));
+        __m256i b = foldAvx2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(hay + i + m - 1)));
+        unsigned hits = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, first), _mm256_cmpeq_epi8(b, last))));
+        for (; hits; hits &= hits - 1) {
+            if (equalsNoCase(hay + i + __builtin_ctz(hits), needle, m)) return true;
+        }
+    }
+    _mm256_zeroupper();
+    return containsNoCaseSse2(hay + i, n - i, needle, m);
+}
+
+__attribute__((target("avx2")))
+static double sumStridedAvx2(const char* base, size_t count, size_t stride) {
+    const long long s = static_cast<long long>(stride);
+    const __m256i low = _mm256_set_epi64x(3 * s, 2 * s, s, 0), high = _mm256_set_epi64x(7 * s, 6 * s, 5 * s, 4 * s);
+    __m256d acc0 = _mm256_setzero_pd(), acc1 = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const double* row = reinterpret_cast<const double*>(base + i * stride);
+        acc0 = _mm256_add_pd(acc0, _mm256_i64gather_pd(row, low, 1));
+        acc1 = _mm256_add_pd(acc1, _mm256_i64gather_pd(row, high, 1));
+    }
+    double lane[8];
+    _mm256_storeu_pd(lane, acc0);
+    _mm256_storeu_pd(lane + 4, acc1);
+    return combineLanes(lane, base, i, count, stride);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static size_t structuralIndexAvx512(const char* p, size_t n, uint32_t* out) {
+    const __m512i comma = _mm512_set1_epi8(','), newline = _mm512_set1_epi8('\n');
+    size_t i = 0, count = 0;
+    for (; i + 64 <= n; i += 64) {
+        __m512i v = _mm512_loadu_si512(p + i);
+        count = appendBits(_mm512_cmpeq_epi8_mask(v, comma) | _mm512_cmpeq_epi8_mask(v, newline), i, out, count);
+    }
+    _mm256_zeroupper();
+    size_t tail = structuralIndexSse2(p + i, n - i, out + count);
+    for (size_t k = count; k < count + tail; ++k) out[k] += static_cast<uint32_t>(i);
+    return count + tail;
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static inline __m512i foldAvx512(__m512i v) {
+    __mmask64 upper = _mm512_cmpgt_epi8_mask(v, _mm512_set1_epi8('A' - 1)) & _mm512_cmplt_epi8_mask(v, _mm512_set1_epi8('Z' + 1));
+    return _mm512_mask_add_epi8(v, upper, v, _mm512_set1_epi8(0x20));
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static bool containsNoCaseAvx512(const char* hay, size_t n, const char* needle, size_t m) {
+    if (m == 0) return true;
+    if (m > n) return false;
+    const __m512i first = _mm512_set1_epi8(needle[0]), last = _mm512_set1_epi8(needle[m - 1]);
+    size_t i = 0;
+    for (; i + m - 1 + 64 <= n; i += 64) {
+        __m512i a = foldAvx512(_mm512_loadu_si512(hay + i));
+        __m512i b = foldAvx512(_mm512_loadu_si512(hay + i + m - 1));
+        unsigned long long hits = _mm512_cmpeq_epi8_mask(a, first) & _mm512_cmpeq_epi8_mask(b, last);
+        for (; hits; hits &= hits - 1) {
+            if (equalsNoCase(hay + i + __builtin_ctzll(hits), needle, m)) return true;
+        }
+    }
+    _mm256_zeroupper();
+    return containsNoCaseSse2(hay + i, n - i, needle, m);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static double sumStridedAvx512(const char* base, size_t count, size_t stride) {
+    const long long s = static_cast<long long>(stride);
+    const __m512i offsets = _mm512_set_epi64(7 * s, 6 * s, 5 * s, 4 * s, 3 * s, 2 * s, s, 0);
+    __m512d acc = _mm512_setzero_pd();
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        // The masked form sidesteps a -Wmaybe-uninitialized false positive in GCC's header
+        acc = _mm512_add_pd(acc, _mm512_mask_i64gather_pd(_mm512_setzero_pd(), 0xFF, offsets, base + i * stride, 1));
+    }
+    double lane[8];
+    _mm512_storeu_pd(lane, acc);
+    return combineLanes(lane, base, i, count, stride);
+}
+#endif
+
+/// Highest instruction set this CPU (and OS) supports that the build has kernels for.
+static CpuIsa detectIsa() {
+#ifdef SIMD_DISPATCH
+    __builtin_cpu_init();
+#ifdef SIMD_DISPATCH_AVX
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) return CpuIsa::AVX512;
+    if (__builtin_cpu_supports("avx2")) return CpuIsa::AVX2;
+#endif
+    if (__builtin_cpu_supports("sse4.2")) return CpuIsa::SSE42;
+    if (__builtin_cpu_supports("sse2")) return CpuIsa::SSE2;
+#endif
+    return CpuIsa::Scalar;
+}
+
+// The kernel table for one level; SSE4.2 adds the hardware CRC32C to the SSE2 kernels.
+static SimdKernels kernelsFor(CpuIsa isa) {
+    switch (isa) {
+#ifdef SIMD_DISPATCH_AVX
+        case CpuIsa::AVX512: return {isa, structuralIndexAvx512, containsNoCaseAvx512, sumStridedAvx512, crc32cSse42};
+        case CpuIsa::AVX2: return {isa, structuralIndexAvx2, containsNoCaseAvx2, sumStridedAvx2, crc32cSse42};
+#endif
+#ifdef SIMD_DISPATCH
+        case CpuIsa::SSE42: return {isa, structuralIndexSse2, containsNoCaseSse2, sumStridedSse2, crc32cSse42};
+        case CpuIsa::SSE2: return {isa, structuralIndexSse2, containsNoCaseSse2, sumStridedSse2, crc32cScalar};
+#endif
+        default: return {CpuIsa::Scalar, structuralIndexScalar, containsNoCaseScalar, sumStridedScalar, crc32cScalar};
+    }
+}
+
+const CpuIsa detectedIsa = detectIsa(); ///< What this machine supports
+SimdKernels simd = kernelsFor(detectedIsa); ///< Kernels in use; rebound by simd_select()
+
+/**
+ * @brief Forces the kernels of one instruction set (--isa), for testing.
+ *
+ * @param name "scalar", "sse2", "sse4.2", "avx2" or "avx512".
+ * @return false if the name is unknown or the CPU lacks that level; the binding is unchanged.
+ */
+bool simd_select(const string& name) {
+    for (CpuIsa isa : {CpuIsa::Scalar, CpuIsa::SSE2, CpuIsa::SSE42, CpuIsa::AVX2, CpuIsa::AVX512}) {
+        if (name != isaName(isa)) continue;
+        if (isa > detectedIsa) return false;
+        simd = kernelsFor(isa);
+        return true;
+    }
+    return false;
+}
+
+/* ================= RECORD SCHEMAS ================= */
+// Each record type lists its fields once, in file order. The CSV parser and
+// writer, the binary codec and the UI printer are generated from that list,
+// so adding a field is a one-line change here.
+
+/// How a field is stored and formatted.
+enum class FieldKind {
+    Number, ///< int32 or double
+    Text,   ///< StrRef or string_view into a string heap
+    Date    ///< Fixed "YYYY-MM-DD HH:MM:SS" char array
+};
+
+/**
+ * @brief Describes one field of a record.
+ *
+ * label is what the UI prints before the value: "" for the bare value,
+ * nullptr to leave the field out of the UI.
+ */
+template <class Record, class T, FieldKind K>
+struct Field {
+    static constexpr FieldKind kind = K;
+    const char* name;   ///< Column name, as in the README
+    const char* label;  ///< UI prefix, "" or nullptr (hidden)
+    T Record::*member;
+};
+
+template <class R, class T>
+constexpr Field<R, T, FieldKind::Number> numberField(const char* name, const char* label, T R::*member) {
+    return {name, label, member};
+}
+template <class R, class T>
+constexpr Field<R, T, FieldKind::Text> textField(const char* name, const char* label, T R::*member) {
+    return {name, label, member};
+}
+template <class R, class T>
+constexpr Field<R, T, FieldKind::Date> dateField(const char* name, const char* label, T R::*member) {
+    return {name, label, member};
+}
+
+template <class Record> struct Schema;
+
+template <> struct Schema<Item> {
+    static constexpr auto fields = make_tuple(
+        numberField("ID", "ID: ", &Item::id),
+        textField("Name", "", &Item::name),
+        textField("Size", "", &Item::size_color),
+        numberField("Quantity", "Qty: ", &Item::quantity),
+        numberField("BuyPrice", "Buy: ", &Item::purchase_price),
+        numberField("SellPrice", "Sell: ", &Item::selling_price));
+};
+
+template <> struct Schema<Sale> {
+    static constexpr auto fields = make_tuple(
+        numberField("SaleID", "SaleID: ", &Sale::id),
+        numberField("ItemID", nullptr, &Sale::item_id),
+        textField("ItemName", "", &Sale::item_name),
+        numberField("QtySold", "Qty: ", &Sale::quantity_sold),
+        numberField("Profit", "Profit: ", &Sale::profit),
+        dateField("Date", "Date: ", &Sale::date_sold));
+};
+
+template <class Record>
+constexpr size_t fieldCount() { return tuple_size<decay_t<decltype(Schema<Record>::fields)>>::value; }
+
+/// Calls visit(field) for every field of Record, in file order.
+template <class Record, class Visit>
+inline void forEachField(Visit&& visit) {
+    apply([&](const auto&... field) { (visit(field), ...); }, Schema<Record>::fields);
+}
+
+// Text policies: how a codec reads and writes a record's Text fields.
+
+/// Reads text through a store's string heap (writing records out).
+struct PoolText {
+    const StringPool& pool;
+    string_view get(StrRef ref) { return pool.view(ref); }
+    string_view get(string_view text) { return text; }
+};
+
+/// Interns parsed text into a store's string heap (reading records in).
+struct InternText {
+    StringPool& pool;
+    void set(StrRef& ref, string_view text) { ref = pool.intern(text); }
+    void set(string_view& out, string_view text) { out = pool.internView(text); }
+};
+
+/**
+ * @brief Keeps StrRef text outside any heap, in slots taken in field order
+ * (mutation payloads). Views point into whatever was decoded.
+ */
+struct SlotText {
+    string_view* slots;
+    size_t next = 0;
+    string_view get(StrRef) { return slots[next++]; }
+    string_view get(string_view text) { return text; }
+    void set(StrRef& ref, string_view text) { slots[next++] = text; ref = 0; }
+    void set(string_view& out, string_view text) { out = text; }
+};
+
+// Appends a number as ostream's default format would print it (%g for doubles).
+template <class T>
+static void appendNumber(string& out, T value) {
+    char buf[32];
+    to_chars_result r;
+    if constexpr (is_floating_point_v<T>) {
+#ifdef __cpp_lib_to_chars
+        r = to_chars(buf, buf + sizeof(buf), value, chars_format::general, 6);
+#else
+        // No floating-point to_chars before GCC 11; "%g" is the same format
+        int n = snprintf(buf, sizeof(buf), "%g", static_cast<double>(value));
+        r.ptr = buf + max(0, min(n, static_cast<int>(sizeof(buf)) - 1));
+#endif
+    } else {
+        r = to_chars(buf, buf + sizeof(buf), value);
+    }
+    out.append(buf, r.ptr);
+}
+
+/// Appends one CSV line for record, without quoting, ending in '\n'.
+template <class Record, class Text>
+void formatCsv(string& out, const Record& record, Text&& text) {
+    bool first = true;
+    forEachField<Record>([&](const auto& field) {
+        if (!first) out += ',';
+        first = false;
+        const auto& value = record.*field.member;
+        if constexpr (decay_t<decltype(field)>::kind == FieldKind::Number) {
+            appendNumber(out, value);
+        } else if constexpr (decay_t<decltype(field)>::kind == FieldKind::Text) {
+            out += text.get(value);
+        } else {
+            out += value;
+        }
+    });
+    out += '\n';
+}
+
+/**
+ * @brief Fills record from fieldCount<Record>() CSV fields.
+ * @param badField If given, set to the index of the first field that failed.
+ * @return The first number's error, or ParseError::None; record is then partly filled.
+ */
+template <class Record, class Text>
+ParseError parseCsv(const string_view* fields, Record& record, Text&& text, size_t* badField = nullptr) {
+    ParseError error = ParseError::None;
+    size_t i = 0;
+    forEachField<Record>([&](const auto& field) {
+        auto& value = record.*field.member;
+        string_view source = fields[i];
+        if constexpr (decay_t<decltype(field)>::kind == FieldKind::Number) {
+            if (error == ParseError::None) {
+                error = parseNumber(source, value);
+                if (error != ParseError::None && badField) *badField = i;
+            }
+        } else if constexpr (decay_t<decltype(field)>::kind == FieldKind::Text) {
+            text.set(value, source);
+        } else {
+            size_t n = min(source.size(), sizeof(value) - 1);
+            memcpy(value, source.data(), n);
+            value[n] = '\0';
+        }
+        ++i;
+    });
+    return error;
+}
+
+/// Column name of field index of Record.
+template <class Record>
+const char* fieldName(size_t index) {
+    const char* name = "";
+    size_t i = 0;
+    forEachField<Record>([&](const auto& field) {
+        if (i++ == index) name = field.name;
+    });
+    return name;
+}
+
+/// Prints the labelled fields as "Label: value | ..." (no newline).
+template <class Record, class Text>
+void printRecord(ostream& out, const Record& record, Text&& text) {
+    bool first = true;
+    forEachField<Record>([&](const auto& field) {
+        if (!field.label) return;
+        if (!first) out << " | ";
+        first = false;
+        out << field.label;
+        const auto& value = record.*field.member;
+        if constexpr (decay_t<decltype(field)>::kind == FieldKind::Text) {
+            out << text.get(value);
+        } else {
+            out << value;
+        }
+    });
+}
+
+/* ================= MEMORY ACCOUNTING ================= */
+
+/**
+ * @brief Memory held by one in-memory structure.
+ */
+struct MemoryUsage {
+    string component;       ///< Name shown in the breakdown table
+    size_t count;           ///< Live elements
+    size_t capacity;        ///< Reserved elements
+    size_t recordBytes;     ///< Bytes reserved for the element array (capacity * sizeof)
+    size_t slackBytes;      ///< Reserved but unused bytes ((capacity - count) * sizeof)
+    size_t heapBytes;       ///< Out-of-line bytes owned by the elements (e.g. long strings)
+
+    size_t totalBytes() const { return recordBytes + heapBytes; }
+};
+
+// Bucket array plus one node (next pointer, value, cached hash) per entry
+template <class Hash>
+static MemoryUsage hashTableUsage(const char* component, const Hash& table) {
+    const size_t nodeBytes = sizeof(void*) + sizeof(typename Hash::value_type) + sizeof(size_t);
+    size_t buckets = table.bucket_count();
+    return {component, table.size(), buckets,
+            buckets * sizeof(void*) + table.size() * nodeBytes,
+            (buckets - min(buckets, table.size())) * sizeof(void*), 0};
+}
+
+/**
+ * @brief Walks every structure of the store and reports what it holds.
+ *
+ * @return vector<MemoryUsage> One row per component, in display order.
+ */
+vector<MemoryUsage> InventoryStore::memoryUsage() const {
+    vector<MemoryUsage> rows;
+
+    // Records hold no heap memory of their own: text is interned, dates inline
+    rows.push_back({"items", items.size(), items.capacity(),
+                    items.capacity() * sizeof(Item),
+                    (items.capacity() - items.size()) * sizeof(Item), 0});
+    rows.push_back({"sales", sales.size(), sales.capacity(),
+                    sales.capacity() * sizeof(Sale),
+                    (sales.capacity() - sales.size()) * sizeof(Sale), 0});
+
+    // The cold string heap: chunk bytes, of which the unused tail is slack
+    size_t heap = strings.reservedBytes();
+    rows.push_back({"strings", strings.index.size(), strings.index.size(), 0,
+                    heap - strings.usedBytes(), heap});
+
+    rows.push_back(hashTableUsage("string index", strings.index));
+    // Indexes still being built are left out rather than read mid-build
+    if (indexReady_[ID_INDEX].load(memory_order_acquire)) rows.push_back(hashTableUsage("id index", idIndex));
+    if (indexReady_[ID_TREE].load(memory_order_acquire)) {
+        rows.push_back({"id tree", idTree.size(), idTree.size(), idTree.nodeBytes(), 0, 0});
+    }
+    if (indexReady_[NAME_TREE].load(memory_order_acquire)) {
+        rows.push_back({"name tree", nameTree.size(), nameTree.size(), nameTree.nodeBytes(), 0, 0});
+    }
+    return rows;
+}
+
+/**
+ * @brief Memory breakdown of the default store.
+ */
+vector<MemoryUsage> collectMemoryUsage() {
+    return defaultStore.memoryUsage();
+}
+
+/**
+ * @brief Prints a memory breakdown table with a total row.
+ */
+void printMemoryUsage(const vector<MemoryUsage>& rows) {
+    cout << left << setw(12) << "Component" << right
+         << setw(10) << "Count" << setw(10) << "Capacity"
+         << setw(12) << "Records(B)" << setw(10) << "Slack(B)"
+         << setw(12) << "Strings(B)" << setw(12) << "Total(B)" << "\n";
+
+    MemoryUsage total = {"total", 0, 0, 0, 0, 0};
+    for (const auto& r : rows) {
+        cout << left << setw(12) << r.component << right
+             << setw(10) << r.count << setw(10) << r.capacity
+             << setw(12) << r.recordBytes << setw(10) << r.slackBytes
+             << setw(12) << r.heapBytes << setw(12) << r.totalBytes() << "\n";
+        total.recordBytes += r.recordBytes;
+        total.slackBytes += r.slackBytes;
+        total.heapBytes += r.heapBytes;
+    }
+    cout << left << setw(12) << total.component << right
+         << setw(10) << "" << setw(10) << ""
+         << setw(12) << total.recordBytes << setw(10) << total.slackBytes
+         << setw(12) << total.heapBytes << setw(12) << total.totalBytes() << "\n";
+}
+
+/* ================= PERFORMANCE COUNTERS ================= */
+// Optional hardware counters, read as one perf_event group on Linux. When perf
+// is unavailable (other platforms, containers, perf_event_paranoid) perf_init()
+// returns false and every PerfScope costs a single branch. All counter state
+// is per thread: each thread that calls perf_init() opens its own group and
+// collects its own statistics.
+
+enum PerfCounter { PERF_CYCLES, PERF_INSTRUCTIONS, PERF_CACHE_MISSES, PERF_BRANCH_MISSES, PERF_COUNTER_COUNT };
+static const char* const PERF_COUNTER_NAMES[PERF_COUNTER_COUNT] = {
+    "cycles", "instructions", "cache-misses", "branch-misses"
+};
+
+/**
+ * @brief Accumulated counter deltas for one named scope.
+ */
+struct PerfStats {
+    const char* name;                                   ///< Scope name (string literal)
+    unsigned long long calls;                           ///< Completed scopes
+    unsigned long long totals[PERF_COUNTER_COUNT];      ///< Summed deltas per counter
+};
+
+static thread_local bool perfEnabled = false;           ///< True once this thread opened its counter group
+static thread_local int perfLeaderFd = -1;              ///< Group leader; reading it returns every member
+static thread_local int perfSlot[PERF_COUNTER_COUNT];   ///< Position of each counter in the group read, -1 if missing
+static thread_local int perfOpened = 0;                 ///< Number of counters in the group
+static thread_local vector<PerfStats> perfStats;
+
+/**
+ * @brief Opens the hardware counter group for this thread.
+ *
+ * Counters the CPU or kernel refuses are left out; the rest still work.
+ * Only the calling thread is measured; scopes on other threads are skipped
+ * unless they call perf_init() too, and then land in their own statistics.
+ * @return true If at least one counter is available.
+ */
+bool perf_init() {
+    if (perfEnabled) return true;
+    fill(begin(perfSlot), end(perfSlot), -1);
+#ifdef __linux__
+    static const unsigned long long configs[PERF_COUNTER_COUNT] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES
+    };
+    for (int i = 0; i < PERF_COUNTER_COUNT; ++i) {
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = configs[i];
+        attr.read_format = PERF_FORMAT_GROUP;
+        attr.disabled = (perfLeaderFd == -1);
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        int fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, perfLeaderFd, 0));
+        if (fd == -1) continue;
+        if (perfLeaderFd == -1) perfLeaderFd = fd;
+        perfSlot[i] = perfOpened++;
+    }
+    if (perfLeaderFd != -1) {
+        ioctl(perfLeaderFd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(perfLeaderFd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        perfEnabled = true;
+    }
+#endif
+    return perfEnabled;
+}
+
+// Reads all counters of the group in one syscall.
+static bool perf_read(unsigned long long out[PERF_COUNTER_COUNT]) {
+#ifdef __linux__
+    unsigned long long buf[1 + PERF_COUNTER_COUNT];
+    if (read(perfLeaderFd, buf, sizeof(buf)) < static_cast<ssize_t>(sizeof(unsigned long long) * (1 + perfOpened))) {
+        return false;
+    }
+    for (int i = 0; i < PERF_COUNTER_COUNT; ++i) {
+        out[i] = perfSlot[i] >= 0 ? buf[1 + perfSlot[i]] : 0;
+    }
+    return true;
+#else
+    (void)out;
+    return false;
+#endif
+}
+
+static PerfStats& perf_stats(const char* name) {
+    for (auto& st : perfStats) {
+        if (st.name == name || strcmp(st.name, name) == 0) return st;
+    }
+    perfStats.push_back({name, 0, {0, 0, 0, 0}});
+    return perfStats.back();
+}
+
+/**
+ * @brief Clears the calling thread's accumulated per-scope statistics.
+ */
+void perf_reset() {
+    perfStats.clear();
+}
+
+/**
+ * @brief Attributes the counter deltas between construction and destruction to a named scope.
+ */
+class PerfScope {
+public:
+    explicit PerfScope(const char* name) : name_(name), active_(perfEnabled && perf_read(start_)) {}
+    ~PerfScope() {
+        unsigned long long now[PERF_COUNTER_COUNT];
+        if (!active_ || !perf_read(now)) return;
+        PerfStats& st = perf_stats(name_);
+        ++st.calls;
+        for (int i = 0; i < PERF_COUNTER_COUNT; ++i) st.totals[i] += now[i] - start_[i];
+    }
+    PerfScope(const PerfScope&) = delete;
+    PerfScope& operator=(const PerfScope&) = delete;
+private:
+    const char* name_;
+    bool active_;
+    unsigned long long start_[PERF_COUNTER_COUNT];
+};
+
+/**
+ * @brief Prints per-call counter averages for every scope the calling thread has seen.
+ */
+void printPerfStats() {
+    cout << left << setw(18) << "Operation" << right << setw(10) << "Calls";
+    for (int i = 0; i < PERF_COUNTER_COUNT; ++i) {
+        if (perfSlot[i] >= 0) cout << setw(15) << PERF_COUNTER_NAMES[i];
+    }
+    cout << setw(8) << "IPC" << "\n";
+    for (const auto& st : perfStats) {
+        if (st.calls == 0) continue;
+        cout << left << setw(18) << st.name << right << setw(10) << st.calls;
+        for (int i = 0; i < PERF_COUNTER_COUNT; ++i) {
+            if (perfSlot[i] >= 0) cout << setw(15) << st.totals[i] / st.calls;
+        }
+        if (perfSlot[PERF_CYCLES] >= 0 && perfSlot[PERF_INSTRUCTIONS] >= 0 && st.totals[PERF_CYCLES] > 0) {
+            cout << setw(8) << fixed << setprecision(2)
+                 << double(st.totals[PERF_INSTRUCTIONS]) / st.totals[PERF_CYCLES];
+            cout.unsetf(ios::floatfield);
+            cout << setprecision(6);
+        }
+        cout << "\n";
+    }
+}
+
+/* ================= ALLOCATION TRACKING ================= */
+// UNIT_TEST and ALLOC_TRACKING builds replace the global operator new/delete
+// with counting versions, so tests and benchmarks can check that a code path
+// stays off the heap. Counts are per thread: background threads such as the
+// metrics exporter do not disturb a measurement.
+
+#if defined(UNIT_TEST) || defined(ALLOC_TRACKING)
+const bool allocTrackingEnabled = true;
+static thread_local unsigned long long threadAllocations = 0;
+
+// Kept out of line so GCC does not pair the inlined malloc()/free() and flag a new/delete mismatch
+__attribute__((noinline)) void* operator new(size_t size) {
+    ++threadAllocations;
+    if (void* p = malloc(size ? size : 1)) return p;
+    throw bad_alloc();
+}
+void* operator new[](size_t size) { return operator new(size); }
+__attribute__((noinline)) void operator delete(void* p) noexcept { free(p); }
+__attribute__((noinline)) void operator delete[](void* p) noexcept { free(p); }
+__attribute__((noinline)) void operator delete(void* p, size_t) noexcept { free(p); }
+__attribute__((noinline)) void operator delete[](void* p, size_t) noexcept { free(p); }
+
+/**
+ * @brief Heap allocations made by the calling thread so far.
+ */
+unsigned long long allocationCount() { return threadAllocations; }
+#else
+const bool allocTrackingEnabled = false;
+unsigned long long allocationCount() { return 0; }
+#endif
+
+static int allocationCheckFailures = 0; ///< Number of ScopedAllocationCheck violations so far
+
+/**
+ * @brief Checks that a scope makes at most `allowed` heap allocations on this thread.
+ *
+ * A violation is reported on cerr and counted in allocationCheckFailures.
+ * Without allocation tracking compiled in, the check always passes.
+ */
+class ScopedAllocationCheck {
+public:
+    explicit ScopedAllocationCheck(const char* what, unsigned long long allowed = 0)
+        : what_(what), allowed_(allowed), start_(allocationCount()) {}
+    ~ScopedAllocationCheck() {
+        if (allocations() > allowed_) {
+            cerr << " [AllocCheck] " << what_ << ": " << allocations()
+                 << " heap allocations, expected at most " << allowed_ << "\n";
+            ++allocationCheckFailures;
+        }
+    }
+    unsigned long long allocations() const { return allocationCount() - start_; }
+    ScopedAllocationCheck(const ScopedAllocationCheck&) = delete;
+    ScopedAllocationCheck& operator=(const ScopedAllocationCheck&) = delete;
+private:
+    const char* what_;
+    unsigned long long allowed_;
+    unsigned long long start_;
+};
+
+/* ================= TRACING ================= */
+// Scoped spans recorded into per-thread buffers and exported as Chrome
+// trace-event JSON (open in chrome://tracing or ui.perfetto.dev). While
+// tracing is off a TraceSpan costs one branch.
+
+/**
+ * @brief One completed span.
+ */
+struct TraceEvent {
+    const char* name;       ///< Span name (string literal)
+    const char* category;   ///< Trace category (string literal)
+    long long startNs;      ///< Start, relative to traceOrigin
+    long long durationNs;   ///< Duration
+};
+
+struct TraceBuffer {
+    int tid;
+    vector<TraceEvent> events;
+};
+
+static bool traceEnabled = false;
+static chrono::steady_clock::time_point traceOrigin;
+static mutex traceMutex;                                ///< Guards traceBuffers, not the buffers themselves
+static vector<shared_ptr<TraceBuffer>> traceBuffers;    ///< Every thread's buffer, kept alive for export
+
+static inline long long trace_nowNs() {
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - traceOrigin).count();
+}
+
+static TraceBuffer& trace_threadBuffer() {
+    thread_local shared_ptr<TraceBuffer> buffer;
+    if (!buffer) {
+        buffer = make_shared<TraceBuffer>();
+        lock_guard<mutex> lock(traceMutex);
+        buffer->tid = static_cast<int>(traceBuffers.size()) + 1;
+        traceBuffers.push_back(buffer);
+    }
+    return *buffer;
+}
+
+/**
+ * @brief Starts recording spans. Timestamps are relative to this call.
+ */
+void trace_enable() {
+    traceOrigin = chrono::steady_clock::now();
+    traceEnabled = true;
+}
+
+/**
+ * @brief Records the time between construction and destruction as a span.
+ */
+class TraceSpan {
+public:
+    explicit TraceSpan(const char* name, const char* category = "app")
+        : name_(name), category_(category), startNs_(traceEnabled ? trace_nowNs() : -1) {}
+    ~TraceSpan() {
+        if (startNs_ < 0) return;
+        trace_threadBuffer().events.push_back({name_, category_, startNs_, trace_nowNs() - startNs_});
+    }
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+private:
+    const char* name_;
+    const char* category_;
+    long long startNs_;
+};
+
+/**
+ * @brief Writes all recorded spans as Chrome trace-event JSON.
+ *
+ * Call when no other thread is recording.
+ * @param path Output file.
+ * @return true If the file was written.
+ */
+bool trace_write(const string& path) {
+    ofstream out(path);
+    if (!out.is_open()) return false;
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    bool first = true;
+    lock_guard<mutex> lock(traceMutex);
+    out << fixed << setprecision(3);
+    for (const auto& buffer : traceBuffers) {
+        for (const auto& ev : buffer->events) {
+            out << (first ? "\n" : ",\n")
+                << "{\"name\":\"" << ev.name << "\",\"cat\":\"" << ev.category
+                << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->tid
+                << ",\"ts\":" << ev.startNs / 1000.0 << ",\"dur\":" << ev.durationNs / 1000.0 << "}";
+            first = false;
+        }
+    }
+    out << "\n]}\n";
+    return out.good();
+}
+
+static string traceOutput;  ///< Set by trace_writeAtExit
+
+static void trace_writeOutput() {
+    if (trace_write(traceOutput)) {
+        cout << " [Saved] Trace to " << traceOutput << endl;
+    } else {
+        cout << " [Error] Could not write trace!\n";
+    }
+}
+
+/**
+ * @brief Writes the trace to @p path when the process exits.
+ *
+ * Runs on every return from main and on exit(), so error paths keep their
+ * trace too. Only a crash or an unhandled signal loses it.
+ * @param path Output file.
+ */
+void trace_writeAtExit(const string& path) {
+    if (traceOutput.empty()) atexit(trace_writeOutput);
+    traceOutput = path;
+}
+
+/* ================= METRICS ================= */
+// Counters, gauges and histograms updated from the logic and persistence
+// paths with relaxed atomics, so recording never takes a lock. A background
+// exporter periodically writes them to a file in Prometheus text format.
+
+/**
+ * @brief Base class for a named metric; registers itself for export.
+ */
+class Metric {
+public:
+    Metric(const char* name, const char* help, const char* type) : name_(name), help_(help), type_(type) {
+        registry().push_back(this);
+    }
+    virtual ~Metric() {}
+    virtual void writeSamples(ostream& out) const = 0;
+
+    void write(ostream& out) const {
+        out << "# HELP " << name_ << " " << help_ << "\n";
+        out << "# TYPE " << name_ << " " << type_ << "\n";
+        writeSamples(out);
+    }
+
+    static vector<const Metric*>& registry() {
+        static vector<const Metric*> metrics;
+        return metrics;
+    }
+protected:
+    const char* name_;
+    const char* help_;
+    const char* type_;
+};
+
+// Lock-free add for atomic<double> (fetch_add on floating point is C++20).
+static inline void atomicAdd(atomic<double>& target, double delta) {
+    double cur = target.load(memory_order_relaxed);
+    while (!target.compare_exchange_weak(cur, cur + delta, memory_order_relaxed)) {}
+}
+
+/**
+ * @brief Monotonically increasing value. Negative deltas are ignored, since
+ * scrapers read any decrease as a counter reset.
+ */
+class MetricCounter : public Metric {
+public:
+    MetricCounter(const char* name, const char* help) : Metric(name, help, "counter"), value_(0) {}
+    void add(double delta = 1) {
+        if (delta > 0) atomicAdd(value_, delta);
+    }
+    double value() const { return value_.load(memory_order_relaxed); }
+    void writeSamples(ostream& out) const override { out << name_ << " " << value() << "\n"; }
+private:
+    atomic<double> value_;
+};
+
+/**
+ * @brief Value that can go up and down.
+ */
+class MetricGauge : public Metric {
+public:
+    MetricGauge(const char* name, const char* help) : Metric(name, help, "gauge"), value_(0) {}
+    void set(double v) { value_.store(v, memory_order_relaxed); }
+    void add(double delta) { atomicAdd(value_, delta); }
+    double value() const { return value_.load(memory_order_relaxed); }
+    void writeSamples(ostream& out) const override { out << name_ << " " << value() << "\n"; }
+private:
+    atomic<double> value_;
+};
+
+/**
+ * @brief Distribution of observed values over fixed cumulative buckets.
+ */
+class MetricHistogram : public Metric {
+public:
+    MetricHistogram(const char* name, const char* help, vector<double> bounds)
+        : Metric(name, help, "histogram"), bounds_(move(bounds)), buckets_(bounds_.size() + 1), sum_(0) {}
+
+    void observe(double v) {
+        size_t i = upper_bound(bounds_.begin(), bounds_.end(), v) - bounds_.begin();
+        if (i > 0 && bounds_[i - 1] == v) --i;  // buckets are inclusive (le)
+        buckets_[i].fetch_add(1, memory_order_relaxed);
+        atomicAdd(sum_, v);
+    }
+
+    void writeSamples(ostream& out) const override {
+        unsigned long long cumulative = 0;
+        for (size_t i = 0; i < bounds_.size(); ++i) {
+            cumulative += buckets_[i].load(memory_order_relaxed);
+            out << name_ << "_bucket{le=\"" << bounds_[i] << "\"} " << cumulative << "\n";
+        }
+        cumulative += buckets_.back().load(memory_order_relaxed);
+        out << name_ << "_bucket{le=\"+Inf\"} " << cumulative << "\n";
+        out << name_ << "_sum " << sum_.load(memory_order_relaxed) << "\n";
+        out << name_ << "_count " << cumulative << "\n";
+    }
+private:
+    vector<double> bounds_;
+    vector<atomic<unsigned long long>> buckets_;
+    atomic<double> sum_;
+};
+
+static const vector<double> DURATION_BUCKETS = {0.001, 0.005, 0.01, 0.05, 0.1, 0.5, 1, 5};
+
+MetricCounter metricSales("inventory_sales_total", "Sales recorded.");
+MetricCounter metricUnitsSold("inventory_units_sold_total", "Units sold.");
+// Profit can be negative, so it is exported as revenue and cost: profit = revenue - cost
+MetricCounter metricRevenue("inventory_revenue_total", "Revenue from recorded sales, at selling price.");
+MetricCounter metricCost("inventory_cost_total", "Cost of the units sold, at purchase price.");
+MetricGauge metricItems("inventory_items", "Items in the inventory.");
+MetricGauge metricLowStock("inventory_low_stock_items", "Items at or below the low stock threshold.");
+MetricGauge metricMemory("inventory_memory_bytes", "Bytes the store's arena held at the last load or save.");
+MetricHistogram metricSaveSeconds("inventory_save_duration_seconds", "Time taken by saveData.", DURATION_BUCKETS);
+MetricHistogram metricLoadSeconds("inventory_load_duration_seconds", "Time taken by loadData.", DURATION_BUCKETS);
+
+// Recomputes the table-level gauges after the tables were replaced or saved.
+// Items a backend serves are counted by a scan, so only after a load
+// (countServed); the mutators keep the gauges in step from there.
+static void metrics_refreshTables(const InventoryStore& store, bool countServed = false) {
+    metricMemory.set(store.arenaUpstream().bytesInUse());
+    if (store.itemsServed() && !countServed) return;
+    size_t count = 0;
+    int low = 0;
+    auto tally = [&](const Item& item) {
+        ++count;
+        low += item.quantity <= LOW_STOCK_THRESHOLD;
+    };
+    if (store.itemsServed()) {
+        store.forEachItem([&](const Item& item, string_view, string_view) { tally(item); });
+    } else {
+        for (const auto& item : store.items) tally(item);
+    }
+    metricItems.set(count);
+    metricLowStock.set(low);
+}
+
+// Keeps the low stock gauge in step with a quantity change of one item.
+static inline void metrics_stockChanged(int oldQty, int newQty) {
+    metricLowStock.add((newQty <= LOW_STOCK_THRESHOLD) - (oldQty <= LOW_STOCK_THRESHOLD));
+}
+
+/**
+ * @brief Replaces a file with another in one step (rename over the target).
+ */
+static bool replaceFile(const string& from, const string& to) {
+    error_code ec;
+    filesystem::rename(from, to, ec);
+    return !ec;
+}
+
+/**
+ * @brief Writes every registered metric in Prometheus text format.
+ *
+ * The file is written to a temporary name and renamed over the target, so
+ * a scraper never sees a partial file.
+ * @return true If the file was replaced.
+ */
+bool metrics_write(const string& path) {
+    ostringstream out;
+    out.precision(15);
+    for (const Metric* m : Metric::registry()) m->write(out);
+#ifdef __linux__
+    // Resident set size straight from the kernel; safe to read from any thread
+    ifstream statm("/proc/self/statm");
+    long pages, residentPages;
+    if (statm >> pages >> residentPages) {
+        out << "# HELP process_resident_memory_bytes Resident memory size in bytes.\n"
+            << "# TYPE process_resident_memory_bytes gauge\n"
+            << "process_resident_memory_bytes " << residentPages * sysconf(_SC_PAGESIZE) << "\n";
+    }
+#endif
+    string tmp = path + ".tmp";
+    {
+        ofstream file(tmp);
+        if (!file.is_open()) return false;
+        file << out.str();
+        if (!file.good()) return false;
+    }
+    return replaceFile(tmp, path);
+}
+
+static thread metricsThread;
+static mutex metricsMutex;
+static condition_variable metricsWake;
+static bool metricsStopping = false;
+
+/**
+ * @brief Starts a background thread that writes the metrics file every intervalMs.
+ */
+void metrics_startExporter(const string& path, int intervalMs) {
+    metricsStopping = false;
+    metricsThread = thread([path, intervalMs]() {
+        unique_lock<mutex> lock(metricsMutex);
+        while (!metricsStopping) {
+            lock.unlock();
+            metrics_write(path);
+            lock.lock();
+            metricsWake.wait_for(lock, chrono::milliseconds(intervalMs), [] { return metricsStopping; });
+        }
+        lock.unlock();
+        metrics_write(path);  // final snapshot
+    });
+}
+
+/**
+ * @brief Stops the exporter after it writes one last snapshot.
+ */
+void metrics_stopExporter() {
+    if (!metricsThread.joinable()) return;
+    {
+        lock_guard<mutex> lock(metricsMutex);
+        metricsStopping = true;
+    }
+    metricsWake.notify_all();
+    metricsThread.join();
+}
+
+/* ================= TASK SCHEDULER ================= */
+// One process-wide pool runs every parallel path: shop aggregation, sharded
+// save and load, large searches, profit totals and formatted exports. Features
+// hand it ranges through parallelFor()/parallelReduce() instead of starting
+// threads of their own, so they share the cores rather than oversubscribe them.
+
+/**
+ * @brief Work-stealing scheduler shared by the whole process.
+ *
+ * Each worker owns a deque: it pushes and pops its own tasks at the back and,
+ * when that is empty, steals from the front of the other deques, starting at
+ * a random victim. Stolen tasks are the oldest and so the largest halves of a
+ * split range, which spreads skewed work without a central queue. Threads
+ * outside the pool queue into a shared slot of their own. A thread waiting on
+ * a TaskGroup runs queued tasks while there are any, so the caller is one of
+ * the threads() that execute a loop and nested loops cannot deadlock; once
+ * nothing is queued it sleeps until its group finishes or new work arrives.
+ * Workers start on first use; configure() changes their number and pinning.
+ */
+class TaskScheduler {
+public:
+    /**
+     * @brief Tasks forked together; wait() returns once all of them have run.
+     */
+    class TaskGroup {
+    public:
+        explicit TaskGroup(TaskScheduler& scheduler) : scheduler_(scheduler) {}
+        ~TaskGroup() { wait(); }
+        TaskGroup(const TaskGroup&) = delete;
+        TaskGroup& operator=(const TaskGroup&) = delete;
+
+        /**
+         * @brief Queues a task. Tasks must not throw.
+         *
+         * The callable is copied into the task itself, so queueing does not
+         * allocate; it must be trivially copyable and fit in Task::CAPACITY.
+         */
+        template <class F>
+        void run(const F& task) {
+            static_assert(sizeof(F) <= Task::CAPACITY && alignof(F) <= alignof(Task) &&
+                          is_trivially_copyable<F>::value && is_trivially_destructible<F>::value,
+                          "task does not fit inline");
+            Task queued;
+            new (queued.args) F(task);
+            queued.call = [](const void* args) { (*static_cast<const F*>(args))(); };
+            queued.group = this;
+            pending_.fetch_add(1, memory_order_relaxed);
+            scheduler_.push(queued);
+        }
+
+        /// Runs queued tasks (this group's or any other) until the group is
+        /// done, sleeping once a few attempts find nothing to run.
+        void wait() {
+            int misses = 0;
+            while (pending_.load(memory_order_acquire) != 0) {
+                if (scheduler_.runOne()) {
+                    misses = 0;
+                } else if (++misses < WAIT_SPINS) {
+                    this_thread::yield();
+                } else {
+                    scheduler_.sleepUntilDone(*this);
+                    misses = 0;
+                }
+            }
+        }
+
+    private:
+        friend class TaskScheduler;
+        TaskScheduler& scheduler_;
+        atomic<size_t> pending_{0};
+    };
+
+    TaskScheduler() = default;
+    ~TaskScheduler() { stop(); }
+    TaskScheduler(const TaskScheduler&) = delete;
+    TaskScheduler& operator=(const TaskScheduler&) = delete;
+
+    /**
+     * @brief Sets how many threads run tasks and whether workers are pinned.
+     *
+     * Must not be called while tasks are queued or running.
+     * @param threads Threads executing a loop, counting the waiting caller; 0 means one per core.
+     * @param pin Pin worker i to the i-th CPU this process may use (Linux only).
+     */
+    void configure(unsigned threads, bool pin = false) {
+        lock_guard<mutex> lock(configMutex_);
+        stop();
+        threads_ = threads;
+        pin_ = pin;
+    }
+
+    /// Whether configure() asked for pinned workers.
+    bool pinning() const { return pin_; }
+
+    /// Threads that execute a parallel loop: the workers plus the caller.
+    unsigned threads() const {
+        return threads_ ? threads_ : max(1u, thread::hardware_concurrency());
+    }
+
+    /// Workers pinned to a CPU; 0 if pinning is off or unsupported.
+    unsigned pinnedWorkers() const { return pinned_.load(memory_order_relaxed); }
+
+    /// Slot of the calling thread: 1..threads()-1 for workers, 0 for any other thread.
+    static unsigned currentSlot() { return currentSlot_; }
+
+    /// Tasks taken from another slot's deque since the workers started.
+    uint64_t steals() const { return steals_.load(memory_order_relaxed); }
+
+    /**
+     * @brief Calls body(lo, hi) on disjoint subranges covering [begin, end).
+     *
+     * The range is halved recursively until a piece is at most grain long; a
+     * thread keeps one half and queues the other, so idle threads steal large
+     * pieces first. A range no longer than grain runs inline on the caller.
+     * @param grain Largest piece per call; 0 picks about eight pieces per thread.
+     */
+    template <class Body>
+    void parallelFor(size_t begin, size_t end, size_t grain, const Body& body) {
+        if (begin >= end) return;
+        if (grain == 0) grain = autoGrain(end - begin);
+        if (end - begin <= grain) {
+            body(begin, end);
+            return;
+        }
+        TaskGroup group(*this);
+        splitRange(group, begin, end, grain, body);
+        group.wait();
+    }
+
+    /**
+     * @brief Reduces [begin, end) in pieces of grain and combines them in order.
+     *
+     * map(lo, hi) produces each piece's value. The pieces do not depend on
+     * the thread count and are combined left to right, so floating-point sums
+     * come out the same however the work was scheduled.
+     */
+    template <class T, class Map, class Combine>
+    T parallelReduce(size_t begin, size_t end, size_t grain, T identity, const Map& map, const Combine& combine) {
+        if (begin >= end) return identity;
+        if (grain == 0) grain = autoGrain(end - begin);
+        size_t pieces = (end - begin + grain - 1) / grain;
+        if (pieces == 1) return combine(move(identity), map(begin, end));
+        vector<T> partial(pieces, identity);
+        parallelFor(0, pieces, 1, [&](size_t lo, size_t hi) {
+            for (size_t p = lo; p < hi; ++p) partial[p] = map(begin + p * grain, min(end, begin + (p + 1) * grain));
+        });
+        T result = move(identity);
+        for (T& value : partial) result = combine(move(result), move(value));
+        return result;
+    }
+
+private:
+    static constexpr int WAIT_SPINS = 64;   ///< Failed tries to find a task before TaskGroup::wait() sleeps
+
+    /// A queued call: a function pointer and its captures stored inline, one cache line in all.
+    struct alignas(64) Task {
+        static constexpr size_t CAPACITY = 48;
+        void (*call)(const void* args);
+        TaskGroup* group;
+        alignas(16) unsigned char args[CAPACITY];
+    };
+
+    /// One deque; slot 0 is shared by threads outside the pool.
+    struct alignas(64) Slot {
+        mutex lock;
+        deque<Task> tasks;
+        thread worker;
+        uint64_t rng = 0;   ///< xorshift state for picking victims
+    };
+
+    size_t autoGrain(size_t n) const { return max<size_t>(1, n / (8 * threads())); }
+
+    template <class Body>
+    static void splitRange(TaskGroup& group, size_t begin, size_t end, size_t grain, const Body& body) {
+        while (end - begin > grain) {
+            size_t mid = begin + (end - begin) / 2;
+            group.run([&group, mid, end, grain, &body] { splitRange(group, mid, end, grain, body); });
+            end = mid;
+        }
+        body(begin, end);
+    }
+
+    void start() {
+        lock_guard<mutex> lock(configMutex_);
+        if (started_.load(memory_order_relaxed)) return;
+        unsigned workers = threads() - 1;
+        slots_.clear();
+        for (unsigned i = 0; i <= workers; ++i) slots_.push_back(make_unique<Slot>());
+        stopping_ = false;
+        pinned_ = 0;
+        random_device seed;
+        for (unsigned i = 1; i <= workers; ++i) {
+            slots_[i]->rng = (uint64_t(seed()) << 32 | seed()) | 1;
+            slots_[i]->worker = thread([this, i] { workerLoop(i); });
+        }
+        started_.store(true, memory_order_release);
+    }
+
+    void stop() {
+        if (!started_.load(memory_order_acquire)) return;
+        {
+            lock_guard<mutex> lock(sleepMutex_);
+            stopping_ = true;
+        }
+        wake_.notify_all();
+        for (size_t i = 1; i < slots_.size(); ++i) slots_[i]->worker.join();
+        started_.store(false, memory_order_release);
+    }
+
+    void push(const Task& task) {
+        if (!started_.load(memory_order_acquire)) start();
+        unsigned slot = currentScheduler_ == this ? currentSlot_ : 0;
+        {
+            lock_guard<mutex> lock(slots_[slot]->lock);
+            slots_[slot]->tasks.push_back(task);
+        }
+        // Paired with the sleeper count in workerLoop(): one side always sees the other
+        queued_.fetch_add(1);
+        if (sleepers_.load() > 0) {
+            lock_guard<mutex> lock(sleepMutex_);
+            wake_.notify_one();
+        }
+    }
+
+    /// Takes a task: the caller's own newest first, then the oldest of another slot.
+    bool take(unsigned self, uint64_t& rng, Task& task) {
+        {
+            Slot& own = *slots_[self];
+            lock_guard<mutex> lock(own.lock);
+            if (!own.tasks.empty()) {
+                task = move(own.tasks.back());
+                own.tasks.pop_back();
+                queued_.fetch_sub(1);
+                return true;
+            }
+        }
+        size_t n = slots_.size();
+        rng ^= rng << 13;
+        rng ^= rng >> 7;
+        rng ^= rng << 17;
+        size_t first = rng % n;
+        for (size_t k = 0; k < n; ++k) {
+            size_t victim = (first + k) % n;
+            if (victim == self) continue;
+            Slot& other = *slots_[victim];
+            lock_guard<mutex> lock(other.lock);
+            if (other.tasks.empty()) continue;
+            task = move(other.tasks.front());
+            other.tasks.pop_front();
+            queued_.fetch_sub(1);
+            steals_.fetch_add(1, memory_order_relaxed);
+            return true;
+        }
+        return false;
+    }
+
+    void execute(const Task& task) {
+        task.call(task.args);
+        // The group may be gone once pending_ drops; a waiter sleeps on the
+        // scheduler's condition variable, so only scheduler state is touched after
+        if (task.group->pending_.fetch_sub(1) == 1 && sleepers_.load() > 0) {
+            lock_guard<mutex> lock(sleepMutex_);
+            wake_.notify_all();
+        }
+    }
+
+    /// Blocks a TaskGroup::wait() caller until its group is done or a task is queued.
+    void sleepUntilDone(const TaskGroup& group) {
+        unique_lock<mutex> lock(sleepMutex_);
+        // Paired with execute() and push(): either they see the sleeper or it sees their change
+        sleepers_.fetch_add(1);
+        wake_.wait(lock, [this, &group] { return group.pending_.load() == 0 || queued_.load() > 0; });
+        sleepers_.fetch_sub(1);
+    }
+
+    /// Runs one queued task on the calling thread; false if none was found.
+    bool runOne() {
+        static thread_local uint64_t rng = 0x9e3779b97f4a7c15ull ^ hash<thread::id>()(this_thread::get_id());
+        if (queued_.load(memory_order_relaxed) == 0) return false;
+        Task task;
+        if (!take(currentScheduler_ == this ? currentSlot_ : 0, rng, task)) return false;
+        execute(task);
+        return true;
+    }
+
+    void workerLoop(unsigned self) {
+        currentScheduler_ = this;
+        currentSlot_ = self;
+        if (pin_ && pinToCpu(self - 1)) pinned_.fetch_add(1, memory_order_relaxed);
+        Slot& slot = *slots_[self];
+        Task task;
+        for (;;) {
+            if (take(self, slot.rng, task)) {
+                execute(task);
+                continue;
+            }
+            unique_lock<mutex> lock(sleepMutex_);
+            sleepers_.fetch_add(1);
+            wake_.wait(lock, [this] { return stopping_ || queued_.load() > 0; });
+            sleepers_.fetch_sub(1);
+            if (stopping_ && queued_.load() == 0) return;
+        }
+    }
+
+    // Pins the calling worker to the n-th CPU in the process's allowed set.
+    static bool pinToCpu(unsigned n) {
+#ifdef __linux__
+        cpu_set_t allowed;
+        if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) return false;
+        int count = CPU_COUNT(&allowed);
+        if (count == 0) return false;
+        int target = static_cast<int>(n % count);
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (!CPU_ISSET(cpu, &allowed)) continue;
+            if (target-- > 0) continue;
+            cpu_set_t one;
+            CPU_ZERO(&one);
+            CPU_SET(cpu, &one);
+            return pthread_setaffinity_np(pthread_self(), sizeof(one), &one) == 0;
+        }
+        return false;
+#else
+        (void)n;
+        return false;
+#endif
+    }
+
+    static thread_local TaskScheduler* currentScheduler_;
+    static thread_local unsigned currentSlot_;
+
+    vector<unique_ptr<Slot>> slots_;
+    mutex configMutex_;
+    atomic<bool> started_{false};
+    unsigned threads_ = 0;            ///< Requested thread count; 0 for one per core
+    bool pin_ = false;
+    atomic<unsigned> pinned_{0};
+    atomic<size_t> queued_{0};        ///< Tasks in all deques
+    atomic<uint64_t> steals_{0};
+    mutex sleepMutex_;
+    condition_variable wake_;         ///< Signals idle workers and waiters: new task, finished group or shutdown
+    atomic<unsigned> sleepers_{0};
+    bool stopping_ = false;
+};
+
+thread_local TaskScheduler* TaskScheduler::currentScheduler_ = nullptr;
+thread_local unsigned TaskScheduler::currentSlot_ = 0;
+
+/// The scheduler every parallel path in the app uses.
+TaskScheduler scheduler;
+
+/* ================= INVENTORY STORE ================= */
+
+InventoryStore::InventoryStore(const string& itemsPath, const string& salesPath)
+    : arena_(&upstream_), backend_(makeCsvBackend(itemsPath, salesPath)),
+      items(&arena_), sales(&arena_), strings(&arena_), idIndex(&arena_),
+      idTree(&arena_), nameTree(&arena_) {
+    arenaOverhead_ = upstream_.bytesInUse();
+    backend_->open();
+}
+
+// Only a store that has not allocated yet can move its arena to another resource.
+bool InventoryStore::setUpstream(pmr::memory_resource* upstream) {
+    if (upstream_.bytesInUse() != arenaOverhead_) return false;
+    arena_.release();  // just the pool's own bookkeeping, which it re-creates on demand
+    upstream_.setUpstream(upstream);
+    arenaOverhead_ = 0;
+    return true;
+}
+
+// Switches persistence to another backend; the tables are left as they are.
+void InventoryStore::setBackend(unique_ptr<StorageBackend> backend) {
+    backend_->close();
+    backend_ = move(backend);
+    backend_->open();
+    journaling_ = backend_->journals();
+}
+
+InventoryStore::~InventoryStore() {
+    indexCancel_.store(true, memory_order_relaxed);
+    waitForIndexes();
+}
+
+// Looks an item up through the ID index, or by a scan while it is being built.
+// An item the backend serves is read in on first use.
+Item* InventoryStore::findItem(int id) {
+    if (const Item* item = itemById(id)) return const_cast<Item*>(item);
+    if (!itemsServed_) return nullptr;
+    waitForIndexes();  // readInItem() writes the indexes
+    Item* found = nullptr;
+    backend_->readItem(id, [&](const Item& item, string_view name, string_view sizeColor) {
+        found = readInItem(item, name, sizeColor);
+    });
+    return found;
+}
+
+// Adds an item read from the backend to items and the indexes.
+Item* InventoryStore::readInItem(const Item& item, string_view name, string_view sizeColor) {
+    items.push_back(item);
+    items.back().name = strings.intern(name);
+    items.back().size_color = strings.intern(sizeColor);
+    indexItem(items.back(), items.size() - 1);
+    return &items.back();
+}
+
+// Reads in every item the backend holds that keep(item, name) accepts and
+// returns them in ID order. An item already in memory is kept as it is: it
+// may hold a change the backend could not record.
+template <class Keep>
+vector<const Item*> InventoryStore::readIn(Keep keep) {
+    waitForIndexes();
+    vector<int> ids;
+    backend_->scanItems([&](const Item& item, string_view name, string_view sizeColor) {
+        if (!keep(item, name)) return;
+        ids.push_back(item.id);
+        if (!itemById(item.id)) readInItem(item, name, sizeColor);
+    });
+    vector<const Item*> matches;
+    matches.reserve(ids.size());
+    for (int id : ids) matches.push_back(itemById(id));  // items may have moved while the scan added to it
+    return matches;
+}
+
+// Re-derives every item position (the first item wins if an ID repeats) and
+// bulk-loads both B+trees from sorted keys.
+void InventoryStore::rebuildIndexes() {
+    auto start = chrono::steady_clock::now();
+    buildIdIndex();
+    buildIdTree();
+    buildNameTree();
+    indexBuildUs_.store(chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count(),
+                        memory_order_relaxed);
+}
+
+// Progress is published every this many items
+const size_t INDEX_PROGRESS_STEP = 4096;
+
+void InventoryStore::buildIdIndex() {
+    idIndex.clear();
+    idIndex.reserve(items.size());
+    for (size_t i = 0; i < items.size(); ++i) {
+        idIndex.emplace(items[i].id, i);
+        if (i % INDEX_PROGRESS_STEP == 0) {
+            indexDone_[ID_INDEX].store(i, memory_order_relaxed);
+            if (indexCancel_.load(memory_order_relaxed)) return;
+        }
+    }
+    indexDone_[ID_INDEX].store(items.size(), memory_order_relaxed);
+}
+
+// Whether items[pos] is the item its ID resolves to; a repeated ID only indexes its first item.
+bool InventoryStore::indexedAt(size_t pos) const {
+    auto found = idIndex.find(items[pos].id);
+    return found != idIndex.end() && found->second == pos;
+}
+
+// The trees take the items buildIdIndex() kept, so bulkLoad() gets unique keys.
+void InventoryStore::buildIdTree() {
+    vector<pair<int32_t, int32_t>> ids;
+    ids.reserve(items.size());
+    for (size_t i = 0; i < items.size(); ++i) {
+        if (indexedAt(i)) ids.push_back({items[i].id, items[i].id});
+    }
+    sort(ids.begin(), ids.end());
+    if (indexCancel_.load(memory_order_relaxed)) return;
+    idTree.bulkLoad(ids);
+    indexDone_[ID_TREE].store(items.size(), memory_order_relaxed);
+}
+
+void InventoryStore::buildNameTree() {
+    vector<pair<ItemNameKey, int32_t>> names;
+    names.reserve(items.size());
+    for (size_t i = 0; i < items.size(); ++i) {
+        if (indexedAt(i)) names.push_back({{strings.view(items[i].name), items[i].id}, items[i].id});
+    }
+    indexDone_[NAME_TREE].store(items.size() / 2, memory_order_relaxed);  // the sort is the other half
+    ItemNameLess nameLess;
+    sort(names.begin(), names.end(), [&nameLess](const auto& a, const auto& b) { return nameLess(a.first, b.first); });
+    if (indexCancel_.load(memory_order_relaxed)) return;
+    nameTree.bulkLoad(names);
+    indexDone_[NAME_TREE].store(items.size(), memory_order_relaxed);
+}
+
+/**
+ * @brief Builds the indexes on a background thread, marking each one ready
+ * as soon as it is complete.
+ *
+ * The thread reads the tables and writes only the indexes, and the indexes
+ * are the only thing it allocates from the arena. Reads of the tables may run
+ * alongside it, and until an index is ready they scan the tables instead.
+ * The index structures themselves are read only once marked ready, and the
+ * arena's byte counters are atomic, so the status screen and metrics may
+ * read them mid-build. Mutators change the tables and allocate from the
+ * arena too, so they wait for the build (waitForIndexes()).
+ */
+void InventoryStore::startIndexBuild() {
+    waitForIndexes();
+    for (int kind = 0; kind < INDEX_KINDS; ++kind) {
+        indexDone_[kind].store(0, memory_order_relaxed);
+        indexReady_[kind].store(false, memory_order_relaxed);
+    }
+    indexCancel_.store(false, memory_order_relaxed);
+    indexBuilding_.store(true, memory_order_release);
+    indexThread_ = thread([this] {
+        TraceSpan span("build indexes", "persistence");
+        auto start = chrono::steady_clock::now();
+        void (InventoryStore::*build[INDEX_KINDS])() = {&InventoryStore::buildIdIndex, &InventoryStore::buildIdTree,
+                                                        &InventoryStore::buildNameTree};
+        for (int kind = 0; kind < INDEX_KINDS && !indexCancel_.load(memory_order_relaxed); ++kind) {
+            (this->*build[kind])();
+            indexReady_[kind].store(!indexCancel_.load(memory_order_relaxed), memory_order_release);
+        }
+        indexBuildUs_.store(chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count(),
+                            memory_order_relaxed);
+    });
+}
+
+void InventoryStore::waitForIndexes() {
+    if (!indexBuilding_.load(memory_order_acquire)) return;
+    lock_guard<mutex> lock(indexMutex_);
+    if (indexThread_.joinable()) indexThread_.join();
+    indexBuilding_.store(false, memory_order_release);
+}
+
+vector<InventoryStore::IndexProgress> InventoryStore::indexProgress() const {
+    static const char* const names[INDEX_KINDS] = {"id index", "id tree", "name tree"};
+    vector<IndexProgress> progress;
+    for (int kind = 0; kind < INDEX_KINDS; ++kind) {
+        progress.push_back({names[kind], indexReady_[kind].load(memory_order_acquire),
+                            indexDone_[kind].load(memory_order_relaxed), items.size()});
+    }
+    return progress;
+}
+
+void InventoryStore::indexItem(const Item& item, size_t pos) {
+    idIndex.emplace(item.id, pos);
+    idTree.insert(item.id, item.id);
+    nameTree.insert({strings.view(item.name), item.id}, item.id);
+}
+
+int InventoryStore::addItem(const string& name, const string& size, int qty, double buy, double sell, bool* persisted) {
+    return mutate([&] { return addItemLocked(name, size, qty, buy, sell); }, persisted);
+}
+
+int InventoryStore::addItemLocked(string_view name, string_view size, int qty, double buy, double sell) {
+    int id = nextItemId++;
+    items.push_back({id, qty, buy, sell, strings.intern(name), strings.intern(size)});
+    indexItem(items.back(), items.size() - 1);
+    if (publishMetrics) {
+        metricItems.add(1);
+        metrics_stockChanged(LOW_STOCK_THRESHOLD + 1, qty);
+    }
+    record(Mutation::ADD_ITEM, items.back());
+    return id;
+}
+
+// Removes the item at pos and shifts the index entries of the items after it.
+void InventoryStore::eraseItemAt(size_t pos) {
+    idIndex.erase(items[pos].id);
+    idTree.erase(items[pos].id);
+    nameTree.erase({strings.view(items[pos].name), items[pos].id});
+    items.erase(items.begin() + pos);
+    for (size_t i = pos; i < items.size(); ++i) {
+        // A later copy of a repeated ID stays out of the index, as it does in the trees
+        auto found = idIndex.find(items[i].id);
+        if (found != idIndex.end() && found->second == i + 1) found->second = i;
+    }
+    ++erasedSinceCompaction_;
+    compactIfWorthwhile();
+}
+
+// Deleted items leave their text behind; reclaim it once they outnumber the live ones.
+// Not during a commit: the mutations collected so far hold views into the heap.
+void InventoryStore::compactIfWorthwhile() {
+    if (!batch_ && erasedSinceCompaction_ >= STRING_COMPACT_MIN_ERASED && erasedSinceCompaction_ > items.size()) {
+        compactStrings();
+    }
+}
+
+void InventoryStore::compactStrings() {
+    TraceSpan span("compactStrings", "logic");
+    StringPool live(&arena_);
+    for (auto& item : items) {
+        item.name = live.intern(strings.view(item.name));
+        item.size_color = live.intern(strings.view(item.size_color));
+    }
+    for (auto& sale : sales) sale.item_name = live.internView(sale.item_name);
+    swap(strings.chunks, live.chunks);
+    swap(strings.index, live.index);
+    rebuildIndexes();  // the name tree holds views into the old heap
+    erasedSinceCompaction_ = 0;
+}
+
+bool InventoryStore::deleteItem(int id, bool* persisted) {
+    return mutate([&] { return deleteItemLocked(id); }, persisted);
+}
+
+bool InventoryStore::deleteItemLocked(int id) {
+    Item* it = findItem(id);
+    if (!it) return false;
+    if (publishMetrics) {
+        metricItems.add(-1);
+        metrics_stockChanged(it->quantity, LOW_STOCK_THRESHOLD + 1);
+    }
+    eraseItemAt(it - items.data());
+    Item deleted{};
+    deleted.id = id;
+    record(Mutation::DELETE_ITEM, deleted);
+    return true;
+}
+
+bool InventoryStore::updateItem(int id, int qty, double buy, double sell, bool* persisted) {
+    return mutate([&] { return updateItemLocked(id, qty, buy, sell); }, persisted);
+}
+
+bool InventoryStore::updateItemLocked(int id, int qty, double buy, double sell) {
+    Item* it = findItem(id);
+    if (!it) return false;
+    if (publishMetrics) metrics_stockChanged(it->quantity, qty);
+    it->quantity = qty;
+    it->purchase_price = buy;
+    it->selling_price = sell;
+    record(Mutation::UPDATE_ITEM, *it);
+    return true;
+}
+
+int InventoryStore::sellItem(int id, int qty, double& profitOut, bool* persisted) {
+    PerfScope perf("logic_sellItem");
+    TraceSpan span("logic_sellItem", "logic");
+    return mutate([&] { return sellItemLocked(id, qty, profitOut); }, persisted);
+}
+
+int InventoryStore::sellItemLocked(int id, int qty, double& profitOut) {
+    Item* it = findItem(id);
+    if (!it) return 1; // Not found
+
+    if (qty > it->quantity) return 2; // Not enough stock
+
+    double profit = (it->selling_price - it->purchase_price) * qty;
+    if (publishMetrics) metrics_stockChanged(it->quantity, it->quantity - qty);
+    it->quantity -= qty;
+
+    // Record sale. Growth is rare: load() leaves SALES_HEADROOM free slots.
+    if (sales.size() == sales.capacity()) sales.reserve(sales.size() * 2 + SALES_HEADROOM);
+    sales.emplace_back();
+    Sale& sale = sales.back();
+    sale.id = nextSaleId++;
+    sale.item_id = it->id;
+    sale.item_name = strings.view(it->name);
+    sale.quantity_sold = qty;
+    sale.profit = profit;
+    wallClock.format(WallClock::nowNs(), sale.date_sold);
+    record(Mutation::SELL_ITEM, *it, sale);
+
+    if (publishMetrics) {
+        metricSales.add();
+        metricUnitsSold.add(qty);
+        metricRevenue.add(it->selling_price * qty);
+        metricCost.add(it->purchase_price * qty);
+    }
+
+    profitOut = profit;
+    return 0; // Success
+}
+
+Transaction InventoryStore::begin() {
+    return Transaction(*this);
+}
+
+CommitStatus Transaction::commit() {
+    TraceSpan span("commitTransaction", "logic");
+    store_.waitForIndexes();
+    vector<Op> ops;
+    string text;
+    swap(ops, ops_);  // empty again whatever the outcome
+    swap(text, text_);
+    addedIds_.clear();
+    profit_ = 0;
+    failedAt_ = 0;
+    unique_lock<mutex> lock(store_.writeMutex_);
+
+    // Check every operation against the state the earlier ones leave behind
+    pmr::monotonic_buffer_resource scratch;
+    pmr::unordered_map<int, pair<bool, int>> touched(&scratch);  // id -> (exists, quantity) after the ops so far
+    touched.reserve(ops.size());
+    int nextId = store_.nextItemId;
+    for (size_t i = 0; i < ops.size(); ++i) {
+        const Op& op = ops[i];
+        if (op.kind == Mutation::ADD_ITEM) {
+            touched[nextId++] = {true, op.qty};
+            continue;
+        }
+        auto found = touched.find(op.id);
+        if (found == touched.end()) {
+            const Item* item = store_.findItem(op.id);
+            found = touched.emplace(op.id, make_pair(item != nullptr, item ? item->quantity : 0)).first;
+        }
+        pair<bool, int>& state = found->second;
+        failedAt_ = i;
+        if (!state.first) return CommitStatus::ItemNotFound;
+        if (op.kind == Mutation::UPDATE_ITEM) {
+            state.second = op.qty;
+        } else if (op.kind == Mutation::DELETE_ITEM) {
+            state.first = false;
+        } else if (op.qty > state.second) {
+            return CommitStatus::NotEnoughStock;
+        } else {
+            state.second -= op.qty;
+        }
+    }
+    failedAt_ = 0;
+
+    // Nothing can fail now; the journal gets one record for the lot
+    vector<Mutation> batch;
+    if (store_.journaling_) batch.reserve(ops.size());
+    store_.batch_ = &batch;
+    for (const Op& op : ops) {
+        double profit = 0;
+        switch (op.kind) {
+        case Mutation::ADD_ITEM:
+            addedIds_.push_back(store_.addItemLocked(string_view(text).substr(op.text, op.nameLength),
+                                                     string_view(text).substr(op.text + op.nameLength, op.sizeLength),
+                                                     op.qty, op.buy, op.sell));
+            break;
+        case Mutation::UPDATE_ITEM:
+            store_.updateItemLocked(op.id, op.qty, op.buy, op.sell);
+            break;
+        case Mutation::DELETE_ITEM:
+            store_.deleteItemLocked(op.id);
+            break;
+        case Mutation::SELL_ITEM:
+            store_.sellItemLocked(op.id, op.qty, profit);
+            profit_ += profit;
+            break;
+        }
+    }
+    store_.batch_ = nullptr;
+    bool persisted = batch.empty() || store_.backend_->appendBatch(batch.data(), batch.size());
+    store_.compactIfWorthwhile();
+    uint64_t ticket = persisted && !batch.empty() ? store_.backend_->appendedTicket() : 0;
+    lock.unlock();
+
+    // A transaction is always synced, whatever the durability mode of single mutations
+    if (ticket) persisted = store_.backend_->waitDurable(ticket, true);
+    return persisted ? CommitStatus::Committed : CommitStatus::NotPersisted;
+}
+
+vector<const Item*> InventoryStore::searchItems(const string& keyword) {
+    PerfScope perf("logic_searchItems");
+    TraceSpan span("logic_searchItems", "logic");
+    if (itemsServed_) {
+        string lowerKey = toLowerStr(keyword);
+        return readIn([&](const Item&, string_view name) {
+            return simd.containsNoCase(name.data(), name.size(), lowerKey.data(), lowerKey.size());
+        });
+    }
+    return searchTable(keyword);
+}
+
+// searchItems() over the items in memory.
+vector<const Item*> InventoryStore::searchTable(const string& keyword) const {
+    string lowerKey = toLowerStr(keyword);
+    // Large catalogs are scanned in pieces on the scheduler; matches stay in table order
+    return scheduler.parallelReduce(
+        0, items.size(), SEARCH_GRAIN, vector<const Item*>(),
+        [&](size_t lo, size_t hi) {
+            vector<const Item*> matches;
+            for (size_t i = lo; i < hi; ++i) {
+                string_view name = strings.view(items[i].name);
+                if (simd.containsNoCase(name.data(), name.size(), lowerKey.data(), lowerKey.size())) {
+                    matches.push_back(&items[i]);
+                }
+            }
+            return matches;
+        },
+        [](vector<const Item*> all, vector<const Item*> more) {
+            all.insert(all.end(), more.begin(), more.end());
+            return all;
+        });
+}
+
+// Sum of the profit column, through the dispatched strided-sum kernel; in parallel pieces for long histories.
+double InventoryStore::totalProfit() const {
+    return scheduler.parallelReduce(
+        0, sales.size(), SUM_GRAIN, 0.0,
+        [this](size_t lo, size_t hi) {
+            return simd.sumStrided(reinterpret_cast<const char*>(&sales[lo].profit), hi - lo, sizeof(Sale));
+        },
+        [](double a, double b) { return a + b; });
+}
+
+const Item* InventoryStore::itemById(int id) const {
+    if (!indexReady_[ID_INDEX].load(memory_order_acquire)) {
+        for (const Item& item : items) {
+            if (item.id == id) return &item;
+        }
+        return nullptr;
+    }
+    auto found = idIndex.find(id);
+    return found == idIndex.end() ? nullptr : &items[found->second];
+}
+
+// Stand-in for the B+trees while they are being built: the items keep() accepts, sorted.
+template <class Keep, class Less>
+static vector<const Item*> sortedScan(const pmr::vector<Item>& table, Keep keep, Less less) {
+    vector<const Item*> matches;
+    for (const Item& item : table) {
+        if (keep(item)) matches.push_back(&item);
+    }
+    sort(matches.begin(), matches.end(), less);
+    return matches;
+}
+
+static bool lessById(const Item* a, const Item* b) { return a->id < b->id; }
+
+// Items with from <= ID <= to, in ID order.
+vector<const Item*> InventoryStore::itemsInIdRange(int from, int to) {
+    if (itemsServed_) return readIn([&](const Item& item, string_view) { return item.id >= from && item.id <= to; });
+    if (!indexReady_[ID_TREE].load(memory_order_acquire)) {
+        return sortedScan(items, [&](const Item& item) { return item.id >= from && item.id <= to; }, lessById);
+    }
+    vector<const Item*> matches;
+    for (auto c = idTree.lowerBound(from); c.valid() && c.key() <= to; c.next()) matches.push_back(itemById(c.key()));
+    return matches;
+}
+
+// Items whose name sorts (case-insensitively) from `from` up to names starting
+// with `to`, in name order; "a".."c" includes "Cap". An empty `to` has no upper bound.
+vector<const Item*> InventoryStore::itemsInNameRange(const string& from, const string& to) {
+    auto inRange = [&](string_view name) {
+        return ItemNameLess::compareNoCase(name, from) >= 0 &&
+               (to.empty() || ItemNameLess::compareNoCase(name.substr(0, to.size()), to) <= 0);
+    };
+    auto byName = [&](const Item* a, const Item* b) {
+        return ItemNameLess()({strings.view(a->name), a->id}, {strings.view(b->name), b->id});
+    };
+    if (itemsServed_) {
+        vector<const Item*> matches = readIn([&](const Item&, string_view name) { return inRange(name); });
+        sort(matches.begin(), matches.end(), byName);
+        return matches;
+    }
+    if (!indexReady_[NAME_TREE].load(memory_order_acquire)) {
+        return sortedScan(items, [&](const Item& item) { return inRange(strings.view(item.name)); }, byName);
+    }
+    vector<const Item*> matches;
+    for (auto c = nameTree.lowerBound({from, numeric_limits<int32_t>::min()}); c.valid(); c.next()) {
+        if (!to.empty() && ItemNameLess::compareNoCase(c.key().name.substr(0, to.size()), to) > 0) break;
+        matches.push_back(itemById(c.value()));
+    }
+    return matches;
+}
+
+vector<const Item*> InventoryStore::itemsById() {
+    if (itemsServed_) return readIn([](const Item&, string_view) { return true; });
+    return sortedById();
+}
+
+// itemsById() over the items in memory.
+vector<const Item*> InventoryStore::sortedById() const {
+    if (!indexReady_[ID_TREE].load(memory_order_acquire)) {
+        return sortedScan(items, [](const Item&) { return true; }, lessById);
+    }
+    vector<const Item*> ordered;
+    ordered.reserve(items.size());
+    for (auto c = idTree.first(); c.valid(); c.next()) ordered.push_back(itemById(c.key()));
+    return ordered;
+}
+
+void InventoryStore::forEachItem(const ItemVisitor& visit) const {
+    if (itemsServed_) {
+        backend_->scanItems(visit);
+        return;
+    }
+    for (const Item* item : sortedById()) visit(*item, strings.view(item->name), strings.view(item->size_color));
+}
+
+void InventoryStore::forEachMatch(const string& keyword, const ItemVisitor& visit) const {
+    PerfScope perf("logic_searchItems");
+    TraceSpan span("logic_searchItems", "logic");
+    if (!itemsServed_) {
+        for (const Item* item : searchTable(keyword)) visit(*item, strings.view(item->name), strings.view(item->size_color));
+        return;
+    }
+    string lowerKey = toLowerStr(keyword);
+    backend_->scanItems([&](const Item& item, string_view name, string_view sizeColor) {
+        if (simd.containsNoCase(name.data(), name.size(), lowerKey.data(), lowerKey.size())) visit(item, name, sizeColor);
+    });
+}
+
+void InventoryStore::applyMutation(const Mutation& m) {
+    // Backends bulk-load a snapshot without touching the index before replaying
+    if (idIndex.size() != items.size()) rebuildIndexes();
+    switch (m.kind) {
+    case Mutation::ADD_ITEM: {
+        Item item = m.item;
+        item.name = strings.intern(m.name);
+        item.size_color = strings.intern(m.size_color);
+        items.push_back(item);
+        indexItem(items.back(), items.size() - 1);
+        nextItemId = max(nextItemId, item.id + 1);
+        break;
+    }
+    case Mutation::UPDATE_ITEM:
+        if (Item* it = findItem(m.item.id)) {
+            it->quantity = m.item.quantity;
+            it->purchase_price = m.item.purchase_price;
+            it->selling_price = m.item.selling_price;
+        }
+        break;
+    case Mutation::DELETE_ITEM:
+        if (Item* it = findItem(m.item.id)) eraseItemAt(it - items.data());
+        break;
+    case Mutation::SELL_ITEM: {
+        if (Item* it = findItem(m.item.id)) it->quantity = m.item.quantity;
+        Sale sale = m.sale;
+        sale.item_name = strings.internView(sale.item_name);
+        sales.push_back(sale);
+        nextSaleId = max(nextSaleId, sale.id + 1);
+        break;
+    }
+    }
+}
+
+// Empties the store. All interned text is released with it.
+void InventoryStore::clear() {
+    indexCancel_.store(true, memory_order_relaxed);
+    waitForIndexes();
+    indexCancel_.store(false, memory_order_relaxed);
+    for (auto& ready : indexReady_) ready.store(true, memory_order_relaxed);
+    items.clear();
+    sales.clear();
+    idIndex.clear();
+    idTree.clear();
+    nameTree.clear();
+    strings.clear();
+    erasedSinceCompaction_ = 0;
+    itemsServed_ = false;
+    nextItemId = 1;
+    nextSaleId = 1;
+}
+
+/* ================= CORE LOGIC FUNCTIONS (TESTABLE) ================= */
+// Thin wrappers operating on defaultStore.
+
+/**
+ * @brief Adds a new item to the inventory.
+ * 
+ * @param name Name of the item.
+ * @param size Size or color description.
+ * @param qty Initial quantity.
+ * @param buy Purchase price.
+ * @param sell Selling price.
+ * @param persisted Optional; set to false if the item was added in memory but
+ *        the journal could not record it (the next save persists it).
+ * @return int The ID of the newly added item.
+ */
+int logic_addItem(string name, string size, int qty, double buy, double sell, bool* persisted = nullptr) {
+    return defaultStore.addItem(name, size, qty, buy, sell, persisted);
+}
+
+/**
+ * @brief Deletes an item by ID.
+ * 
+ * @param id The ID of the item to delete.
+ * @param persisted Optional; set to false if the journal could not record the change.
+ * @return true If item was found and deleted.
+ * @return false If item was not found.
+ */
+bool logic_deleteItem(int id, bool* persisted = nullptr) {
+    return defaultStore.deleteItem(id, persisted);
+}
+
+/**
+ * @brief Updates an existing item.
+ * 
+ * @param id The ID of the item to update.
+ * @param qty New quantity.
+ * @param buy New purchase price.
+ * @param sell New selling price.
+ * @param persisted Optional; set to false if the journal could not record the change.
+ * @return true If update was successful.
+ * @return false If item was not found.
+ */
+bool logic_updateItem(int id, int qty, double buy, double sell, bool* persisted = nullptr) {
+    return defaultStore.updateItem(id, qty, buy, sell, persisted);
+}
+
+/**
+ * @brief Processes a sale transaction.
+ * 
+ * @param id The ID of the item to sell.
+ * @param qty The quantity to sell.
+ * @param profitOut Output parameter to store the calculated profit.
+ * @param persisted Optional; set to false if the journal could not record the sale.
+ * @return int 0 = Success, 1 = Item not found, 2 = Not enough stock.
+ */
+int logic_sellItem(int id, int qty, double& profitOut, bool* persisted = nullptr) {
+    return defaultStore.sellItem(id, qty, profitOut, persisted);
+}
+
+/**
+ * @brief Starts a transaction: stage adds, updates, deletes and sales, then commit them together.
+ *
+ * @return Transaction An empty transaction on the default store. commit() applies
+ *         all staged operations or none and journals them as one record.
+ */
+Transaction logic_beginTransaction() {
+    return defaultStore.begin();
+}
+
+/**
+ * @brief Finds items whose name contains a keyword (case-insensitive).
+ *
+ * @param keyword Text to look for.
+ * @return vector<const Item*> Matching items, in inventory order (ID order if the backend serves
+ *         the items, which are then read in). Invalidated by any add/delete or read-in.
+ */
+vector<const Item*> logic_searchItems(const string& keyword) {
+    return defaultStore.searchItems(keyword);
+}
+
+/**
+ * @brief Lists items with IDs in an inclusive range, in ID order.
+ *
+ * @return vector<const Item*> Matching items, read in if the backend serves them. Invalidated by
+ *         any add/delete or read-in.
+ */
+vector<const Item*> logic_itemsInIdRange(int from, int to) {
+    return defaultStore.itemsInIdRange(from, to);
+}
+
+/**
+ * @brief Lists items by name (case-insensitive) from `from` through names starting with `to`.
+ *
+ * @param to Upper bound prefix; empty for no upper bound.
+ * @return vector<const Item*> Matching items in name order, read in if the backend serves them.
+ *         Invalidated by any add/delete or read-in.
+ */
+vector<const Item*> logic_itemsInNameRange(const string& from, const string& to) {
+    return defaultStore.itemsInNameRange(from, to);
+}
+
+/* ================= FILE PERSISTENCE ================= */
+
+// Snapshot and journal files used by the binary backends
+const string SNAPSHOT_FILE = "inventory.bin";
+const string JOURNAL_SNAPSHOT_FILE = "inventory.snap";
+const string JOURNAL_FILE = "inventory.journal";
+
+// Writes a whole buffer to a file. Returns false if it cannot be opened.
+static bool writeFile(const string& path, const string& text, bool binary = false) {
+    ofstream out(path, binary ? ios::binary : ios::out);
+    if (!out.is_open()) return false;
+    out << text;
+    return out.good();
+}
+
+// Asks the OS to put an open file's data on disk.
+static bool syncDescriptor(int fd) {
+#if defined(_WIN32)
+    return _commit(fd) == 0;
+#elif defined(__linux__)
+    return fsync(fd) == 0;
+#else
+    (void)fd;
+    return true;
+#endif
+}
+
+static int descriptorOf(FILE* f) {
+#ifdef _WIN32
+    return _fileno(f);
+#else
+    return fileno(f);
+#endif
+}
+
+// Makes a rename in path's directory durable. Windows commits renames with
+// the file system's own journal and has no directory handle to sync.
+static bool syncDirectoryOf(const string& path) {
+#ifdef __linux__
+    string dir = filesystem::path(path).parent_path().string();
+    int fd = open(dir.empty() ? "." : dir.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd < 0) return false;
+    bool ok = fsync(fd) == 0;
+    close(fd);
+    return ok;
+#else
+    (void)path;
+    return true;
+#endif
+}
+
+/**
+ * @brief Replaces a file so that a crash at any point leaves either the old
+ * or the new contents, never a mix: write a temporary file, fsync it, rename
+ * it over the target, fsync the directory.
+ */
+static bool writeFileAtomic(const string& path, const string& data, bool binary = false) {
+    string tmp = path + ".tmp";
+    FILE* f = fopen(tmp.c_str(), binary ? "wb" : "w");
+    if (!f) return false;
+    bool ok = fwrite(data.data(), 1, data.size(), f) == data.size() && fflush(f) == 0 &&
+              syncDescriptor(descriptorOf(f));
+    ok = fclose(f) == 0 && ok;
+    if (!ok || !replaceFile(tmp, path)) {
+        remove(tmp.c_str());
+        return false;
+    }
+    return syncDirectoryOf(path);
+}
+
+/**
+ * @brief Replaces several files in one directory as a set: every temporary
+ * file is written and fsynced before the first rename, so once one file is
+ * replaced the others are already on disk under their ".tmp" names.
+ *
+ * A crash or a failed rename during the renames is finished by
+ * finishFilesAtomic() on the next load; a failure before them leaves all the
+ * old files.
+ */
+static bool writeFilesAtomic(const vector<pair<string, const string*>>& files) {
+    bool ok = true;
+    for (size_t i = 0; i < files.size() && ok; ++i) {
+        string tmp = files[i].first + ".tmp";
+        const string& data = *files[i].second;
+        FILE* f = fopen(tmp.c_str(), "w");
+        ok = f && fwrite(data.data(), 1, data.size(), f) == data.size() && fflush(f) == 0 &&
+             syncDescriptor(descriptorOf(f));
+        ok = (!f || fclose(f) == 0) && ok;
+    }
+    size_t renamed = 0;
+    while (ok && renamed < files.size()) {
+        ok = replaceFile(files[renamed].first + ".tmp", files[renamed].first);
+        renamed += ok;
+    }
+    if (!ok) {
+        // Once a file is replaced the set is committed: the remaining temporaries
+        // stay for finishFilesAtomic(), or the files would no longer match
+        if (renamed == 0) {
+            for (const auto& file : files) remove((file.first + ".tmp").c_str());
+        }
+        return false;
+    }
+    return syncDirectoryOf(files.front().first);
+}
+
+/**
+ * @brief Completes or discards a writeFilesAtomic() cut short by a crash.
+ *
+ * Renames run in order, so if the first file has no temporary left but later
+ * ones do, the set was committed and those are renamed into place. If the
+ * first still has one, nothing was replaced and every temporary is dropped.
+ * @return true If an interrupted set was finished.
+ */
+static bool finishFilesAtomic(const vector<string>& paths) {
+    size_t first = 0;
+    while (first < paths.size() && !filesystem::exists(paths[first] + ".tmp")) ++first;
+    if (first == paths.size()) return false;
+    if (first == 0) {
+        for (const string& path : paths) remove((path + ".tmp").c_str());
+        return false;
+    }
+    for (size_t i = first; i < paths.size(); ++i) replaceFile(paths[i] + ".tmp", paths[i]);
+    syncDirectoryOf(paths.front());
+    return true;
+}
+
+// Checksum footer: the last line of a file, "#crc32c:<8 hex> bytes:<20 digits>\n",
+// covering every byte before it. Fixed width, so binary files can carry it too.
+const size_t FOOTER_SIZE = 44;
+
+/// What checkFooter() found.
+enum class FooterCheck {
+    Ok,       ///< Footer present and matching
+    Missing,  ///< No footer: written by an older version, edited by hand, or cut short
+    Mismatch  ///< Footer present but the contents differ: damaged or edited
+};
+
+// Appends a footer covering everything in data.
+static void appendFooter(string& data) {
+    char footer[FOOTER_SIZE + 1];
+    snprintf(footer, sizeof(footer), "#crc32c:%08x bytes:%020llu\n",
+             static_cast<unsigned>(simd.crc32c(0, data.data(), data.size())),
+             static_cast<unsigned long long>(data.size()));
+    data.append(footer, FOOTER_SIZE);
+}
+
+// Checks the footer and removes it from data, even on a mismatch so the rest can still be read.
+static FooterCheck checkFooter(string& data) {
+    if (data.size() < FOOTER_SIZE) return FooterCheck::Missing;
+    const char* f = data.data() + data.size() - FOOTER_SIZE;
+    if (memcmp(f, "#crc32c:", 8) != 0 || memcmp(f + 16, " bytes:", 7) != 0 || f[FOOTER_SIZE - 1] != '\n') {
+        return FooterCheck::Missing;
+    }
+    uint32_t crc = 0;
+    unsigned long long bytes = 0;
+    bool parsed = from_chars(f + 8, f + 16, crc, 16).ptr == f + 16 && from_chars(f + 23, f + 43, bytes).ptr == f + 43;
+    size_t length = data.size() - FOOTER_SIZE;
+    data.resize(length);
+    return parsed && bytes == length && simd.crc32c(0, data.data(), length) == crc ? FooterCheck::Ok
+                                                                                   : FooterCheck::Mismatch;
+}
+
+// Reads a whole file into memory with one allocation. Returns false if it cannot be opened.
+static bool readFile(const string& path, string& text, bool binary = false) {
+    ifstream in(path, binary ? ios::binary : ios::in);
+    if (!in.is_open()) return false;
+    in.seekg(0, ios::end);
+    streamoff size = in.tellg();
+    in.seekg(0, ios::beg);
+    text.resize(size > 0 ? static_cast<size_t>(size) : 0);
+    in.read(&text[0], static_cast<streamsize>(text.size()));
+    text.resize(static_cast<size_t>(in.gcount()));  // text mode may read fewer chars (CRLF)
+    return true;
+}
+
+/// Where forEachCsvRecord found a record.
+struct CsvRow {
+    size_t fields;      ///< Fields on the line (may exceed maxFields)
+    size_t line;        ///< 1-based line number
+    const char* begin;  ///< Start of the line, for columns
+};
+
+// Splits text into CSV records in one pass: the structural-index kernel finds
+// every ',' and '\n' of a 4 KB block at once. For every non-blank line, fills
+// fields with views of its first maxFields fields and calls visit(row); a
+// false return stops the scan. Like getline(',') a trailing empty field is
+// not counted.
+template <class Visit>
+static void forEachCsvRecord(string_view text, string_view* fields, size_t maxFields, Visit visit) {
+    const size_t BLOCK = 4096;
+    uint32_t hits[BLOCK];
+    const char* line = text.data();
+    const char* field = line;
+    size_t count = 0, lineNumber = 1;
+    auto endLine = [&](const char* stop) {
+        if (stop > field) {
+            if (count < maxFields) fields[count] = string_view(field, stop - field);
+            ++count;
+        }
+        bool more = true;
+        if (string_view(line, stop - line).find_first_not_of(" \t\r") != string_view::npos) {
+            more = visit(CsvRow{count, lineNumber, line});
+        }
+        count = 0;
+        ++lineNumber;
+        return more;
+    };
+    for (size_t base = 0; base < text.size(); base += BLOCK) {
+        const char* block = text.data() + base;
+        size_t n = simd.structuralIndex(block, min(BLOCK, text.size() - base), hits);
+        for (size_t h = 0; h < n; ++h) {
+            const char* stop = block + hits[h];
+            if (*stop == ',') {
+                if (count < maxFields) fields[count] = string_view(field, stop - field);
+                ++count;
+            } else {
+                if (!endLine(stop)) return;
+                line = stop + 1;
+            }
+            field = stop + 1;
+        }
+    }
+    if (line < text.data() + text.size()) endLine(text.data() + text.size());
+}
+
+// Helper to parse CSV line
+vector<string> parseCSV(string line) {
+    vector<string> result;
+    stringstream ss(line);
+    string item;
+    while (getline(ss, item, ',')) {
+        result.push_back(item);
+    }
+    return result;
+}
+
+/**
+ * @brief Plain-text backend: items.csv and sales.csv, rewritten on every checkpoint.
+ */
+class CsvBackend : public StorageBackend {
+public:
+    CsvBackend(const string& itemsPath, const string& salesPath) : itemsFile_(itemsPath), salesFile_(salesPath) {}
+    const char* name() const override { return "csv"; }
+    bool open() override { return true; }
+
+    bool load(InventoryStore& store) override {
+        if (finishFilesAtomic({itemsFile_, salesFile_}) && store.verbose) {
+            cout << " [Info] Finished a save of " << itemsFile_ << " and " << salesFile_
+                 << " that was interrupted.\n";
+        }
+        // Fields are views into the file buffer; only interned text is copied, into the string heap
+        InternText text{store.strings};
+
+        // Load Items
+        string fileText;
+        bool haveItems;
+        {
+            TraceSpan phase("read items", "persistence");
+            haveItems = readFile(itemsFile_, fileText);
+        }
+        if (haveItems) {
+            if (!verify(store, itemsFile_, fileText)) return true;  // strict load stops here
+            TraceSpan phase("parse items", "persistence");
+            string_view data[fieldCount<Item>()];
+            forEachCsvRecord(fileText, data, fieldCount<Item>(), [&](const CsvRow& row) {
+                Item it{};
+                size_t bad = 0;
+                ParseError error = ParseError::None;
+                if (row.fields < fieldCount<Item>() || (error = parseCsv(data, it, text, &bad)) != ParseError::None) {
+                    return badRow<Item>(store, itemsFile_, row, data, bad, error);
+                }
+                store.items.push_back(it);
+                if (it.id >= store.nextItemId) store.nextItemId = it.id + 1;
+                return true;
+            });
+            if (store.verbose) cout << " [Loaded] " << store.items.size() << " items.\n";
+        }
+
+        // Load Sales
+        bool haveSales;
+        {
+            TraceSpan phase("read sales", "persistence");
+            haveSales = readFile(salesFile_, fileText);
+        }
+        if (haveSales) {
+            if (!verify(store, salesFile_, fileText)) return true;
+            TraceSpan phase("parse sales", "persistence");
+            string_view data[fieldCount<Sale>()];
+            forEachCsvRecord(fileText, data, fieldCount<Sale>(), [&](const CsvRow& row) {
+                Sale s{};
+                size_t bad = 0;
+                ParseError error = ParseError::None;
+                if (row.fields < fieldCount<Sale>() || (error = parseCsv(data, s, text, &bad)) != ParseError::None) {
+                    return badRow<Sale>(store, salesFile_, row, data, bad, error);
+                }
+                store.sales.push_back(s);
+                if (s.id >= store.nextSaleId) store.nextSaleId = s.id + 1;
+                return true;
+            });
+            if (store.verbose) cout << " [Loaded] " << store.sales.size() << " sales records.\n";
+        }
+        return haveItems || haveSales;
+    }
+
+    vector<string> salesSegments() const override {
+        return filesystem::exists(salesFile_) ? vector<string>{salesFile_} : vector<string>();
+    }
+
+    bool checkpoint(const InventoryStore& store) override {
+        string itemText, saleText;
+        {
+            TraceSpan phase("format items", "persistence");
+            PoolText text{store.strings};
+            for (const auto& item : store.items) formatCsv(itemText, item, text);
+            appendFooter(itemText);
+        }
+        {
+            TraceSpan phase("format sales", "persistence");
+            PoolText text{store.strings};
+            for (const auto& sale : store.sales) formatCsv(saleText, sale, text);
+            appendFooter(saleText);
+        }
+        // Replaced as a pair, so quantities never disagree with the sales that reduced them
+        bool saved;
+        {
+            TraceSpan phase("write", "persistence");
+            saved = writeFilesAtomic({{itemsFile_, &itemText}, {salesFile_, &saleText}});
+        }
+        if (store.verbose) {
+            if (saved) {
+                cout << " [Saved] Items to " << itemsFile_ << endl;
+                cout << " [Saved] Sales to " << salesFile_ << endl;
+            } else {
+                cout << " [Error] Could not save items and sales!\n";
+            }
+        }
+        return saved;
+    }
+
+private:
+    // Strips the checksum footer and reports a mismatch; false stops the load.
+    static bool verify(InventoryStore& store, const string& file, string& text) {
+        FooterCheck check = checkFooter(text);
+        if (check == FooterCheck::Missing && store.verbose && !text.empty()) {
+            cout << " [Info] " << file << " has no checksum yet; it gets one on the next save.\n";
+        }
+        if (check != FooterCheck::Mismatch) return true;
+        size_t footerLine = static_cast<size_t>(count(text.begin(), text.end(), '\n')) + 1;
+        return store.reportDamagedFile({file, footerLine, 1, "checksum mismatch: the file is damaged or was "
+                                        "edited; loading the rows that can still be read"});
+    }
+
+    // Reports a row that is too short or has a bad number; false stops the load.
+    template <class Record>
+    static bool badRow(InventoryStore& store, const string& file, const CsvRow& row,
+                       const string_view* data, size_t field, ParseError error) {
+        if (store.loadIssues.size() >= MAX_LOAD_ISSUES) return store.reportBadRow({});  // only counted
+        if (error == ParseError::None) {
+            return store.reportBadRow({file, row.line, 1, "expected " + to_string(fieldCount<Record>()) +
+                                       " fields, found " + to_string(row.fields)});
+        }
+        string_view value = data[field].substr(0, 40);
+        return store.reportBadRow({file, row.line, static_cast<size_t>(data[field].data() - row.begin) + 1,
+                                   string(fieldName<Record>(field)) + ": " + parseErrorText(error) +
+                                   " (\"" + string(value) + "\")"});
+    }
+
+    string itemsFile_;
+    string salesFile_;
+};
+
+unique_ptr<StorageBackend> makeCsvBackend(const string& itemsPath, const string& salesPath) {
+    return make_unique<CsvBackend>(itemsPath, salesPath);
+}
+
+// Appends fixed-size values and length-prefixed strings in native byte order.
+struct ByteWriter {
+    string buf;
+    template <class T> void put(T v) { buf.append(reinterpret_cast<const char*>(&v), sizeof(T)); }
+    void putString(string_view s) {
+        put<uint32_t>(static_cast<uint32_t>(s.size()));
+        buf.append(s.data(), s.size());
+    }
+};
+
+// Reads what ByteWriter wrote; ok turns false on the first read past the end.
+struct ByteReader {
+    const char* p;
+    const char* end;
+    bool ok = true;
+
+    ByteReader(const char* data, size_t size) : p(data), end(data + size) {}
+    template <class T> T get() {
+        T v{};
+        if (static_cast<size_t>(end - p) < sizeof(T)) { ok = false; return v; }
+        memcpy(&v, p, sizeof(T));
+        p += sizeof(T);
+        return v;
+    }
+    string_view getString() {
+        uint32_t n = get<uint32_t>();
+        if (!ok || static_cast<size_t>(end - p) < n) { ok = false; return string_view(); }
+        string_view s(p, n);
+        p += n;
+        return s;
+    }
+    bool atEnd() const { return p == end; }
+};
+
+// Binary records hold the numbers in schema order, then the text and date
+// fields in schema order: fixed-width data first, length-prefixed text after.
+template <class Record, class Text>
+static void putRecord(ByteWriter& w, const Record& record, Text&& text) {
+    // Sizes first, so the record takes one resize and then plain copies
+    string_view texts[fieldCount<Record>()];
+    size_t textCount = 0, size = 0;
+    forEachField<Record>([&](const auto& field) {
+        const auto& value = record.*field.member;
+        if constexpr (decay_t<decltype(field)>::kind == FieldKind::Text) {
+            texts[textCount] = text.get(value);
+            size += sizeof(uint32_t) + texts[textCount++].size();
+        } else {
+            size += sizeof(value);
+        }
+    });
+    size_t at = w.buf.size();
+    w.buf.resize(at + size);
+    char* p = &w.buf[at];
+    forEachField<Record>([&](const auto& field) {
+        if constexpr (decay_t<decltype(field)>::kind == FieldKind::Number) {
+            memcpy(p, &(record.*field.member), sizeof(record.*field.member));
+            p += sizeof(record.*field.member);
+        }
+    });
+    textCount = 0;
+    forEachField<Record>([&](const auto& field) {
+        const auto& value = record.*field.member;
+        if constexpr (decay_t<decltype(field)>::kind == FieldKind::Text) {
+            string_view s = texts[textCount++];
+            uint32_t length = static_cast<uint32_t>(s.size());
+            memcpy(p, &length, sizeof(length));
+            memcpy(p + sizeof(length), s.data(), s.size());
+            p += sizeof(length) + s.size();
+        } else if constexpr (decay_t<decltype(field)>::kind == FieldKind::Date) {
+            memcpy(p, value, sizeof(value));
+            p += sizeof(value);
+        }
+    });
+}
+
+template <class Record, class Text>
+static void getRecord(ByteReader& r, Record& record, Text&& text) {
+    forEachField<Record>([&](const auto& field) {
+        auto& value = record.*field.member;
+        if constexpr (decay_t<decltype(field)>::kind == FieldKind::Number) value = r.get<decay_t<decltype(value)>>();
+    });
+    forEachField<Record>([&](const auto& field) {
+        auto& value = record.*field.member;
+        if constexpr (decay_t<decltype(field)>::kind == FieldKind::Text) {
+            text.set(value, r.getString());
+        } else if constexpr (decay_t<decltype(field)>::kind == FieldKind::Date) {
+            for (char& c : value) c = r.get<char>();
+            value[sizeof(value) - 1] = '\0';
+        }
+    });
+}
+
+static void putItem(ByteWriter& w, const Item& item, string_view name, string_view sizeColor) {
+    string_view slots[] = {name, sizeColor};
+    putRecord(w, item, SlotText{slots});
+}
+
+static void putItem(ByteWriter& w, const Item& item, const StringPool& strings) {
+    putRecord(w, item, PoolText{strings});
+}
+
+// The returned item's refs are unset; name and sizeColor view the input.
+static Item getItem(ByteReader& r, string_view& name, string_view& sizeColor) {
+    Item item{};
+    string_view slots[2];
+    getRecord(r, item, SlotText{slots});
+    name = slots[0];
+    sizeColor = slots[1];
+    return item;
+}
+
+static Item getItem(ByteReader& r, StringPool& strings) {
+    Item item{};
+    getRecord(r, item, InternText{strings});
+    return item;
+}
+
+static void putSale(ByteWriter& w, const Sale& sale) {
+    putRecord(w, sale, SlotText{nullptr});
+}
+
+// The returned sale's item_name views the input.
+static Sale getSale(ByteReader& r) {
+    Sale sale{};
+    getRecord(r, sale, SlotText{nullptr});
+    return sale;
+}
+
+// Records of the append-only logs (journal, LSM WAL, sales.log): u32 payload
+// length, u32 CRC32C of the length and payload, then the payload. The length
+// is covered too, so a zero-filled tail never passes as an empty record.
+const size_t LOG_RECORD_HEADER = 8;
+
+static uint32_t logRecordCrc(uint32_t length, const char* payload) {
+    return simd.crc32c(simd.crc32c(0, reinterpret_cast<const char*>(&length), sizeof(length)), payload, length);
+}
+
+// Starts a record at the end of w; returns its offset for sealLogRecord().
+static size_t openLogRecord(ByteWriter& w) {
+    size_t start = w.buf.size();
+    w.buf.append(LOG_RECORD_HEADER, '\0');
+    return start;
+}
+
+// Fills in the header of the record started at start. False if the payload is too long.
+static bool sealLogRecord(ByteWriter& w, size_t start) {
+    size_t payload = w.buf.size() - start - LOG_RECORD_HEADER;
+    if (payload > numeric_limits<uint32_t>::max()) return false;
+    uint32_t length = static_cast<uint32_t>(payload);
+    uint32_t crc = logRecordCrc(length, w.buf.data() + start + LOG_RECORD_HEADER);
+    memcpy(&w.buf[start], &length, sizeof(length));
+    memcpy(&w.buf[start + sizeof(length)], &crc, sizeof(crc));
+    return true;
+}
+
+enum class LogRead {
+    Record,  ///< record holds the next payload
+    End,     ///< No more records: the end of the data, or a record cut short by a crash
+    Damaged  ///< A whole record whose checksum does not match
+};
+
+// Reads the next log record. Replay stops at anything but LogRead::Record and
+// cuts the log back (truncateLog()), so new records are not appended after it.
+static LogRead nextLogRecord(ByteReader& r, ByteReader& record) {
+    const char* start = r.p;
+    uint32_t length = r.get<uint32_t>(), crc = r.get<uint32_t>();
+    if (!r.ok || static_cast<size_t>(r.end - r.p) < length) {
+        r.p = start;
+        return LogRead::End;
+    }
+    if (logRecordCrc(length, r.p) != crc) {
+        r.p = start;
+        return LogRead::Damaged;
+    }
+    record = ByteReader(r.p, length);
+    r.p += length;
+    return LogRead::Record;
+}
+
+// Cuts a log back to the first keep bytes, the records replay accepted.
+static bool truncateLog(const string& path, size_t keep) {
+    error_code ec;
+    filesystem::resize_file(path, static_cast<uintmax_t>(keep), ec);
+    return !ec;
+}
+
+// Snapshots written before generations were added: magic, counters, tables, checksum footer
+static const char LEGACY_SNAPSHOT_MAGIC[8] = {'I', 'N', 'V', 'S', 'N', 'A', 'P', '1'};
+static const char SNAPSHOT_MAGIC[8] = {'I', 'N', 'V', 'G', 'E', 'N', '0', '1'};
+
+// A snapshot file starts with two header slots, each naming a body further
+// on. A save writes its body where the newest header's body is not, then its
+// header into the other slot, so the switch is the one small header write.
+const uint64_t SNAPSHOT_SLOT_SIZE = 4096;
+const uint64_t SNAPSHOT_BODY_START = 2 * SNAPSHOT_SLOT_SIZE;
+
+/**
+ * @brief One header slot of a snapshot file: which body is current and what it holds.
+ */
+struct SnapshotHeader {
+    uint64_t generation = 0;  ///< Incremented by every save; the valid slot with the higher one wins
+    uint64_t bodyOffset = 0;  ///< File offset of the tables
+    uint64_t bodyLength = 0;  ///< Bytes of tables
+    uint32_t bodyCrc = 0;     ///< CRC32C of the tables
+    int32_t nextItemId = 1;   ///< ID counters as saved, not re-derived from the tables
+    int32_t nextSaleId = 1;
+    uint64_t lsn = 0;         ///< Last journal record already in the tables (0 without a journal)
+    uint64_t itemCount = 0;
+    uint64_t saleCount = 0;
+};
+
+static string encodeSnapshotHeader(const SnapshotHeader& h) {
+    ByteWriter w;
+    w.buf.append(SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    w.put(h.generation);
+    w.put(h.bodyOffset);
+    w.put(h.bodyLength);
+    w.put(h.bodyCrc);
+    w.put(h.nextItemId);
+    w.put(h.nextSaleId);
+    w.put(h.lsn);
+    w.put(h.itemCount);
+    w.put(h.saleCount);
+    w.put<uint32_t>(simd.crc32c(0, w.buf.data(), w.buf.size()));
+    return w.buf;
+}
+
+// Decodes one slot. False for an empty, torn or foreign slot.
+static bool decodeSnapshotHeader(const char* slot, size_t size, SnapshotHeader& h) {
+    if (size < sizeof(SNAPSHOT_MAGIC) || memcmp(slot, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0) return false;
+    ByteReader r(slot + sizeof(SNAPSHOT_MAGIC), size - sizeof(SNAPSHOT_MAGIC));
+    h.generation = r.get<uint64_t>();
+    h.bodyOffset = r.get<uint64_t>();
+    h.bodyLength = r.get<uint64_t>();
+    h.bodyCrc = r.get<uint32_t>();
+    h.nextItemId = r.get<int32_t>();
+    h.nextSaleId = r.get<int32_t>();
+    h.lsn = r.get<uint64_t>();
+    h.itemCount = r.get<uint64_t>();
+    h.saleCount = r.get<uint64_t>();
+    size_t covered = static_cast<size_t>(r.p - slot);
+    uint32_t crc = r.get<uint32_t>();
+    return r.ok && crc == simd.crc32c(0, slot, covered) && h.generation > 0 &&
+           h.bodyOffset >= SNAPSHOT_BODY_START && h.nextItemId > 0 && h.nextSaleId > 0;
+}
+
+// Serializes both tables: every item, then every sale.
+static string encodeSnapshotBody(const InventoryStore& store) {
+    ByteWriter w;
+    w.buf.reserve(store.items.size() * 48 + store.sales.size() * 64);
+    for (const auto& item : store.items) putItem(w, item, store.strings);
+    for (const auto& sale : store.sales) putSale(w, sale);
+    return w.buf;
+}
+
+// Loads the tables of a body into an empty store. False if they do not fill it exactly.
+static bool decodeSnapshotBody(const char* data, size_t size, uint64_t itemCount, uint64_t saleCount,
+                               InventoryStore& store) {
+    ByteReader r(data, size);
+    store.items.reserve(min<uint64_t>(itemCount, size));
+    for (uint64_t i = 0; i < itemCount && r.ok; ++i) {
+        store.items.push_back(getItem(r, store.strings));
+    }
+    store.sales.reserve(min<uint64_t>(saleCount, size));
+    for (uint64_t i = 0; i < saleCount && r.ok; ++i) {
+        Sale sale = getSale(r);
+        sale.item_name = store.strings.internView(sale.item_name);
+        store.sales.push_back(sale);
+    }
+    return r.ok && r.atEnd();
+}
+
+// Loads a snapshot from before generations into an empty store.
+static bool decodeLegacySnapshot(const string& data, InventoryStore& store, uint64_t& lsn) {
+    if (data.size() < sizeof(LEGACY_SNAPSHOT_MAGIC) ||
+        memcmp(data.data(), LEGACY_SNAPSHOT_MAGIC, sizeof(LEGACY_SNAPSHOT_MAGIC)) != 0) {
+        return false;
+    }
+    ByteReader r(data.data() + sizeof(LEGACY_SNAPSHOT_MAGIC), data.size() - sizeof(LEGACY_SNAPSHOT_MAGIC));
+    lsn = r.get<uint64_t>();
+    store.nextItemId = r.get<int32_t>();
+    store.nextSaleId = r.get<int32_t>();
+    uint64_t itemCount = r.get<uint64_t>();
+    uint64_t saleCount = r.get<uint64_t>();
+    if (!r.ok) return false;
+    return decodeSnapshotBody(r.p, static_cast<size_t>(r.end - r.p), itemCount, saleCount, store);
+}
+
+/**
+ * @brief Checks the loaded tables against their header in one pass over each:
+ * the counts match, IDs are unique and below the saved counters, and every
+ * sale names an item ID that had been handed out.
+ *
+ * A body that passes its checksum can still fail here if it was written by a
+ * buggy version; the check is what makes the saved counters trustworthy.
+ * @return false With problem set to the first inconsistency.
+ */
+static bool checkSnapshotConsistency(const InventoryStore& store, const SnapshotHeader& h, string& problem) {
+    if (store.items.size() != h.itemCount || store.sales.size() != h.saleCount) {
+        problem = "table sizes differ from the header";
+        return false;
+    }
+    vector<bool> seen(static_cast<size_t>(h.nextItemId));
+    for (const Item& item : store.items) {
+        if (item.id <= 0 || item.id >= h.nextItemId || seen[item.id]) {
+            problem = "item ID " + to_string(item.id) + " is repeated or beyond the saved counter";
+            return false;
+        }
+        seen[item.id] = true;
+    }
+    seen.assign(static_cast<size_t>(h.nextSaleId), false);
+    for (const Sale& sale : store.sales) {
+        if (sale.id <= 0 || sale.id >= h.nextSaleId || seen[sale.id]) {
+            problem = "sale ID " + to_string(sale.id) + " is repeated or beyond the saved counter";
+            return false;
+        }
+        if (sale.item_id <= 0 || sale.item_id >= h.nextItemId) {
+            problem = "sale " + to_string(sale.id) + " refers to item " + to_string(sale.item_id) +
+                      ", which was never created";
+            return false;
+        }
+        seen[sale.id] = true;
+    }
+    return true;
+}
+
+static bool seekFile(FILE* f, uint64_t offset) {
+#ifdef _WIN32
+    return _fseeki64(f, static_cast<long long>(offset), SEEK_SET) == 0;
+#else
+    return fseeko(f, static_cast<off_t>(offset), SEEK_SET) == 0;
+#endif
+}
+
+// Length of an open file; leaves the position at its end.
+static bool fileLength(FILE* f, uint64_t& length) {
+#ifdef _WIN32
+    long long end = _fseeki64(f, 0, SEEK_END) == 0 ? _ftelli64(f) : -1;
+#else
+    off_t end = fseeko(f, 0, SEEK_END) == 0 ? ftello(f) : -1;
+#endif
+    length = end < 0 ? 0 : static_cast<uint64_t>(end);
+    return end >= 0;
+}
+
+// Reads both header slots. Returns the valid ones, newest first; torn counts
+// the slots that were written but no longer decode.
+static vector<SnapshotHeader> readSnapshotHeaders(FILE* f, int* torn = nullptr) {
+    vector<SnapshotHeader> headers;
+    string slots(SNAPSHOT_BODY_START, '\0');
+    size_t got = seekFile(f, 0) ? fread(&slots[0], 1, slots.size(), f) : 0;
+    if (torn) *torn = 0;
+    for (uint64_t slot = 0; slot < 2; ++slot) {
+        SnapshotHeader h;
+        size_t at = static_cast<size_t>(slot * SNAPSHOT_SLOT_SIZE);
+        if (got > at && decodeSnapshotHeader(slots.data() + at, got - at, h)) {
+            headers.push_back(h);
+        } else if (torn && got > at && slots.compare(at, sizeof(SNAPSHOT_MAGIC), SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) == 0) {
+            ++*torn;
+        }
+    }
+    sort(headers.begin(), headers.end(),
+         [](const SnapshotHeader& a, const SnapshotHeader& b) { return a.generation > b.generation; });
+    return headers;
+}
+
+/**
+ * @brief Saves both tables and the ID counters as the next generation of a snapshot file.
+ *
+ * The new body goes where it overwrites nothing the newest header points to
+ * (the front of the body area if it fits there, else just after the newest
+ * body) and is fsynced before the header naming it is written into the other
+ * slot and fsynced in turn. A crash before that second fsync leaves the
+ * newest header, and its body, untouched. The previous generation also stays
+ * intact until the next save, as a fallback if the new one is ever damaged.
+ * A missing file, or one from before generations, is written whole through
+ * writeFileAtomic().
+ * @param lsn Last journal record already reflected in the tables (0 without a journal).
+ */
+static bool writeSnapshotFile(const string& path, const InventoryStore& store, uint64_t lsn) {
+    SnapshotHeader next;
+    string body;
+    {
+        TraceSpan phase("encode snapshot", "persistence");
+        body = encodeSnapshotBody(store);
+        next.bodyLength = body.size();
+        next.bodyCrc = simd.crc32c(0, body.data(), body.size());
+        next.nextItemId = store.nextItemId;
+        next.nextSaleId = store.nextSaleId;
+        next.lsn = lsn;
+        next.itemCount = store.items.size();
+        next.saleCount = store.sales.size();
+    }
+    TraceSpan phase("write snapshot", "persistence");
+    FILE* f = fopen(path.c_str(), "r+b");
+    vector<SnapshotHeader> headers = f ? readSnapshotHeaders(f) : vector<SnapshotHeader>();
+    if (headers.empty()) {
+        if (f) fclose(f);
+        next.generation = 1;
+        next.bodyOffset = SNAPSHOT_BODY_START;
+        string data(SNAPSHOT_BODY_START, '\0');
+        string header = encodeSnapshotHeader(next);
+        data.replace(SNAPSHOT_SLOT_SIZE, header.size(), header);  // generation g lives in slot g % 2
+        data += body;
+        return writeFileAtomic(path, data, true);
+    }
+
+    const SnapshotHeader& newest = headers.front();
+    uint64_t newestEnd = newest.bodyOffset + newest.bodyLength;
+    next.generation = newest.generation + 1;
+    next.bodyOffset = body.size() <= newest.bodyOffset - SNAPSHOT_BODY_START
+                          ? SNAPSHOT_BODY_START
+                          : (newestEnd + SNAPSHOT_SLOT_SIZE - 1) / SNAPSHOT_SLOT_SIZE * SNAPSHOT_SLOT_SIZE;
+    string header = encodeSnapshotHeader(next);
+    int fd = descriptorOf(f);
+    bool ok = seekFile(f, next.bodyOffset) && fwrite(body.data(), 1, body.size(), f) == body.size() &&
+              fflush(f) == 0 && syncDescriptor(fd) &&
+              seekFile(f, next.generation % 2 * SNAPSHOT_SLOT_SIZE) &&
+              fwrite(header.data(), 1, header.size(), f) == header.size() && fflush(f) == 0 && syncDescriptor(fd);
+    ok = fclose(f) == 0 && ok;
+    if (ok) {
+        // Drop whatever lies beyond both bodies still referenced
+        error_code ec;
+        filesystem::resize_file(path, max(next.bodyOffset + next.bodyLength, newestEnd), ec);
+    }
+    return ok;
+}
+
+/**
+ * @brief Reads a snapshot file into an empty store, newest generation first.
+ *
+ * A generation is used only if its body matches its checksum and passes
+ * checkSnapshotConsistency(); otherwise the previous one is tried.
+ * @param found Set to false if the file does not exist.
+ * @param problem Set when the result is false and found is true: what was wrong and what was loaded instead.
+ * @return true If the newest generation loaded cleanly.
+ */
+static bool readSnapshotFile(const string& path, InventoryStore& store, uint64_t& lsn, bool& found,
+                             string& problem) {
+    TraceSpan phase("read snapshot", "persistence");
+    FILE* f = fopen(path.c_str(), "rb");
+    found = f != nullptr;
+    if (!f) return false;
+    char magic[sizeof(LEGACY_SNAPSHOT_MAGIC)] = {};
+    if (fread(magic, 1, sizeof(magic), f) == sizeof(magic) && memcmp(magic, LEGACY_SNAPSHOT_MAGIC, sizeof(magic)) == 0) {
+        fclose(f);
+        string data;
+        readFile(path, data, true);
+        bool intact = checkFooter(data) != FooterCheck::Mismatch;
+        if (decodeLegacySnapshot(data, store, lsn) && intact) return true;
+        problem = "checksum mismatch; loaded what could be read";
+        return false;
+    }
+
+    int torn;
+    vector<SnapshotHeader> headers = readSnapshotHeaders(f, &torn);
+    if (torn) problem = "a header is unreadable (an interrupted save or damage); ";
+    string body;
+    for (const SnapshotHeader& h : headers) {
+        string reason;
+        body.resize(static_cast<size_t>(h.bodyLength));
+        if (!seekFile(f, h.bodyOffset) || fread(&body[0], 1, body.size(), f) != body.size()) {
+            reason = "body cut short";
+        } else if (simd.crc32c(0, body.data(), body.size()) != h.bodyCrc) {
+            reason = "body checksum mismatch";
+        } else if (!decodeSnapshotBody(body.data(), body.size(), h.itemCount, h.saleCount, store) ||
+                   !checkSnapshotConsistency(store, h, reason)) {
+            if (reason.empty()) reason = "tables do not match the header";
+            store.clear();
+        }
+        if (reason.empty()) {
+            store.nextItemId = h.nextItemId;
+            store.nextSaleId = h.nextSaleId;
+            lsn = h.lsn;
+            fclose(f);
+            if (problem.empty()) return true;
+            problem += "loaded generation " + to_string(h.generation);
+            return false;
+        }
+        problem += "generation " + to_string(h.generation) + ": " + reason + "; ";
+    }
+    fclose(f);
+    problem += headers.empty() ? "no valid header; nothing loaded" : "nothing loaded";
+    return false;
+}
+
+/**
+ * @brief Binary snapshot backend: one file with both tables; each checkpoint adds a generation.
+ */
+class SnapshotBackend : public StorageBackend {
+public:
+    explicit SnapshotBackend(const string& path) : path_(path) {}
+    const char* name() const override { return "binary"; }
+    bool open() override { return true; }
+
+    bool load(InventoryStore& store) override {
+        uint64_t lsn = 0;
+        bool found;
+        string problem;
+        bool ok = readSnapshotFile(path_, store, lsn, found, problem);
+        if (found && !ok) {
+            cout << " [Error] " << path_ << " is damaged: " << problem << ".\n";
+        }
+        if (found && store.verbose) {
+            cout << " [Loaded] " << store.items.size() << " items and " << store.sales.size()
+                 << " sales records from " << path_ << ".\n";
+        }
+        return found;
+    }
+
+    bool checkpoint(const InventoryStore& store) override {
+        bool saved = writeSnapshotFile(path_, store, 0);
+        if (store.verbose) {
+            if (saved) {
+                cout << " [Saved] Items and sales to " << path_ << endl;
+            } else {
+                cout << " [Error] Could not save " << path_ << "!\n";
+            }
+        }
+        return saved;
+    }
+
+private:
+    string path_;
+};
+
+/**
+ * @brief An append-only file whose writers choose how long to wait for durability.
+ *
+ * write() hands each record to the OS at once. wait() then applies the mode:
+ * None and Async return immediately (Async keeps a thread fsyncing every
+ * interval), PerOp waits for an fsync of its own, and Group commits: the
+ * first waiter becomes the leader and fsyncs everything written so far, and
+ * the threads that queue up behind it are covered by that fsync or the
+ * next leader's, so N concurrent writers pay for far fewer than N fsyncs.
+ * Records are counted from 1 in write order; the count survives reopen().
+ * All methods are thread-safe.
+ */
+class DurableLog {
+public:
+    ~DurableLog() {
+        setMode(Durability::None, 0);  // stops the async flusher
+        close();
+    }
+
+    /// Opens the file for appending, or empties it. Waits for a running fsync first.
+    bool reopen(const string& path, bool truncate) {
+        unique_lock<mutex> lock(syncMutex_);
+        synced_.wait(lock, [&] { return !syncing_; });
+        lock_guard<mutex> file(fileMutex_);
+        if (file_) fclose(file_);
+        file_ = fopen(path.c_str(), truncate ? "wb" : "ab");
+        if (truncate) durable_ = written_;  // what was written before is gone, not pending
+        return file_ != nullptr;
+    }
+
+    void close() {
+        unique_lock<mutex> lock(syncMutex_);
+        synced_.wait(lock, [&] { return !syncing_; });
+        lock_guard<mutex> file(fileMutex_);
+        if (file_) fclose(file_);
+        file_ = nullptr;
+    }
+
+    bool isOpen() {
+        lock_guard<mutex> file(fileMutex_);
+        return file_ != nullptr;
+    }
+
+    /// Appends one record and flushes it to the OS.
+    bool write(const char* data, size_t size) {
+        lock_guard<mutex> file(fileMutex_);
+        if (!file_ || fwrite(data, 1, size, file_) != size || fflush(file_) != 0) return false;
+        written_.store(written_.load(memory_order_relaxed) + 1, memory_order_release);
+        return true;
+    }
+
+    /// Records written so far; pass to wait() to cover all of them.
+    uint64_t written() const { return written_.load(memory_order_acquire); }
+
+    /// Returns once record upTo is as safe as the mode promises (on disk if sync).
+    bool wait(uint64_t upTo, bool sync = false) {
+        Durability mode = sync ? Durability::Group : mode_.load(memory_order_relaxed);
+        if (mode == Durability::None || mode == Durability::Async) return true;
+        return syncUpTo(upTo, mode == Durability::Group);
+    }
+
+    void setMode(Durability mode, int intervalMs) {
+        {
+            lock_guard<mutex> lock(syncMutex_);
+            stopFlusher_ = true;
+        }
+        flusherWake_.notify_all();
+        if (flusher_.joinable()) flusher_.join();
+        mode_ = mode;
+        if (mode == Durability::Async) {
+            stopFlusher_ = false;
+            flusher_ = thread([this, intervalMs] { flusherLoop(max(intervalMs, 1)); });
+        }
+    }
+
+    Durability mode() const { return mode_.load(memory_order_relaxed); }
+    /// fsync calls made so far.
+    uint64_t syncs() const { return syncs_.load(memory_order_relaxed); }
+
+private:
+    // One fsync at a time. With share set, a waiter already covered by another
+    // thread's fsync returns without issuing its own.
+    bool syncUpTo(uint64_t upTo, bool share) {
+        unique_lock<mutex> lock(syncMutex_);
+        synced_.wait(lock, [&] { return !syncing_ || (share && durable_ >= upTo); });
+        if (share && durable_ >= upTo) return true;
+        syncing_ = true;
+        lock.unlock();
+
+        // Writers keep appending during the fsync; reopen() and close() wait for it
+        uint64_t target;
+        int fd = -1;
+        {
+            lock_guard<mutex> file(fileMutex_);
+            target = written_.load(memory_order_acquire);
+            if (file_) fd = descriptorOf(file_);
+        }
+        bool ok = fd >= 0 && syncDescriptor(fd);
+        if (fd >= 0) syncs_.fetch_add(1, memory_order_relaxed);
+
+        lock.lock();
+        syncing_ = false;
+        if (ok) durable_ = max(durable_, target);
+        synced_.notify_all();
+        return ok;
+    }
+
+    void flusherLoop(int intervalMs) {
+        unique_lock<mutex> lock(syncMutex_);
+        while (!flusherWake_.wait_for(lock, chrono::milliseconds(intervalMs), [&] { return stopFlusher_; })) {
+            uint64_t upTo = written();
+            if (durable_ >= upTo) continue;
+            lock.unlock();
+            syncUpTo(upTo, true);
+            lock.lock();
+        }
+    }
+
+    mutex fileMutex_;                  ///< Guards file_ and the order of written_
+    FILE* file_ = nullptr;
+    atomic<uint64_t> written_{0};
+    atomic<Durability> mode_{Durability::None};
+    atomic<uint64_t> syncs_{0};
+
+    mutex syncMutex_;                  ///< Guards the fields below
+    condition_variable synced_;        ///< An fsync finished
+    bool syncing_ = false;             ///< A leader is fsyncing (or the file is being reopened)
+    uint64_t durable_ = 0;             ///< Records known to be on disk
+    bool stopFlusher_ = false;
+    condition_variable flusherWake_;
+    thread flusher_;
+};
+
+/**
+ * @brief Journal + snapshot backend: every mutation is appended to a journal,
+ * and a checkpoint folds the journal into a fresh snapshot.
+ *
+ * Each journal record carries a sequence number (LSN) and the snapshot stores
+ * the last LSN it contains, so a crash between writing the snapshot and
+ * truncating the journal never applies a record twice. A torn record at the
+ * end of the journal (crash mid-append) is ignored, and replay stops at a
+ * record whose checksum does not match; either way the journal is cut back
+ * to the records before it.
+ *
+ * Records are log records (see openLogRecord()) whose payload is a u64 LSN,
+ * then one or more mutations (u8 kind, kind-specific payload). A transaction is a single record, synced
+ * once, so replay applies all of it or none of it. How long a single
+ * mutation waits for its record to reach the disk is the DurableLog's mode.
+ */
+class JournalBackend : public StorageBackend {
+public:
+    JournalBackend(const string& snapshotPath, const string& journalPath)
+        : snapshotPath_(snapshotPath), journalPath_(journalPath) {}
+    ~JournalBackend() override { close(); }
+
+    const char* name() const override { return "journal"; }
+    bool journals() const override { return true; }
+
+    bool open() override {
+        return journal_.isOpen() || journal_.reopen(journalPath_, false);
+    }
+
+    void close() override { journal_.close(); }
+
+    bool load(InventoryStore& store) override {
+        uint64_t snapshotLsn = 0;
+        bool found;
+        string problem;
+        if (!readSnapshotFile(snapshotPath_, store, snapshotLsn, found, problem) && found) {
+            cout << " [Error] " << snapshotPath_ << " is damaged: " << problem << ".\n";
+        }
+        nextLsn_ = snapshotLsn + 1;
+
+        string data;
+        {
+            TraceSpan phase("read journal", "persistence");
+            if (!readFile(journalPath_, data, true)) return found;
+        }
+        TraceSpan phase("replay journal", "persistence");
+        ByteReader r(data.data(), data.size()), rec(nullptr, 0);
+        size_t replayed = 0, accepted = 0, records = 0;  // accepted: bytes of whole, decodable records
+        vector<Mutation> record;  // decoded completely before any of it is applied
+        LogRead read = LogRead::End;
+        while (!r.atEnd() && (read = nextLogRecord(r, rec)) == LogRead::Record) {
+            uint64_t lsn = rec.get<uint64_t>();
+            record.clear();
+            bool decoded = true;
+            while (decoded && !rec.atEnd()) {
+                record.emplace_back();
+                decoded = decodeMutation(rec, record.back());
+            }
+            if (!decoded || record.empty()) break;
+            accepted = r.p - data.data();
+            ++records;
+            nextLsn_ = max(nextLsn_, lsn + 1);
+            if (lsn <= snapshotLsn) continue;  // already in the snapshot
+            if (replayed == 0 && lsn != snapshotLsn + 1) {
+                // Only after falling back to an older snapshot generation
+                cout << " [Error] Journal records " << snapshotLsn + 1 << " to " << lsn - 1
+                     << " are lost; later changes are replayed on the older snapshot.\n";
+            }
+            for (const Mutation& m : record) store.applyMutation(m);
+            ++replayed;
+        }
+        if (read == LogRead::Damaged &&
+            !store.reportDamagedFile({journalPath_, 1, 1, "record " + to_string(records + 1) +
+                                      ": checksum mismatch; replay stopped there"})) {
+            return found || replayed > 0;
+        }
+        if (accepted < data.size()) {
+            journal_.close();
+            truncateLog(journalPath_, accepted);
+            journal_.reopen(journalPath_, false);
+        }
+        if (store.verbose && (found || replayed)) {
+            cout << " [Loaded] " << store.items.size() << " items and " << store.sales.size()
+                 << " sales records (" << replayed << " journal records replayed).\n";
+        }
+        return found || replayed > 0;
+    }
+
+    bool append(const Mutation& m) override { return writeRecord(&m, 1); }
+    bool appendBatch(const Mutation* m, size_t n) override { return writeRecord(m, n); }
+
+    bool setDurability(Durability mode, int intervalMs) override {
+        journal_.setMode(mode, intervalMs);
+        return true;
+    }
+    uint64_t appendedTicket() const override { return journal_.written(); }
+    bool waitDurable(uint64_t ticket, bool sync) override { return journal_.wait(ticket, sync); }
+    uint64_t syncs() const { return journal_.syncs(); }
+    string durabilityStatus() const override {
+        return string(durabilityName(journal_.mode())) + " (" + to_string(journal_.syncs()) + " fsyncs)";
+    }
+
+    bool checkpoint(const InventoryStore& store) override {
+        bool saved = writeSnapshotFile(snapshotPath_, store, nextLsn_ - 1);
+        if (saved) {
+            // Everything up to nextLsn_ - 1 is in the snapshot now
+            saved = journal_.reopen(journalPath_, true);
+        }
+        if (store.verbose) {
+            if (saved) {
+                cout << " [Saved] Snapshot to " << snapshotPath_ << ", journal truncated" << endl;
+            } else {
+                cout << " [Error] Could not checkpoint " << snapshotPath_ << "!\n";
+            }
+        }
+        return saved;
+    }
+
+private:
+    // Writes one record holding n mutations under the next LSN. Callers hold
+    // the store's lock, so the reused buffer and nextLsn_ need no lock of their own.
+    bool writeRecord(const Mutation* m, size_t n) {
+        ByteWriter& w = record_;
+        w.buf.clear();
+        w.buf.reserve(LOG_RECORD_HEADER + 8 + n * 32);  // an update or sale takes about that; adds grow it
+        size_t start = openLogRecord(w);
+        w.put<uint64_t>(nextLsn_++);
+        for (size_t i = 0; i < n; ++i) encodeMutation(w, m[i]);
+        return sealLogRecord(w, start) && journal_.write(w.buf.data(), w.buf.size());
+    }
+
+    static void encodeMutation(ByteWriter& w, const Mutation& m) {
+        w.put<uint8_t>(m.kind);
+        switch (m.kind) {
+        case Mutation::ADD_ITEM:
+            putItem(w, m.item, m.name, m.size_color);
+            break;
+        case Mutation::UPDATE_ITEM:
+            w.put<int32_t>(m.item.id);
+            w.put<int32_t>(m.item.quantity);
+            w.put<double>(m.item.purchase_price);
+            w.put<double>(m.item.selling_price);
+            break;
+        case Mutation::DELETE_ITEM:
+            w.put<int32_t>(m.item.id);
+            break;
+        case Mutation::SELL_ITEM:
+            w.put<int32_t>(m.item.id);
+            w.put<int32_t>(m.item.quantity);
+            putSale(w, m.sale);
+            break;
+        }
+    }
+
+    static bool decodeMutation(ByteReader& r, Mutation& m) {
+        m = Mutation{Mutation::Kind(r.get<uint8_t>()), Item{}, Sale{}, string_view(), string_view()};
+        switch (m.kind) {
+        case Mutation::ADD_ITEM:
+            m.item = getItem(r, m.name, m.size_color);
+            break;
+        case Mutation::UPDATE_ITEM:
+            m.item.id = r.get<int32_t>();
+            m.item.quantity = r.get<int32_t>();
+            m.item.purchase_price = r.get<double>();
+            m.item.selling_price = r.get<double>();
+            break;
+        case Mutation::DELETE_ITEM:
+            m.item.id = r.get<int32_t>();
+            break;
+        case Mutation::SELL_ITEM:
+            m.item.id = r.get<int32_t>();
+            m.item.quantity = r.get<int32_t>();
+            m.sale = getSale(r);
+            break;
+        default:
+            return false;
+        }
+        return r.ok;
+    }
+
+    string snapshotPath_;
+    string journalPath_;
+    DurableLog journal_;
+    ByteWriter record_;  ///< Reused record buffer
+    uint64_t nextLsn_ = 1;
+};
+
+/**
+ * @brief Creates a backend by name for files in a directory.
+ *
+ * @param kind "csv", "binary", "journal", "lsm" or "sharded".
+ * @param dir Directory holding the backend's files.
+ * @return nullptr If the kind is unknown.
+ */
+unique_ptr<StorageBackend> makeStorageBackend(const string& kind, const string& dir) {
+    filesystem::path base(dir);
+    if (kind == "csv") return make_unique<CsvBackend>((base / ITEMS_FILE).string(), (base / SALES_FILE).string());
+    if (kind == "binary") return make_unique<SnapshotBackend>((base / SNAPSHOT_FILE).string());
+    if (kind == "journal") {
+        return make_unique<JournalBackend>((base / JOURNAL_SNAPSHOT_FILE).string(), (base / JOURNAL_FILE).string());
+    }
+    if (kind == "lsm") return makeLsmBackend(dir);
+    if (kind == "sharded") return makeShardedBackend(dir);
+    return nullptr;
+}
+
+// Persists the whole store through its backend. Returns false on failure.
+bool InventoryStore::save() {
+    TraceSpan span("saveData", "persistence");
+    auto start = chrono::steady_clock::now();
+    bool saved = backend_->checkpoint(*this);
+    if (publishMetrics) {
+        metricSaveSeconds.observe(chrono::duration<double>(chrono::steady_clock::now() - start).count());
+        metrics_refreshTables(*this);
+    }
+    return saved;
+}
+
+// Adds the default items to an empty store.
+void InventoryStore::seed() {
+    addItem("Widget", "Small", 10, 5.0, 8.0);
+    addItem("Bolt", "Red", 3, 0.5, 1.0);
+    addItem("Gadget", "Blue", 20, 10.0, 15.0);
+    if (verbose) cout << " [Info] No previous data found. Seeded default items.\n";
+}
+
+// Replaces the store's contents with what its backend holds, seeding if it holds nothing.
+bool InventoryStore::load() {
+    PerfScope perf("loadData");
+    TraceSpan span("loadData", "persistence");
+    auto start = chrono::steady_clock::now();
+    clear();
+    loadIssues.clear();
+    rowsSkipped = 0;
+    loadAborted_ = false;
+
+    itemsServed_ = backend_->servesItems();
+    bool found = backend_->load(*this);
+    if (verbose) {
+        for (size_t i = 0; i < loadIssues.size() && i < 10; ++i) {
+            const LoadIssue& issue = loadIssues[i];
+            cout << " [Warning] " << issue.file << ":" << issue.line << ":" << issue.column << ": "
+                 << issue.message << "\n";
+        }
+    }
+    if (loadAborted_) {
+        // Nothing half-loaded is kept, and nothing is seeded that a save could write over the files
+        clear();
+        if (verbose) cout << " [Error] Strict load stopped at the first bad row or damaged file; nothing was loaded.\n";
+        return false;
+    }
+    if (verbose && rowsSkipped) cout << " [Warning] Skipped " << rowsSkipped << " bad rows.\n";
+    sales.reserve(sales.size() + SALES_HEADROOM);
+
+    if (backgroundIndexes) {
+        startIndexBuild();
+    } else {
+        TraceSpan phase("build indexes", "persistence");
+        rebuildIndexes();
+    }
+
+    if (seedWhenEmpty && items.empty() && sales.empty() && !(itemsServed_ && found)) {
+        seed();
+    }
+
+    if (publishMetrics) {
+        metricLoadSeconds.observe(chrono::duration<double>(chrono::steady_clock::now() - start).count());
+        metrics_refreshTables(*this, true);
+    }
+    return true;
+}
+
+bool InventoryStore::reportBadRow(LoadIssue issue) {
+    ++rowsSkipped;
+    return reportDamagedFile(move(issue));
+}
+
+bool InventoryStore::reportDamagedFile(LoadIssue issue) {
+    if (loadIssues.size() < MAX_LOAD_ISSUES) loadIssues.push_back(move(issue));
+    if (strictLoad) loadAborted_ = true;
+    return !strictLoad;
+}
+
+/**
+ * @brief Saves all items and sales through the default store's backend.
+ */
+void saveData() {
+    defaultStore.save();
+}
+
+/**
+ * @brief Seeds the database with default data if empty.
+ */
+void seedData() {
+    defaultStore.seed();
+}
+
+/**
+ * @brief Loads data from the default store's backend into memory.
+ * @return false If a strict load stopped at a bad row (nothing is loaded then).
+ */
+bool loadData() {
+    return defaultStore.load();
+}
+
+/**
+ * @brief Copies everything persisted by one backend into another.
+ *
+ * @return true If the source had data and the target checkpoint succeeded.
+ */
+bool convertStorage(StorageBackend& from, StorageBackend& to) {
+    InventoryStore scratch;
+    scratch.verbose = false;
+    scratch.seedWhenEmpty = false;
+    if (!from.open() || !from.load(scratch)) return false;
+    return to.open() && to.checkpoint(scratch);
+}
+
+/* ================= LSM ITEM ENGINE ================= */
+// Log-structured item table for catalogs too large to rewrite on every save.
+// Writes go to a write-ahead log and an in-memory memtable; full memtables are
+// flushed as immutable sorted runs (data blocks + block index + bloom filter)
+// and a background thread merges runs once enough of them pile up.
+
+const string LSM_DIR = "items.lsm";          // Item table directory of the lsm backend
+const string LSM_SALES_FILE = "sales.log";   // Append-only sales of the lsm backend
+const size_t LSM_MEMTABLE_BYTES = 4 << 20;   // Flush the memtable beyond this
+const size_t LSM_BLOCK_BYTES = 4096;         // Target size of one data block
+const size_t LSM_COMPACT_RUNS = 4;           // Merge all runs once this many exist
+const size_t LSM_BLOOM_BITS_PER_KEY = 10;    // About 1% false positives
+const char LSM_RUN_MAGIC[8] = {'I', 'N', 'V', 'L', 'S', 'M', 'R', '2'};
+
+// A value in the memtable or a run; deleted entries shadow older runs.
+struct LsmValue {
+    bool deleted = false;
+    string value;
+};
+
+static uint64_t lsmHash(int32_t key) {
+    uint64_t h = static_cast<uint32_t>(key) + 0x9e3779b97f4a7c15ull;
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ull;
+    h = (h ^ (h >> 27)) * 0x94d049bb133111ebull;
+    return h ^ (h >> 31);
+}
+
+struct BloomFilter {
+    vector<uint64_t> words;
+
+    void init(size_t keys) { words.assign(max<size_t>(1, (keys * LSM_BLOOM_BITS_PER_KEY + 63) / 64), 0); }
+
+    void add(int32_t key) {
+        uint64_t h = lsmHash(key), step = (h >> 33) | 1, bits = words.size() * 64;
+        for (int i = 0; i < 7; ++i, h += step) words[(h % bits) / 64] |= 1ull << (h % 64);
+    }
+
+    bool mayContain(int32_t key) const {
+        uint64_t h = lsmHash(key), step = (h >> 33) | 1, bits = words.size() * 64;
+        for (int i = 0; i < 7; ++i, h += step) {
+            if (!(words[(h % bits) / 64] & (1ull << (h % 64)))) return false;
+        }
+        return true;
+    }
+};
+
+// Entry layout inside blocks and the WAL: i32 key, u8 deleted, u32 length, value.
+static void putLsmEntry(ByteWriter& w, int32_t key, bool deleted, string_view value) {
+    w.put<int32_t>(key);
+    w.put<uint8_t>(deleted);
+    w.putString(value);
+}
+
+static bool getLsmEntry(ByteReader& r, int32_t& key, bool& deleted, string_view& value) {
+    key = r.get<int32_t>();
+    deleted = r.get<uint8_t>() != 0;
+    value = r.getString();
+    return r.ok;
+}
+
+struct LsmBlockRef {
+    int32_t firstKey;
+    uint64_t offset;
+    uint32_t size;
+};
+
+/**
+ * @brief Streams sorted entries into a new run file.
+ *
+ * Layout: data blocks, block index (u64 count + {i32 first key, u64 offset,
+ * u32 size}), bloom filter (u64 words + words), then a footer with the index
+ * and bloom offsets, the entry count and a magic. Each data block, and the
+ * index and bloom filter together, is followed by a u32 CRC32C of its bytes. The file is written under a
+ * temporary name and renamed into place by finish().
+ */
+class LsmRunWriter {
+public:
+    LsmRunWriter(const string& path, size_t expectedKeys) : path_(path), tmp_(path + ".tmp") {
+        file_ = fopen(tmp_.c_str(), "wb");
+        ok_ = file_ != nullptr;  // a full or read-only disk fails finish(), not the first block
+        bloom_.init(expectedKeys);
+    }
+
+    ~LsmRunWriter() {
+        if (file_) {
+            fclose(file_);
+            remove(tmp_.c_str());
+        }
+    }
+
+    void add(int32_t key, bool deleted, string_view value) {
+        if (!ok_) return;
+        if (block_.buf.empty()) firstKey_ = key;
+        putLsmEntry(block_, key, deleted, value);
+        bloom_.add(key);
+        ++entries_;
+        if (block_.buf.size() >= LSM_BLOCK_BYTES) finishBlock();
+    }
+
+    bool finish() {
+        if (!file_) return false;
+        finishBlock();
+        ByteWriter tail;
+        uint64_t indexOffset = offset_;
+        tail.put<uint64_t>(index_.size());
+        for (const auto& ref : index_) {
+            tail.put<int32_t>(ref.firstKey);
+            tail.put<uint64_t>(ref.offset);
+            tail.put<uint32_t>(ref.size);
+        }
+        uint64_t bloomOffset = indexOffset + tail.buf.size();
+        tail.put<uint64_t>(bloom_.words.size());
+        for (uint64_t word : bloom_.words) tail.put<uint64_t>(word);
+        tail.put<uint32_t>(simd.crc32c(0, tail.buf.data(), tail.buf.size()));
+        tail.put<uint64_t>(indexOffset);
+        tail.put<uint64_t>(bloomOffset);
+        tail.put<uint64_t>(entries_);
+        tail.buf.append(LSM_RUN_MAGIC, sizeof(LSM_RUN_MAGIC));
+        ok_ = ok_ && fwrite(tail.buf.data(), 1, tail.buf.size(), file_) == tail.buf.size();
+        ok_ = ok_ && fflush(file_) == 0 && syncDescriptor(descriptorOf(file_));
+        ok_ = (fclose(file_) == 0) && ok_;
+        file_ = nullptr;
+        if (!ok_ || !replaceFile(tmp_, path_)) {
+            remove(tmp_.c_str());
+            return false;
+        }
+        return syncDirectoryOf(path_);
+    }
+
+private:
+    void finishBlock() {
+        if (block_.buf.empty()) return;
+        index_.push_back({firstKey_, offset_, static_cast<uint32_t>(block_.buf.size())});
+        block_.put<uint32_t>(simd.crc32c(0, block_.buf.data(), block_.buf.size()));
+        ok_ = ok_ && fwrite(block_.buf.data(), 1, block_.buf.size(), file_) == block_.buf.size();
+        offset_ += block_.buf.size();
+        block_.buf.clear();
+    }
+
+    string path_, tmp_;
+    FILE* file_;
+    bool ok_;           ///< Every write so far succeeded; no writes are attempted once false
+    ByteWriter block_;
+    int32_t firstKey_ = 0;
+    uint64_t offset_ = 0;
+    uint64_t entries_ = 0;
+    vector<LsmBlockRef> index_;
+    BloomFilter bloom_;
+};
+
+/**
+ * @brief An immutable sorted run. Its block index and bloom filter stay in
+ * memory; data blocks are read from disk on demand.
+ */
+class LsmRun {
+public:
+    static shared_ptr<LsmRun> open(const string& path) {
+        shared_ptr<LsmRun> run(new LsmRun(path));
+        return run->load() ? run : nullptr;
+    }
+
+    ~LsmRun() {
+        if (file_) fclose(file_);
+        if (obsolete) remove(path.c_str());
+    }
+
+    /// Looks a key up; false if this run has no entry for it. Not thread-safe.
+    bool get(int32_t key, bool& deleted, string& value) {
+        if (index_.empty() || key < index_.front().firstKey || !bloom_.mayContain(key)) return false;
+        auto ref = upper_bound(index_.begin(), index_.end(), key,
+                               [](int32_t k, const LsmBlockRef& b) { return k < b.firstKey; }) - 1;
+        if (!readBlock(file_, *ref, block_)) return false;
+        ByteReader r(block_.data(), block_.size());
+        int32_t k;
+        string_view v;
+        while (!r.atEnd() && getLsmEntry(r, k, deleted, v)) {
+            if (k == key) {
+                value.assign(v.data(), v.size());
+                return true;
+            }
+            if (k > key) break;
+        }
+        return false;
+    }
+
+    /// Reads a block and checks it against the CRC32C that follows it.
+    static bool readBlock(FILE* file, const LsmBlockRef& ref, string& out) {
+        uint32_t crc;
+        out.resize(ref.size);
+        return seekFile(file, ref.offset) && fread(&out[0], 1, ref.size, file) == ref.size &&
+               fread(&crc, 1, sizeof(crc), file) == sizeof(crc) && simd.crc32c(0, out.data(), out.size()) == crc;
+    }
+
+    const vector<LsmBlockRef>& blocks() const { return index_; }
+
+    string path;
+    uint64_t entries = 0;
+    int32_t lastKey = 0;    ///< Highest key in the run, deleted or not
+    bool obsolete = false;  ///< Delete the file once the last reference goes
+
+private:
+    explicit LsmRun(const string& p) : path(p) {}
+
+    bool load() {
+        file_ = fopen(path.c_str(), "rb");
+        if (!file_) return false;
+        string footer(32, '\0');
+        uint64_t end = 0;
+        if (!fileLength(file_, end) || end < 32 + sizeof(uint32_t) || !seekFile(file_, end - 32) ||
+            fread(&footer[0], 1, 32, file_) != 32 ||
+            memcmp(footer.data() + 24, LSM_RUN_MAGIC, sizeof(LSM_RUN_MAGIC)) != 0) {
+            return false;
+        }
+        ByteReader f(footer.data(), footer.size());
+        uint64_t indexOffset = f.get<uint64_t>(), bloomOffset = f.get<uint64_t>();
+        entries = f.get<uint64_t>();
+        end -= 32 + sizeof(uint32_t);  // the footer and the index and bloom filter's CRC
+        if (indexOffset > bloomOffset || bloomOffset > end || end - indexOffset > UINT32_MAX) return false;
+
+        string meta;
+        if (!readBlock(file_, {0, indexOffset, static_cast<uint32_t>(end - indexOffset)}, meta)) return false;
+        ByteReader r(meta.data(), meta.size());
+        uint64_t blocks = r.get<uint64_t>();
+        for (uint64_t i = 0; i < blocks && r.ok; ++i) {
+            LsmBlockRef ref;
+            ref.firstKey = r.get<int32_t>();
+            ref.offset = r.get<uint64_t>();
+            ref.size = r.get<uint32_t>();
+            index_.push_back(ref);
+        }
+        bloom_.words.resize(r.get<uint64_t>());
+        for (auto& word : bloom_.words) word = r.get<uint64_t>();
+        if (!r.ok || bloom_.words.empty()) return false;
+        if (index_.empty()) return true;  // a compaction of nothing but deletions
+        if (!readBlock(file_, index_.back(), block_)) return false;
+        ByteReader last(block_.data(), block_.size());
+        int32_t key;
+        bool deleted;
+        string_view value;
+        while (!last.atEnd() && getLsmEntry(last, key, deleted, value)) lastKey = key;
+        return true;
+    }
+
+    FILE* file_ = nullptr;
+    vector<LsmBlockRef> index_;
+    BloomFilter bloom_;
+    string block_;  ///< Reused read buffer
+};
+
+// One sorted input of a merge: the memtable or a run read block by block.
+class LsmSource {
+public:
+    virtual ~LsmSource() {}
+    virtual bool valid() const = 0;
+    virtual int32_t key() const = 0;
+    virtual bool deleted() const = 0;
+    virtual string_view value() const = 0;
+    virtual void next() = 0;
+};
+
+class LsmMemtableSource : public LsmSource {
+public:
+    explicit LsmMemtableSource(const map<int32_t, LsmValue>& table) : it_(table.begin()), end_(table.end()) {}
+    bool valid() const override { return it_ != end_; }
+    int32_t key() const override { return it_->first; }
+    bool deleted() const override { return it_->second.deleted; }
+    string_view value() const override { return it_->second.value; }
+    void next() override { ++it_; }
+private:
+    map<int32_t, LsmValue>::const_iterator it_, end_;
+};
+
+// Reads a run through its own file handle so it can run beside point lookups.
+class LsmRunCursor : public LsmSource {
+public:
+    explicit LsmRunCursor(const LsmRun& run) : run_(run), file_(fopen(run.path.c_str(), "rb")), reader_(nullptr, 0) {
+        next();
+    }
+    ~LsmRunCursor() override { if (file_) fclose(file_); }
+    bool valid() const override { return valid_; }
+    int32_t key() const override { return key_; }
+    bool deleted() const override { return deleted_; }
+    string_view value() const override { return value_; }
+    /// True if the cursor stopped before the end of the run (unreadable or damaged block).
+    bool failed() const { return failed_; }
+
+    void next() override {
+        while (reader_.atEnd()) {
+            if (block_ >= run_.blocks().size()) {
+                valid_ = false;
+                return;
+            }
+            if (!file_ || !LsmRun::readBlock(file_, run_.blocks()[block_++], buf_)) {
+                valid_ = false;
+                failed_ = true;
+                return;
+            }
+            reader_ = ByteReader(buf_.data(), buf_.size());
+        }
+        valid_ = getLsmEntry(reader_, key_, deleted_, value_);
+        failed_ = !valid_;
+    }
+
+private:
+    const LsmRun& run_;
+    FILE* file_;
+    size_t block_ = 0;
+    string buf_;
+    ByteReader reader_;
+    bool valid_ = false;
+    bool failed_ = false;
+    int32_t key_ = 0;
+    bool deleted_ = false;
+    string_view value_;
+};
+
+// Merges sources ordered newest first; for each key only the newest entry is visited.
+static void lsmMerge(const vector<LsmSource*>& sources, const function<void(int32_t, bool, string_view)>& visit) {
+    while (true) {
+        LsmSource* newest = nullptr;
+        for (LsmSource* s : sources) {
+            if (s->valid() && (!newest || s->key() < newest->key())) newest = s;
+        }
+        if (!newest) return;
+        int32_t key = newest->key();
+        visit(key, newest->deleted(), newest->value());
+        for (LsmSource* s : sources) {
+            if (s->valid() && s->key() == key) s->next();
+        }
+    }
+}
+
+/**
+ * @brief Embedded LSM table mapping int32 keys to byte strings, stored in one directory.
+ *
+ * The directory holds wal.log (memtable contents not yet in a run), run-N.sst
+ * files and a MANIFEST listing the live runs, newest first. All methods are
+ * thread-safe; compaction runs on a background thread.
+ */
+class LsmTable {
+public:
+    explicit LsmTable(const string& dir) : dir_(dir) {
+        error_code ec;
+        filesystem::create_directories(dir_, ec);
+        ok_ = openRuns() && replayWal();
+        wal_ = fopen(walPath().c_str(), "ab");
+        ok_ = ok_ && wal_;
+        compactor_ = thread([this]() { compactionLoop(); });
+    }
+
+    ~LsmTable() {
+        {
+            lock_guard<mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        compactor_.join();
+        if (wal_) fclose(wal_);
+    }
+
+    bool ok() const { return ok_; }
+    bool put(int32_t key, string_view value) { return write(key, false, value); }
+    bool erase(int32_t key) { return write(key, true, string_view()); }
+
+    /// Point lookup: memtable first, then runs newest to oldest.
+    bool get(int32_t key, string& value) {
+        lock_guard<mutex> lock(mutex_);
+        auto it = memtable_.find(key);
+        if (it != memtable_.end()) {
+            if (it->second.deleted) return false;
+            value = it->second.value;
+            return true;
+        }
+        bool deleted;
+        for (auto& run : runs_) {
+            if (run->get(key, deleted, value)) return !deleted;
+        }
+        return false;
+    }
+
+    /// Visits every live key in ascending order. Writers wait until it returns.
+    void scan(const function<void(int32_t, string_view)>& visit) {
+        lock_guard<mutex> lock(mutex_);
+        vector<unique_ptr<LsmSource>> owned;
+        owned.push_back(make_unique<LsmMemtableSource>(memtable_));
+        for (auto& run : runs_) owned.push_back(make_unique<LsmRunCursor>(*run));
+        vector<LsmSource*> sources;
+        for (auto& s : owned) sources.push_back(s.get());
+        lsmMerge(sources, [&](int32_t key, bool deleted, string_view value) {
+            if (!deleted) visit(key, value);
+        });
+    }
+
+    /// Writes the memtable out as a run so the WAL can be emptied.
+    bool flush() {
+        lock_guard<mutex> lock(mutex_);
+        return flushLocked();
+    }
+
+    /// Drops every key.
+    bool reset() {
+        lock_guard<mutex> lock(mutex_);
+        for (auto& run : runs_) run->obsolete = true;
+        runs_.clear();
+        memtable_.clear();
+        memtableBytes_ = 0;
+        return writeManifestLocked() && truncateWalLocked();
+    }
+
+    size_t runCount() const {
+        lock_guard<mutex> lock(mutex_);
+        return runs_.size();
+    }
+
+    /// True if opening the table stopped replaying the WAL at a record whose checksum did not match.
+    bool walDamaged() const { return walDamaged_; }
+
+    /// Highest key ever written and not yet compacted away, deleted or not; 0 if none.
+    int32_t lastKey() const {
+        lock_guard<mutex> lock(mutex_);
+        int32_t last = memtable_.empty() ? 0 : memtable_.rbegin()->first;
+        for (const auto& run : runs_) last = max(last, run->lastKey);
+        return last;
+    }
+
+private:
+    string walPath() const { return (filesystem::path(dir_) / "wal.log").string(); }
+    string runPath(uint64_t id) const { return (filesystem::path(dir_) / ("run-" + to_string(id) + ".sst")).string(); }
+
+    bool openRuns() {
+        string manifest;
+        if (!readFile((filesystem::path(dir_) / "MANIFEST").string(), manifest)) return true;
+        if (checkFooter(manifest) == FooterCheck::Mismatch) return false;
+        istringstream in(manifest);
+        string name;
+        while (in >> name) {
+            shared_ptr<LsmRun> run = LsmRun::open((filesystem::path(dir_) / name).string());
+            if (!run) return false;
+            runs_.push_back(run);
+            nextRunId_ = max<uint64_t>(nextRunId_, strtoull(name.c_str() + 4, nullptr, 10) + 1);
+        }
+        return true;
+    }
+
+    // WAL records: log records holding one entry each. Replay stops at a torn
+    // or damaged record and cuts the WAL back to the entries before it.
+    bool replayWal() {
+        string data;
+        if (!readFile(walPath(), data, true)) return true;
+        ByteReader r(data.data(), data.size()), rec(nullptr, 0);
+        size_t accepted = 0;
+        LogRead read = LogRead::End;
+        while (!r.atEnd() && (read = nextLogRecord(r, rec)) == LogRead::Record) {
+            int32_t key;
+            bool deleted;
+            string_view value;
+            if (!getLsmEntry(rec, key, deleted, value)) break;
+            applyLocked(key, deleted, value);
+            accepted = r.p - data.data();
+        }
+        walDamaged_ = read == LogRead::Damaged;
+        return accepted == data.size() || truncateLog(walPath(), accepted);
+    }
+
+    void applyLocked(int32_t key, bool deleted, string_view value) {
+        LsmValue& slot = memtable_[key];
+        memtableBytes_ += value.size() + 16;
+        slot.deleted = deleted;
+        slot.value.assign(value.data(), value.size());
+    }
+
+    bool write(int32_t key, bool deleted, string_view value) {
+        lock_guard<mutex> lock(mutex_);
+        if (!wal_) return false;
+        walRecord_.buf.clear();
+        size_t start = openLogRecord(walRecord_);
+        putLsmEntry(walRecord_, key, deleted, value);
+        if (!sealLogRecord(walRecord_, start) ||
+            fwrite(walRecord_.buf.data(), 1, walRecord_.buf.size(), wal_) != walRecord_.buf.size() || fflush(wal_) != 0) {
+            return false;
+        }
+        applyLocked(key, deleted, value);
+        return memtableBytes_ < LSM_MEMTABLE_BYTES || flushLocked();
+    }
+
+    bool flushLocked() {
+        if (memtable_.empty()) return true;
+        uint64_t id = nextRunId_++;
+        LsmRunWriter writer(runPath(id), memtable_.size());
+        for (const auto& entry : memtable_) writer.add(entry.first, entry.second.deleted, entry.second.value);
+        shared_ptr<LsmRun> run = writer.finish() ? LsmRun::open(runPath(id)) : nullptr;
+        if (!run) return false;
+        runs_.insert(runs_.begin(), run);
+        if (!writeManifestLocked()) return false;
+        memtable_.clear();
+        memtableBytes_ = 0;
+        compactionFailed_ = false;  // a failed compaction gets another try
+        if (runs_.size() >= LSM_COMPACT_RUNS) wake_.notify_one();
+        return truncateWalLocked();
+    }
+
+    bool truncateWalLocked() {
+        if (wal_) fclose(wal_);
+        wal_ = fopen(walPath().c_str(), "wb");
+        return wal_ != nullptr;
+    }
+
+    bool writeManifestLocked() {
+        ostringstream out;
+        for (const auto& run : runs_) out << filesystem::path(run->path).filename().string() << "\n";
+        string manifest = out.str();
+        appendFooter(manifest);
+        return writeFileAtomic((filesystem::path(dir_) / "MANIFEST").string(), manifest);
+    }
+
+    // Merges every run into one. Runs flushed meanwhile are newer and stay in
+    // front. A failed merge leaves the runs as they are until the next flush.
+    void compactionLoop() {
+        unique_lock<mutex> lock(mutex_);
+        while (true) {
+            wake_.wait(lock, [this]() { return stop_ || (!compactionFailed_ && runs_.size() >= LSM_COMPACT_RUNS); });
+            if (stop_) return;
+            vector<shared_ptr<LsmRun>> inputs = runs_;
+            uint64_t id = nextRunId_++;
+            lock.unlock();
+
+            shared_ptr<LsmRun> output;
+            {
+                size_t keys = 0;
+                vector<unique_ptr<LsmRunCursor>> cursors;
+                vector<LsmSource*> sources;
+                for (auto& run : inputs) {
+                    keys += run->entries;
+                    cursors.push_back(make_unique<LsmRunCursor>(*run));
+                    sources.push_back(cursors.back().get());
+                }
+                LsmRunWriter writer(runPath(id), keys);
+                // Nothing older remains, so deletions can be dropped
+                lsmMerge(sources, [&](int32_t key, bool deleted, string_view value) {
+                    if (!deleted) writer.add(key, false, value);
+                });
+                // A damaged input would leave its remaining keys out of the merge
+                bool complete = none_of(cursors.begin(), cursors.end(), [](const auto& c) { return c->failed(); });
+                if (complete && writer.finish()) {
+                    output = LsmRun::open(runPath(id));
+                    if (!output) remove(runPath(id).c_str());
+                }
+            }
+
+            lock.lock();
+            bool current = runs_.size() >= inputs.size() &&
+                           equal(inputs.begin(), inputs.end(), runs_.end() - inputs.size());
+            if (!output) {
+                cerr << " [Error] Could not compact " << dir_ << "; retrying after the next flush.\n";
+                compactionFailed_ = true;
+                continue;
+            }
+            if (!current) {  // reset() ran meanwhile
+                output->obsolete = true;
+                continue;
+            }
+            runs_.resize(runs_.size() - inputs.size());
+            runs_.push_back(output);
+            if (!writeManifestLocked()) {
+                runs_.pop_back();
+                runs_.insert(runs_.end(), inputs.begin(), inputs.end());
+                output->obsolete = true;
+                compactionFailed_ = true;
+                continue;
+            }
+            for (auto& run : inputs) run->obsolete = true;
+        }
+    }
+
+    string dir_;
+    bool ok_ = false;
+    mutable mutex mutex_;
+    condition_variable wake_;
+    map<int32_t, LsmValue> memtable_;
+    size_t memtableBytes_ = 0;
+    FILE* wal_ = nullptr;
+    ByteWriter walRecord_;               ///< Reused WAL record buffer
+    bool walDamaged_ = false;            ///< See walDamaged()
+    vector<shared_ptr<LsmRun>> runs_;    ///< Newest first
+    uint64_t nextRunId_ = 1;
+    bool compactionFailed_ = false;      ///< Last merge failed; cleared by the next flush
+    bool stop_ = false;
+    thread compactor_;
+};
+
+/**
+ * @brief Storage backend keeping items in an LsmTable keyed by item ID and
+ * sales in an append-only log.
+ *
+ * It serves items: a store loaded through InventoryStore::load() gets only
+ * the sales and ID counters, and reads items in through readItem() (a point
+ * lookup in the memtable and runs) and scanItems(). Other callers of load(),
+ * such as a conversion, get every item. Every mutation is written through as
+ * it happens, so a checkpoint only has to flush the memtable. If a write
+ * fails, the checkpoint writes the items in memory again, which include every
+ * item changed since the load, and repeats the deletions that failed. A
+ * store the backend has not been following (e.g. a conversion) has the
+ * table rewritten instead.
+ */
+class LsmBackend : public StorageBackend {
+public:
+    explicit LsmBackend(const string& dir)
+        : tableDir_((filesystem::path(dir) / LSM_DIR).string()),
+          salesPath_((filesystem::path(dir) / LSM_SALES_FILE).string()) {}
+    ~LsmBackend() override { close(); }
+
+    const char* name() const override { return "lsm"; }
+    bool journals() const override { return true; }
+    bool servesItems() const override { return true; }
+
+    bool open() override {
+        if (!table_) table_ = make_unique<LsmTable>(tableDir_);
+        if (!sales_) sales_ = fopen(salesPath_.c_str(), "ab");
+        return table_->ok() && sales_;
+    }
+
+    void close() override {
+        table_.reset();
+        if (sales_) fclose(sales_);
+        sales_ = nullptr;
+    }
+
+    /// Direct point lookup in the table, without loading the store.
+    bool lookupItem(int32_t id, string& encoded) { return table_ && table_->get(id, encoded); }
+    LsmTable* table() { return table_.get(); }
+
+    bool readItem(int id, const ItemVisitor& visit) override {
+        if (!lookupItem(id, found_)) return false;
+        return decodeItem(found_, visit);
+    }
+
+    void scanItems(const ItemVisitor& visit) override {
+        if (table_) table_->scan([&visit](int32_t, string_view encoded) { decodeItem(encoded, visit); });
+    }
+
+    bool load(InventoryStore& store) override {
+        if (!table_) return false;
+        serving_ = store.itemsServed();
+        unerased_.clear();
+        if (serving_) {
+            store.nextItemId = max(store.nextItemId, table_->lastKey() + 1);
+        } else {
+            TraceSpan phase("scan items", "persistence");
+            table_->scan([&store](int32_t, string_view encoded) {
+                ByteReader r(encoded.data(), encoded.size());
+                Item item = getItem(r, store.strings);
+                store.items.push_back(item);
+                if (item.id >= store.nextItemId) store.nextItemId = item.id + 1;
+            });
+        }
+        if (table_->walDamaged() &&
+            !store.reportDamagedFile({tableDir_, 1, 1, "wal.log: checksum mismatch; replay stopped there"})) {
+            return false;
+        }
+        string data;
+        if (readFile(salesPath_, data, true)) {
+            TraceSpan phase("read sales log", "persistence");
+            ByteReader r(data.data(), data.size()), rec(nullptr, 0);
+            size_t accepted = 0;
+            LogRead read = LogRead::End;
+            while (!r.atEnd() && (read = nextLogRecord(r, rec)) == LogRead::Record) {
+                Sale sale = getSale(rec);
+                if (!rec.ok) break;
+                sale.item_name = store.strings.internView(sale.item_name);
+                store.sales.push_back(sale);
+                if (sale.id >= store.nextSaleId) store.nextSaleId = sale.id + 1;
+                accepted = r.p - data.data();
+            }
+            if (read == LogRead::Damaged &&
+                !store.reportDamagedFile({salesPath_, 1, 1, "record " + to_string(store.sales.size() + 1) +
+                                          ": checksum mismatch; replay stopped there"})) {
+                return false;
+            }
+            if (accepted < data.size()) {
+                if (sales_) fclose(sales_);
+                truncateLog(salesPath_, accepted);
+                sales_ = fopen(salesPath_.c_str(), "ab");
+            }
+        }
+        following_ = true;
+        bool found = !store.items.empty() || !store.sales.empty() || store.nextItemId > 1;
+        if (found && store.verbose) {
+            if (serving_) {
+                cout << " [Loaded] " << store.sales.size() << " sales records; items are read from "
+                     << tableDir_ << " as needed.\n";
+            } else {
+                cout << " [Loaded] " << store.items.size() << " items and " << store.sales.size()
+                     << " sales records from " << tableDir_ << ".\n";
+            }
+        }
+        return found;
+    }
+
+    bool append(const Mutation& m) override {
+        bool written = write(m);
+        following_ = following_ && written;  // the table missed a change: the next checkpoint rewrites it
+        return written;
+    }
+
+    bool checkpoint(const InventoryStore& store) override {
+        bool saved = table_ && sales_;
+        if (saved && !following_) {
+            // A served store holds only the items read in; the rest of the table stays
+            TraceSpan phase(serving_ ? "rewrite changed items" : "rewrite table", "persistence");
+            saved = serving_ || table_->reset();
+            for (const auto& item : store.items) {
+                scratch_.buf.clear();
+                putItem(scratch_, item, store.strings);
+                saved = saved && table_->put(item.id, scratch_.buf);
+            }
+            for (int32_t id : unerased_) saved = saved && table_->erase(id);
+            ByteWriter log;
+            for (const auto& sale : store.sales) {
+                size_t start = openLogRecord(log);
+                putSale(log, sale);
+                sealLogRecord(log, start);
+            }
+            fclose(sales_);
+            sales_ = nullptr;
+            saved = saved && writeFileAtomic(salesPath_, log.buf, true);
+            sales_ = fopen(salesPath_.c_str(), "ab");
+        }
+        {
+            TraceSpan phase("flush memtable", "persistence");
+            saved = saved && table_->flush() && sales_ && fflush(sales_) == 0;
+        }
+        following_ = following_ || saved;
+        if (saved) unerased_.clear();
+        if (store.verbose) {
+            if (saved) {
+                cout << " [Saved] Items to " << tableDir_ << ", sales to " << salesPath_ << endl;
+            } else {
+                cout << " [Error] Could not checkpoint " << tableDir_ << "!\n";
+            }
+        }
+        return saved;
+    }
+
+private:
+    static bool decodeItem(string_view encoded, const ItemVisitor& visit) {
+        ByteReader r(encoded.data(), encoded.size());
+        string_view name, sizeColor;
+        Item item = getItem(r, name, sizeColor);
+        if (r.ok) visit(item, name, sizeColor);
+        return r.ok;
+    }
+
+    bool write(const Mutation& m) {
+        if (m.kind == Mutation::DELETE_ITEM) {
+            bool erased = table_ && table_->erase(m.item.id);
+            if (!erased) unerased_.push_back(m.item.id);
+            return erased;
+        }
+        if (!table_ || !sales_) return false;
+        scratch_.buf.clear();
+        putItem(scratch_, m.item, m.name, m.size_color);
+        if (!table_->put(m.item.id, scratch_.buf)) return false;
+        if (m.kind != Mutation::SELL_ITEM) return true;
+        scratch_.buf.clear();
+        size_t start = openLogRecord(scratch_);
+        putSale(scratch_, m.sale);
+        return sealLogRecord(scratch_, start) && fwrite(scratch_.buf.data(), 1, scratch_.buf.size(), sales_) == scratch_.buf.size() && fflush(sales_) == 0;
+    }
+
+    string tableDir_;
+    string salesPath_;
+    unique_ptr<LsmTable> table_;
+    FILE* sales_ = nullptr;
+    ByteWriter scratch_;       ///< Reused record buffer
+    string found_;             ///< Reused readItem() buffer
+    bool following_ = false;   ///< Table mirrors the store: loaded from it or fully written
+    bool serving_ = false;     ///< load() left the items in the table
+    vector<int32_t> unerased_; ///< Deletions the table missed since the last load or checkpoint
+};
+
+unique_ptr<StorageBackend> makeLsmBackend(const string& dir) {
+    return make_unique<LsmBackend>(dir);
+}
+
+/* ================= SHARDED STORAGE ================= */
+// Both tables split by ID range into shard files in one directory, written
+// and read by a thread pool (one task per shard) and tied together by a
+// MANIFEST that is replaced atomically. A shard whose bytes match what the
+// MANIFEST already records is left as it is.
+
+const string SHARD_DIR = "inventory.shards";   // Directory of the sharded backend
+const int32_t SHARD_MIN_IDS = 4096;            // Narrowest ID range per shard, so small tables stay in one
+const unsigned SHARD_MAX_PER_WORKER = 4;       // Ranges are widened once a table needs more shards than this per worker
+
+// One MANIFEST line: a shard file and what it must hold.
+struct ShardFile {
+    char table = 'i';    ///< 'i' items, 's' sales
+    int32_t first = 1;   ///< First ID of the shard's range
+    string file;         ///< Name inside the directory
+    uint64_t count = 0;  ///< Records in the shard
+    uint64_t bytes = 0;  ///< File length
+    uint32_t crc = 0;    ///< CRC32C of the whole file
+};
+
+// The MANIFEST: counters, range widths and the live shards, items first, each table in ID order.
+struct ShardManifest {
+    uint64_t generation = 0;
+    int32_t nextItemId = 1;
+    int32_t nextSaleId = 1;
+    int32_t width[2] = {0, 0};  ///< IDs per shard for items and sales
+    vector<ShardFile> shards;
+};
+
+// Range width for a table: kept while the table fits SHARD_MAX_PER_WORKER
+// shards per worker, so unchanged ranges keep their files, else recomputed.
+static int32_t shardWidth(int32_t previous, int32_t nextId, unsigned workers) {
+    int64_t ids = max(nextId - 1, 1);
+    if (previous >= SHARD_MIN_IDS && (ids + previous - 1) / previous <= int64_t(SHARD_MAX_PER_WORKER) * workers) {
+        return previous;
+    }
+    return static_cast<int32_t>(max<int64_t>(SHARD_MIN_IDS, (ids + workers - 1) / workers));
+}
+
+// Groups record positions by ID range: shard k holds IDs [1 + k * width, 1 + (k + 1) * width).
+template <class Records>
+static vector<vector<uint32_t>> shardRows(const Records& records, int32_t nextId, int32_t width) {
+    vector<vector<uint32_t>> rows(static_cast<size_t>((max(nextId - 1, 1) + width - 1) / width));
+    for (size_t i = 0; i < records.size(); ++i) {
+        size_t k = static_cast<size_t>(max(records[i].id - 1, 0) / width);
+        rows[min(k, rows.size() - 1)].push_back(static_cast<uint32_t>(i));
+    }
+    return rows;
+}
+
+/**
+ * @brief Sharded backend: items and sales split by ID range into files under
+ * one directory, saved and loaded in parallel.
+ *
+ * A checkpoint encodes and checksums every shard on the scheduler. A shard whose
+ * CRC32C and length match the MANIFEST entry for the same range keeps its
+ * file; the others are written under new names and fsynced. Only then is the
+ * MANIFEST replaced with writeFileAtomic(), so a crash leaves the previous set
+ * intact, and files it no longer lists are deleted. Loading reads, verifies and
+ * decodes shards on the scheduler; interning their text runs on one thread.
+ */
+class ShardedBackend : public StorageBackend {
+public:
+    ShardedBackend(const string& dir, unsigned workers)
+        : dir_((filesystem::path(dir) / SHARD_DIR).string()), workers_(workers ? workers : scheduler.threads()) {}
+    const char* name() const override { return "sharded"; }
+
+    bool open() override {
+        error_code ec;
+        filesystem::create_directories(dir_, ec);
+        return !ec;
+    }
+
+    bool load(InventoryStore& store) override {
+        ShardManifest manifest;
+        string problem;
+        damaged_.clear();
+        bool found = readManifest(manifest, problem);
+        if (!problem.empty()) {
+            if (store.verbose) cout << " [Error] " << manifestPath() << " " << problem << ".\n";
+            // A written MANIFEST has generation 1 or later; 0 means it could not be parsed at all
+            if (manifest.generation == 0) damaged_.push_back(manifestPath());
+            if (!store.reportDamagedFile({manifestPath(), 1, 1, problem})) return false;
+        }
+        if (!found) return false;
+
+        // Read, verify and decode every shard in parallel; text stays as views into each file
+        struct Loaded {
+            string data;
+            vector<Item> items;
+            vector<string_view> text;  ///< Name and size/colour of each item
+            vector<Sale> sales;
+            bool ok = false;
+        };
+        vector<Loaded> loaded(manifest.shards.size());
+        {
+            TraceSpan phase("read shards", "persistence");
+            scheduler.parallelFor(0, loaded.size(), 1, [&](size_t lo, size_t hi) {
+                for (size_t i = lo; i < hi; ++i) readShard(manifest.shards[i], loaded[i]);
+            });
+        }
+
+        TraceSpan phase("merge shards", "persistence");
+        size_t itemCount = 0, saleCount = 0;
+        bool intact = true;
+        for (size_t i = 0; i < loaded.size(); ++i) {
+            if (!loaded[i].ok) {
+                string file = shardPath(manifest.shards[i].file);
+                string message = "missing or damaged; its " + to_string(manifest.shards[i].count) + " records were not loaded";
+                if (store.verbose) cout << " [Error] " << file << " is " << message << ".\n";
+                damaged_.push_back(file);
+                intact = false;
+                if (!store.reportDamagedFile({file, 1, 1, message})) return false;
+            }
+            itemCount += loaded[i].items.size();
+            saleCount += loaded[i].sales.size();
+        }
+        store.items.reserve(itemCount);
+        store.sales.reserve(saleCount);
+        for (Loaded& shard : loaded) {
+            for (size_t i = 0; i < shard.items.size(); ++i) {
+                Item item = shard.items[i];
+                item.name = store.strings.intern(shard.text[2 * i]);
+                item.size_color = store.strings.intern(shard.text[2 * i + 1]);
+                store.items.push_back(item);
+            }
+            for (Sale sale : shard.sales) {
+                sale.item_name = store.strings.internView(sale.item_name);
+                store.sales.push_back(sale);
+            }
+            shard = Loaded();  // release the file buffer as soon as it is interned
+        }
+        store.nextItemId = manifest.nextItemId;
+        store.nextSaleId = manifest.nextSaleId;
+
+        SnapshotHeader expected;
+        expected.nextItemId = manifest.nextItemId;
+        expected.nextSaleId = manifest.nextSaleId;
+        for (const ShardFile& shard : manifest.shards) (shard.table == 'i' ? expected.itemCount : expected.saleCount) += shard.count;
+        if (intact && !checkSnapshotConsistency(store, expected, problem) && store.verbose) {
+            cout << " [Error] " << dir_ << " is inconsistent: " << problem << ".\n";
+        }
+        if (store.verbose) {
+            cout << " [Loaded] " << store.items.size() << " items and " << store.sales.size() << " sales records from "
+                 << manifest.shards.size() << " shards in " << dir_ << ".\n";
+        }
+        return true;
+    }
+
+    bool checkpoint(const InventoryStore& store) override {
+        // The store lacks the records of a damaged file; saving would replace that file and lose them
+        if (!damaged_.empty()) {
+            if (store.verbose) {
+                cout << " [Error] Not saving " << dir_ << ": " << damaged_.front() << " could not be loaded, and "
+                     << "saving would delete its records. Restore it from a backup and restart.\n";
+            }
+            return false;
+        }
+        ShardManifest previous, next;
+        string problem;
+        readManifest(previous, problem);
+        next.generation = previous.generation + 1;
+        next.nextItemId = store.nextItemId;
+        next.nextSaleId = store.nextSaleId;
+        next.width[0] = shardWidth(previous.width[0], store.nextItemId, workers_);
+        next.width[1] = shardWidth(previous.width[1], store.nextSaleId, workers_);
+
+        struct Job {
+            vector<uint32_t> rows;
+            ShardFile shard;
+            bool written = false;  ///< A new file was created for it
+            bool ok = true;
+        };
+        vector<Job> jobs;
+        auto plan = [&](char table, vector<vector<uint32_t>> rows, int32_t width) {
+            for (size_t k = 0; k < rows.size(); ++k) {
+                if (rows[k].empty()) continue;
+                Job job;
+                job.shard.table = table;
+                job.shard.first = static_cast<int32_t>(1 + k * width);
+                job.rows = move(rows[k]);
+                jobs.push_back(move(job));
+            }
+        };
+        {
+            TraceSpan phase("partition", "persistence");
+            plan('i', shardRows(store.items, store.nextItemId, next.width[0]), next.width[0]);
+            plan('s', shardRows(store.sales, store.nextSaleId, next.width[1]), next.width[1]);
+        }
+        {
+            TraceSpan phase("write shards", "persistence");
+            scheduler.parallelFor(0, jobs.size(), 1, [&](size_t lo, size_t hi) {
+                for (size_t k = lo; k < hi; ++k) {
+                    Job& job = jobs[k];
+                    job.ok = writeShard(store, previous, next.generation, job.shard, job.rows, job.written);
+                }
+            });
+        }
+
+        bool ok = true;
+        skipped_ = 0;
+        for (const Job& job : jobs) {
+            ok = ok && job.ok;
+            skipped_ += !job.written;
+            next.shards.push_back(job.shard);
+        }
+        // The new files' directory entries must be durable before a MANIFEST names them
+        if (ok) {
+            TraceSpan phase("write manifest", "persistence");
+            ok = syncDirectoryOf(manifestPath()) && writeManifest(next);
+        }
+        if (!ok) {
+            for (const Job& job : jobs) {
+                if (job.written) remove(shardPath(job.shard.file).c_str());
+            }
+        } else {
+            removeUnlisted(next);
+        }
+        if (store.verbose) {
+            if (ok) {
+                cout << " [Saved] Items and sales to " << jobs.size() << " shards in " << dir_ << " ("
+                     << skipped_ << " unchanged)" << endl;
+            } else {
+                cout << " [Error] Could not save " << dir_ << "!\n";
+            }
+        }
+        return ok;
+    }
+
+    /// Shards the last checkpoint found unchanged and did not rewrite.
+    size_t skippedShards() const { return skipped_; }
+
+private:
+    string manifestPath() const { return (filesystem::path(dir_) / "MANIFEST").string(); }
+    string shardPath(const string& file) const { return (filesystem::path(dir_) / file).string(); }
+
+    // Missing MANIFEST: false. A damaged one is still parsed, with problem set.
+    bool readManifest(ShardManifest& m, string& problem) const {
+        string text;
+        if (!readFile(manifestPath(), text)) return false;
+        if (checkFooter(text) == FooterCheck::Mismatch) problem = "checksum mismatch; loading the shards it still lists";
+        istringstream in(text);
+        string tag;
+        if (!(in >> tag >> m.generation >> m.nextItemId >> m.nextSaleId >> m.width[0] >> m.width[1]) || tag != "sharded") {
+            problem = "cannot be read";
+            m = ShardManifest();
+            return true;
+        }
+        ShardFile shard;
+        string table;
+        while (in >> table >> shard.first >> shard.file >> shard.count >> shard.bytes >> hex >> shard.crc >> dec) {
+            shard.table = table == "items" ? 'i' : 's';
+            m.shards.push_back(shard);
+        }
+        return true;
+    }
+
+    bool writeManifest(const ShardManifest& m) const {
+        ostringstream out;
+        out << "sharded " << m.generation << " " << m.nextItemId << " " << m.nextSaleId << " " << m.width[0] << " "
+            << m.width[1] << "\n";
+        for (const ShardFile& shard : m.shards) {
+            out << (shard.table == 'i' ? "items " : "sales ") << shard.first << " " << shard.file << " " << shard.count
+                << " " << shard.bytes << " " << hex << shard.crc << dec << "\n";
+        }
+        string manifest = out.str();
+        appendFooter(manifest);
+        return writeFileAtomic(manifestPath(), manifest);
+    }
+
+    // Encodes one shard and writes it unless the previous MANIFEST has the same bytes for its range.
+    bool writeShard(const InventoryStore& store, const ShardManifest& previous, uint64_t generation,
+                    ShardFile& shard, const vector<uint32_t>& rows, bool& written) const {
+        ByteWriter w;
+        w.buf.reserve(rows.size() * (shard.table == 'i' ? 48 : 64));
+        for (uint32_t row : rows) {
+            if (shard.table == 'i') {
+                putItem(w, store.items[row], store.strings);
+            } else {
+                putSale(w, store.sales[row]);
+            }
+        }
+        shard.count = rows.size();
+        shard.bytes = w.buf.size();
+        shard.crc = simd.crc32c(0, w.buf.data(), w.buf.size());
+        for (const ShardFile& old : previous.shards) {
+            if (old.table == shard.table && old.first == shard.first && old.bytes == shard.bytes &&
+                old.crc == shard.crc && old.count == shard.count) {
+                error_code ec;
+                if (filesystem::file_size(shardPath(old.file), ec) == old.bytes && !ec) {
+                    shard.file = old.file;
+                    return true;
+                }
+            }
+        }
+        shard.file = string(shard.table == 'i' ? "items-" : "sales-") + to_string(shard.first) + "-" +
+                     to_string(generation) + ".bin";
+        FILE* f = fopen(shardPath(shard.file).c_str(), "wb");
+        if (!f) return false;
+        written = true;
+        bool ok = fwrite(w.buf.data(), 1, w.buf.size(), f) == w.buf.size() && fflush(f) == 0 &&
+                  syncDescriptor(descriptorOf(f));
+        return fclose(f) == 0 && ok;
+    }
+
+    template <class Loaded>
+    void readShard(const ShardFile& shard, Loaded& out) const {
+        if (!readFile(shardPath(shard.file), out.data, true) || out.data.size() != shard.bytes ||
+            simd.crc32c(0, out.data.data(), out.data.size()) != shard.crc) {
+            return;
+        }
+        ByteReader r(out.data.data(), out.data.size());
+        if (shard.table == 'i') {
+            out.items.reserve(shard.count);
+            out.text.reserve(2 * shard.count);
+            for (uint64_t i = 0; i < shard.count && r.ok; ++i) {
+                string_view name, sizeColor;
+                out.items.push_back(getItem(r, name, sizeColor));
+                out.text.push_back(name);
+                out.text.push_back(sizeColor);
+            }
+        } else {
+            out.sales.reserve(shard.count);
+            for (uint64_t i = 0; i < shard.count && r.ok; ++i) out.sales.push_back(getSale(r));
+        }
+        out.ok = r.ok && r.atEnd();
+        if (!out.ok) out = Loaded();
+    }
+
+    // Deletes shard files of earlier generations once the new MANIFEST is in place.
+    void removeUnlisted(const ShardManifest& m) const {
+        error_code ec;
+        for (const auto& entry : filesystem::directory_iterator(dir_, ec)) {
+            string file = entry.path().filename().string();
+            bool shardFile = (file.rfind("items-", 0) == 0 || file.rfind("sales-", 0) == 0) &&
+                             entry.path().extension() == ".bin";
+            if (shardFile && none_of(m.shards.begin(), m.shards.end(), [&](const ShardFile& s) { return s.file == file; })) {
+                filesystem::remove(entry.path(), ec);
+            }
+        }
+    }
+
+    string dir_;
+    unsigned workers_;     ///< Threads the shard widths are planned for
+    size_t skipped_ = 0;   ///< Unchanged shards in the last checkpoint
+    vector<string> damaged_;  ///< Files the last load could not read; checkpoints are refused while set
+};
+
+unique_ptr<StorageBackend> makeShardedBackend(const string& dir, unsigned workers) {
+    return make_unique<ShardedBackend>(dir, workers);
+}
+
+/* ================= SALES EXPORT ================= */
+// Pushes persisted sales to another process (backup agent, accounting import)
+// through a file descriptor: a pipe, a socket or a file. Every backend exports
+// the same format, the rows of sales.csv without its checksum footer. When the
+// backend already stores sales that way, the file is sent byte for byte and the
+// kernel moves the data (copy_file_range, splice or sendfile) without a round
+// trip through user space; other backends' sales are formatted and buffered.
+
+/// How copyFileTo() moved the bytes.
+enum class CopyMethod { Buffered, CopyFileRange, Splice, Sendfile };
+
+const char* copyMethodName(CopyMethod method) {
+    switch (method) {
+    case CopyMethod::CopyFileRange: return "copy_file_range";
+    case CopyMethod::Splice: return "splice";
+    case CopyMethod::Sendfile: return "sendfile";
+    default: return "buffered";
+    }
+}
+
+// Writes a whole buffer to a descriptor, retrying short writes.
+static bool writeAll(int fd, const char* data, size_t size) {
+    while (size > 0) {
+#ifdef _WIN32
+        int n = _write(fd, data, static_cast<unsigned>(min<size_t>(size, 1 << 30)));
+#else
+        ssize_t n = write(fd, data, size);
+        if (n < 0 && errno == EINTR) continue;
+#endif
+        if (n <= 0) return false;
+        data += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+#ifdef __linux__
+// One zero-copy call moving up to count bytes from in at *offset to out.
+static ssize_t copyChunk(CopyMethod method, int in, off_t* offset, int out, size_t count) {
+    switch (method) {
+    case CopyMethod::CopyFileRange: {
+        loff_t from = *offset;
+        ssize_t n = copy_file_range(in, &from, out, nullptr, count, 0);
+        if (n > 0) *offset = from;
+        return n;
+    }
+    case CopyMethod::Splice: {
+        loff_t from = *offset;
+        ssize_t n = splice(in, &from, out, nullptr, count, SPLICE_F_MORE | SPLICE_F_MOVE);
+        if (n > 0) *offset = from;
+        return n;
+    }
+    default:
+        return sendfile(out, in, offset, count);
+    }
+}
+#endif
+
+/**
+ * @brief Copies a file, or its first length bytes, to a descriptor, without
+ * user-space copies where the kernel allows.
+ *
+ * On Linux the destination picks the call: copy_file_range for a regular
+ * file, splice for a pipe, sendfile for anything else (sockets, devices). If
+ * that call is not supported for this pair of descriptors (an old kernel, a
+ * file system or destination that refuses it) before any byte has moved, the
+ * buffered copy takes over. Elsewhere the copy is always buffered.
+ * @param zeroCopy False forces the buffered copy (for comparison).
+ * @param method Set to what actually moved the bytes.
+ * @param bytes Increased by the bytes written.
+ * @param length Bytes to copy from the start of the file; a shorter file is copied whole.
+ */
+bool copyFileTo(const string& path, int out, bool zeroCopy, CopyMethod& method, uint64_t& bytes,
+                uint64_t length = UINT64_MAX) {
+    FILE* in = fopen(path.c_str(), "rb");
+    if (!in) return false;
+    bool ok = true, done = false;
+    uint64_t remaining = length;
+    method = CopyMethod::Buffered;
+#ifdef __linux__
+    struct stat src, dst;
+    int fd = fileno(in);
+    if (zeroCopy && fstat(fd, &src) == 0 && fstat(out, &dst) == 0) {
+        method = S_ISREG(dst.st_mode) ? CopyMethod::CopyFileRange
+                 : S_ISFIFO(dst.st_mode) ? CopyMethod::Splice : CopyMethod::Sendfile;
+        off_t offset = 0, size = static_cast<off_t>(min<uint64_t>(static_cast<uint64_t>(src.st_size), length));
+        while (offset < size) {
+            ssize_t n = copyChunk(method, fd, &offset, out, static_cast<size_t>(min<off_t>(size - offset, 1 << 30)));
+            if (n > 0) continue;
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0 && offset == 0 && method == CopyMethod::CopyFileRange) {
+                method = CopyMethod::Sendfile;  // e.g. across file systems on older kernels
+                continue;
+            }
+            if (n < 0 && offset == 0) method = CopyMethod::Buffered;  // not supported here: copy it ourselves
+            else ok = false;                                          // failed midway, or the file shrank
+            break;
+        }
+        bytes += static_cast<uint64_t>(offset);
+        done = method != CopyMethod::Buffered;
+    }
+#else
+    (void)zeroCopy;
+#endif
+    if (!done) {
+        vector<char> buffer(1 << 16);
+        size_t n;
+        while (ok && remaining > 0 &&
+               (n = fread(buffer.data(), 1, static_cast<size_t>(min<uint64_t>(buffer.size(), remaining)), in)) > 0) {
+            ok = writeAll(out, buffer.data(), n);
+            bytes += ok ? n : 0;
+            remaining -= n;
+        }
+        ok = ok && !ferror(in);
+    }
+    fclose(in);
+    return ok;
+}
+
+/// Outcome of exportSales().
+struct ExportStats {
+    uint64_t bytes = 0;                         ///< Bytes written to the destination
+    size_t files = 0;                           ///< Segment files sent whole; 0 if the sales were formatted
+    CopyMethod method = CopyMethod::Buffered;   ///< How the last segment was moved
+};
+
+// Size of a file without its checksum footer, if it ends with one.
+static uint64_t sizeWithoutFooter(const string& path) {
+    error_code ec;
+    uint64_t size = filesystem::file_size(path, ec);
+    if (ec || size < FOOTER_SIZE) return ec ? 0 : size;
+    char tail[FOOTER_SIZE];
+    FILE* f = fopen(path.c_str(), "rb");
+    bool footer = f && fseek(f, -static_cast<long>(FOOTER_SIZE), SEEK_END) == 0 &&
+                  fread(tail, 1, FOOTER_SIZE, f) == FOOTER_SIZE && memcmp(tail, "#crc32c:", 8) == 0 &&
+                  tail[FOOTER_SIZE - 1] == '\n';
+    if (f) fclose(f);
+    return footer ? size - FOOTER_SIZE : size;
+}
+
+/**
+ * @brief Writes a backend's persisted sales to a descriptor as sales.csv rows.
+ *
+ * The format is the same for every backend: one "SaleID,ItemID,ItemName,
+ * QtySold,Profit,Date" row per sale, in sale order, with no checksum footer.
+ * Files already in that format (see StorageBackend::salesSegments()) are sent
+ * through copyFileTo() up to their footer. For the others the backend is
+ * loaded and its sales are formatted, which needs the buffered path.
+ * @return false If a segment could not be read or the destination stopped accepting data.
+ */
+bool exportSales(StorageBackend& backend, int out, ExportStats& stats, bool zeroCopy = true) {
+    TraceSpan span("exportSales", "persistence");
+    vector<string> segments = backend.salesSegments();
+    if (!segments.empty()) {
+        for (const string& segment : segments) {
+            if (!copyFileTo(segment, out, zeroCopy, stats.method, stats.bytes, sizeWithoutFooter(segment))) return false;
+            ++stats.files;
+        }
+        return true;
+    }
+    InventoryStore scratch;
+    scratch.verbose = false;
+    scratch.seedWhenEmpty = false;
+    if (!backend.open()) return false;
+    backend.load(scratch);
+    // Rows are formatted in pieces on the scheduler and written in order
+    const size_t count = scratch.sales.size();
+    vector<string> pieces((count + EXPORT_GRAIN - 1) / EXPORT_GRAIN);
+    PoolText pool{scratch.strings};
+    scheduler.parallelFor(0, pieces.size(), 1, [&](size_t lo, size_t hi) {
+        for (size_t p = lo; p < hi; ++p) {
+            for (size_t i = p * EXPORT_GRAIN; i < min(count, (p + 1) * EXPORT_GRAIN); ++i) {
+                formatCsv(pieces[p], scratch.sales[i], pool);
+            }
+        }
+    });
+    stats.method = CopyMethod::Buffered;
+    for (const string& text : pieces) {
+        if (!writeAll(out, text.data(), text.size())) return false;
+        stats.bytes += text.size();
+    }
+    return true;
+}
+
+/* ================= MULTI-STORE AGGREGATION ================= */
+// Consolidates many shops' datasets: every subdirectory of a directory holds
+// one shop's items.csv and sales.csv. Shops are loaded in parallel (one scheduler
+// task per shop); each task reduces its shop to per-item totals and frees the
+// shop's store before the next one starts, so memory stays bounded.
+
+/**
+ * @brief Consolidated totals for one item across all shops.
+ */
+struct ItemAggregate {
+    string name;            ///< Item name (after mapping)
+    string size_color;      ///< Size or Color variant (after mapping)
+    int stores = 0;         ///< Shops that stock or sold the item
+    long long stock = 0;    ///< Units in stock across shops
+    double stockValue = 0;  ///< Stock valued at purchase price
+    long long unitsSold = 0;///< Units sold across shops
+    double profit = 0;      ///< Profit across shops
+};
+
+/**
+ * @brief Outcome of aggregateStores().
+ */
+struct AggregationResult {
+    vector<ItemAggregate> items;    ///< One row per consolidated item, sorted by name then variant
+    int storesLoaded = 0;           ///< Shops aggregated successfully
+    vector<string> failures;        ///< "shop: reason" for shops that could not be read
+    vector<string> warnings;        ///< "shop: ..." for shops loaded with bad rows skipped
+};
+
+// Key under which shops' items are merged.
+static inline string aggregateKey(string_view name, string_view size) {
+    string key(name);
+    key += '\x1f';
+    key += size;
+    return key;
+}
+
+/**
+ * @brief Reads a mapping table of lines "store,item_id,name,size_color".
+ *
+ * A listed item is merged under the given name and variant instead of its own,
+ * so shops that name the same product differently consolidate into one row.
+ * @return map keyed by "store/item_id".
+ */
+static unordered_map<string, pair<string, string>> loadAggregateMapping(const string& path) {
+    unordered_map<string, pair<string, string>> mapping;
+    string text;
+    if (!readFile(path, text)) return mapping;
+    istringstream in(text);
+    string line;
+    while (getline(in, line)) {
+        vector<string> data = parseCSV(trim(line));
+        if (data.size() >= 4) mapping[trim(data[0]) + "/" + trim(data[1])] = {data[2], data[3]};
+    }
+    return mapping;
+}
+
+// Loads one shop and reduces it to per-item totals keyed by aggregateKey().
+// Skipped bad rows and damaged files are summarised in warning.
+static unordered_map<string, ItemAggregate> aggregateOneStore(
+        const filesystem::path& dir, const unordered_map<string, pair<string, string>>& mapping, string& warning) {
+    TraceSpan span("aggregate store", "aggregate");
+    if (!filesystem::exists(dir / ITEMS_FILE)) throw runtime_error("no " + ITEMS_FILE);
+    InventoryStore store((dir / ITEMS_FILE).string(), (dir / SALES_FILE).string());
+    store.verbose = false;
+    store.seedWhenEmpty = false;
+    store.load();
+
+    string shop = dir.filename().string();
+    if (!store.loadIssues.empty()) {
+        const LoadIssue& first = store.loadIssues.front();
+        string where = filesystem::path(first.file).filename().string() + ":" + to_string(first.line) + ":" +
+                       to_string(first.column) + ": " + first.message;
+        warning = shop + ": " + (store.rowsSkipped ? "skipped " + to_string(store.rowsSkipped) +
+                                 " bad rows (first at " + where + ")" : where);
+    }
+    unordered_map<int, ItemAggregate*> byItemId;
+    unordered_map<string, ItemAggregate> totals;
+    auto entryFor = [&](int itemId, string_view name, string_view size) -> ItemAggregate& {
+        if (!mapping.empty()) {
+            auto mapped = mapping.find(shop + "/" + to_string(itemId));
+            if (mapped != mapping.end()) {
+                name = mapped->second.first;
+                size = mapped->second.second;
+            }
+        }
+        ItemAggregate& agg = totals[aggregateKey(name, size)];
+        if (agg.stores == 0) {
+            agg.name = string(name);
+            agg.size_color = string(size);
+            agg.stores = 1;
+        }
+        return agg;
+    };
+
+    for (const auto& item : store.items) {
+        ItemAggregate& agg = entryFor(item.id, store.strings.view(item.name), store.strings.view(item.size_color));
+        agg.stock += item.quantity;
+        agg.stockValue += item.quantity * item.purchase_price;
+        byItemId.emplace(item.id, &agg);
+    }
+    for (const auto& sale : store.sales) {
+        auto known = byItemId.find(sale.item_id);
+        // Sales of deleted items are merged by the name recorded on the sale
+        ItemAggregate& agg = known != byItemId.end() ? *known->second : entryFor(sale.item_id, sale.item_name, "");
+        agg.unitsSold += sale.quantity_sold;
+        agg.profit += sale.profit;
+    }
+    return totals;
+}
+
+/**
+ * @brief Loads every shop under a directory in parallel and merges their items.
+ *
+ * @param dir Directory whose subdirectories each hold items.csv and sales.csv.
+ * @param mappingFile Optional mapping table (see loadAggregateMapping); empty for none.
+ * @return AggregationResult Consolidated items and per-shop failures.
+ */
+AggregationResult aggregateStores(const string& dir, const string& mappingFile) {
+    TraceSpan span("aggregateStores", "aggregate");
+    AggregationResult result;
+
+    vector<filesystem::path> shops;
+    error_code ec;
+    for (const auto& entry : filesystem::directory_iterator(dir, ec)) {
+        if (entry.is_directory()) shops.push_back(entry.path());
+    }
+    if (ec) {
+        result.failures.push_back(dir + ": " + ec.message());
+        return result;
+    }
+    sort(shops.begin(), shops.end());
+
+    auto mapping = loadAggregateMapping(mappingFile);
+    vector<unordered_map<string, ItemAggregate>> perShop(shops.size());
+    vector<string> errors(shops.size()), warnings(shops.size());
+    scheduler.parallelFor(0, shops.size(), 1, [&](size_t lo, size_t hi) {
+        for (size_t i = lo; i < hi; ++i) {
+            try {
+                perShop[i] = aggregateOneStore(shops[i], mapping, warnings[i]);
+            } catch (const exception& e) {
+                errors[i] = shops[i].filename().string() + ": " + e.what();
+            }
+        }
+    });
+
+    // Merge in shop order so the report does not depend on scheduling
+    TraceSpan merge("merge", "aggregate");
+    unordered_map<string, ItemAggregate> merged;
+    for (size_t i = 0; i < shops.size(); ++i) {
+        if (!errors[i].empty()) {
+            result.failures.push_back(errors[i]);
+            continue;
+        }
+        if (!warnings[i].empty()) result.warnings.push_back(warnings[i]);
+        ++result.storesLoaded;
+        for (auto& kv : perShop[i]) {
+            ItemAggregate& agg = merged[kv.first];
+            if (agg.stores == 0) {
+                agg.name = move(kv.second.name);
+                agg.size_color = move(kv.second.size_color);
+            }
+            agg.stores += kv.second.stores;
+            agg.stock += kv.second.stock;
+            agg.stockValue += kv.second.stockValue;
+            agg.unitsSold += kv.second.unitsSold;
+            agg.profit += kv.second.profit;
+        }
+        perShop[i].clear();
+    }
+
+    result.items.reserve(merged.size());
+    for (auto& kv : merged) result.items.push_back(move(kv.second));
+    sort(result.items.begin(), result.items.end(), [](const ItemAggregate& a, const ItemAggregate& b) {
+        return a.name != b.name ? a.name < b.name : a.size_color < b.size_color;
+    });
+    return result;
+}
+
+/**
+ * @brief Writes the consolidated report as CSV with a header and a TOTAL line.
+ */
+void writeAggregateReport(const AggregationResult& result, ostream& out) {
+    out << "name,size_color,stores,stock,stock_value,units_sold,profit\n";
+    ItemAggregate total;
+    for (const auto& agg : result.items) {
+        out << agg.name << "," << agg.size_color << "," << agg.stores << "," << agg.stock << ","
+            << agg.stockValue << "," << agg.unitsSold << "," << agg.profit << "\n";
+        total.stock += agg.stock;
+        total.stockValue += agg.stockValue;
+        total.unitsSold += agg.unitsSold;
+        total.profit += agg.profit;
+    }
+    out << "TOTAL,," << result.storesLoaded << "," << total.stock << "," << total.stockValue << ","
+        << total.unitsSold << "," << total.profit << "\n";
+}
+
+/* ================= UI FUNCTIONS ================= */
+
+static const auto processStart = chrono::steady_clock::now();  ///< Set during static initialization
+static double firstPromptMs = -1;  ///< Process start to the first menu prompt; set by main()
+
+// Prints one item as the list and search screens show it.
+static void ui_printItem(const Item& item, string_view name, string_view sizeColor) {
+    string_view text[] = {name, sizeColor};
+    printRecord(cout, item, SlotText{text});
+    cout << endl;
+}
+
+// Shown after a change the backend could not record: it is live, but only a save keeps it.
+static void ui_warnNotPersisted(bool persisted) {
+    if (persisted) return;
+    cout << " [Warning] The change could not be written to " << defaultStore.backend().name()
+         << " storage. Use Save & Exit to keep it.\n";
+}
+
+void ui_addItem() {
+    TraceSpan span("ui_addItem", "ui");
+    string name, size, line;
+    int qty;
+    double buy, sell;
+
+    cin.ignore(numeric_limits<streamsize>::max(), '\n');
+
+    name = promptLine("Item name (or type 'cancel' to return): ");
+    if (isCancel(name) || trim(name).empty()) { cout << "Cancelled.\n"; return; }
+    replace(name.begin(), name.end(), ',', ' ');
+
+    size = promptLine("Size/Color (or type 'cancel' to return): ");
+    if (isCancel(size)) { cout << "Cancelled.\n"; return; }
+    replace(size.begin(), size.end(), ',', ' ');
+
+    line = promptLine("Quantity (or type 'cancel' to return): ");
+    if (isCancel(line) || !toInt(line, qty)) { cout << "Cancelled or invalid quantity.\n"; return; }
+
+    line = promptLine("Purchase price (or type 'cancel' to return): ");
+    if (isCancel(line) || !toDouble(line, buy)) { cout << "Cancelled or invalid purchase price.\n"; return; }
+
+    line = promptLine("Selling price (or type 'cancel' to return): ");
+    if (isCancel(line) || !toDouble(line, sell)) { cout << "Cancelled or invalid selling price.\n"; return; }
+
+    bool persisted = true;
+    int newId = logic_addItem(name, size, qty, buy, sell, &persisted);
+    cout << "Item added successfully! Assigned ID: " << newId << "\n";
+    ui_warnNotPersisted(persisted);
+}
+
+void ui_updateItem() {
+    TraceSpan span("ui_updateItem", "ui");
+    string line;
+    int id, qty;
+    double buy, sell;
+
+    cin.ignore(numeric_limits<streamsize>::max(), '\n');
+
+    line = promptLine("Item ID (or type 'cancel' to return): ");
+    if (isCancel(line) || !toInt(line, id)) { cout << "Cancelled or invalid ID.\n"; return; }
+
+    // Check existence visually first (optional, logic handles it too)
+    // Here we just ask for data then call logic
+    
+    line = promptLine("New quantity (or type 'cancel' to return): ");
+    if (isCancel(line) || !toInt(line, qty)) { cout << "Cancelled or invalid quantity.\n"; return; }
+
+    line = promptLine("New purchase price (or type 'cancel' to return): ");
+    if (isCancel(line) || !toDouble(line, buy)) { cout << "Cancelled or invalid purchase price.\n"; return; }
+
+    line = promptLine("New selling price (or type 'cancel' to return): ");
+    if (isCancel(line) || !toDouble(line, sell)) { cout << "Cancelled or invalid selling price.\n"; return; }
+
+    bool persisted = true;
+    if (logic_updateItem(id, qty, buy, sell, &persisted)) {
+        cout << "Item updated!\n";
+        ui_warnNotPersisted(persisted);
+    } else {
+        cout << "Item not found.\n";
+    }
+}
+
+void ui_searchItem() {
+    TraceSpan span("ui_searchItem", "ui");
+    string key;
+    cin.ignore(numeric_limits<streamsize>::max(), '\n');
+    key = promptLine("Search name (or type 'cancel' to return): ");
+    if (isCancel(key) || trim(key).empty()) { cout << "Cancelled.\n"; return; }
+
+    cout << "\n--- SEARCH RESULTS ---\n";
+    size_t matches = 0;
+    defaultStore.forEachMatch(key, [&](const Item& item, string_view name, string_view sizeColor) {
+        ui_printItem(item, name, sizeColor);
+        ++matches;
+    });
+    if (!matches) cout << "No matches found.\n";
+}
+
+void ui_lowStock() {
+    TraceSpan span("ui_lowStock", "ui");
+    string line = promptLine("Show low stock items? Press Enter to continue or type 'cancel' to return: ");
+    if (isCancel(line)) { cout << "Cancelled.\n"; return; }
+
+    cout << "\n--- LOW STOCK ITEMS ---\n";
+    bool found = false;
+    auto show = [&](const Item& item, string_view name) {
+        if (item.quantity > LOW_STOCK_THRESHOLD) return;
+        cout << name << " | Qty: " << item.quantity << " ⚠️\n";
+        found = true;
+    };
+    if (defaultStore.itemsServed()) {
+        defaultStore.forEachItem([&](const Item& item, string_view name, string_view) { show(item, name); });
+    } else {
+        for (const auto& item : items) show(item, defaultStore.strings.view(item.name));
+    }
+    if (!found) cout << "No low stock items.\n";
+
+    promptLine("Press Enter to return to menu...");
+}
+
+void ui_sellItem() {
+    TraceSpan span("ui_sellItem", "ui");
+    string line;
+    int id, qty;
+
+    cin.ignore(numeric_limits<streamsize>::max(), '\n');
+
+    line = promptLine("Item ID (or type 'cancel' to return): ");
+    if (isCancel(line) || !toInt(line, id)) { cout << "Cancelled or invalid ID.\n"; return; }
+
+    line = promptLine("Quantity sold (or type 'cancel' to return): ");
+    if (isCancel(line) || !toInt(line, qty)) { cout << "Cancelled or invalid quantity.\n"; return; }
+
+    double profit = 0.0;
+    bool persisted = true;
+    int result = logic_sellItem(id, qty, profit, &persisted);
+
+    if (result == 0) {
+        cout << "Item sold! Profit: " << profit << endl;
+        ui_warnNotPersisted(persisted);
+    } else if (result == 1) {
+        cout << "Item not found!\n";
+    } else if (result == 2) {
+        cout << "Not enough stock!\n";
+    }
+}
+
+void ui_salesHistory() {
+    TraceSpan span("ui_salesHistory", "ui");
+    string line = promptLine("Show sales history? Press Enter to continue or type 'cancel' to return: ");
+    if (isCancel(line)) { cout << "Cancelled.\n"; return; }
+
+    cout << "\n--- SALES HISTORY ---\n";
+    if (sales.empty()) {
+        cout << "No sales recorded yet.\n";
+    } else {
+        for (auto it = sales.rbegin(); it != sales.rend(); ++it) {
+            printRecord(cout, *it, PoolText{defaultStore.strings});
+            cout << endl;
+        }
+        cout << "Total profit: " << defaultStore.totalProfit() << endl;
+    }
+
+    promptLine("Press Enter to return to menu...");
+}
+
+void ui_listItems() {
+    TraceSpan span("ui_listItems", "ui");
+    cout << "\n--- ITEM LIST ---\n";
+    size_t listed = 0;
+    defaultStore.forEachItem([&](const Item& item, string_view name, string_view sizeColor) {
+        ui_printItem(item, name, sizeColor);
+        ++listed;
+    });
+    if (!listed) cout << "No items in inventory.\n";
+    promptLine("Press Enter to return to menu...");
+}
+
+void ui_checkConnection() {
+    TraceSpan span("ui_checkConnection", "ui");
+    cout << "\nChecking database connection...\n";
+    cout << " [OK] Application memory initialized.\n";
+    cout << " [OK] Item storage active (" << items.size() << " items"
+         << (defaultStore.itemsServed() ? " read in, the rest stay in " + string(defaultStore.backend().name()) + " storage"
+                                        : string())
+         << ").\n";
+    cout << " [OK] Sales storage active (" << sales.size() << " records).\n";
+    cout << " [OK] Storage backend: " << defaultStore.backend().name() << ".\n";
+    string durability = defaultStore.backend().durabilityStatus();
+    if (!durability.empty()) cout << " [OK] Journal durability: " << durability << ".\n";
+    cout << " [OK] CPU kernels: " << isaName(simd.isa) << " (detected " << isaName(detectedIsa) << ").\n";
+    cout << " [OK] Task scheduler: " << scheduler.threads() << " threads";
+    if (scheduler.pinnedWorkers()) cout << ", " << scheduler.pinnedWorkers() << " workers pinned to CPUs";
+    cout << ".\n";
+    if (defaultStore.indexesReady()) {
+        cout << " [OK] Indexes ready (built in " << defaultStore.indexBuildMs() << " ms).\n";
+    } else {
+        cout << " [..] Indexes building, searches scan the tables until then:";
+        for (const auto& index : defaultStore.indexProgress()) {
+            cout << " " << index.name << " "
+                 << (index.ready ? string("ready") : to_string(index.total ? index.done * 100 / index.total : 0) + "%");
+        }
+        cout << ".\n";
+    }
+    if (firstPromptMs >= 0) cout << " [OK] Time to first prompt: " << firstPromptMs << " ms.\n";
+    cout << "\nMemory usage:\n";
+    printMemoryUsage(collectMemoryUsage());
+    cout << "Arena: " << defaultStore.arenaUpstream().bytesInUse() << " bytes from the system (peak "
+         << defaultStore.arenaUpstream().peakBytes() << ").\n";
+    if (hugePages.hugeBlocks()) {
+        cout << "Huge pages: " << hugePages.hugeBlocks() << " large blocks advised, "
+             << hugePages.prefaultedBytes() / 1048576 << " MB prefaulted.\n";
+    }
+    if (perfEnabled) {
+        cout << "\nHardware counters (average per call):\n";
+        printPerfStats();
+    }
+    cout << "Database connection is HEALTHY (Local Mode).\n";
+    promptLine("Press Enter to return to menu...");
+}
+
+void ui_deleteItem() {
+    TraceSpan span("ui_deleteItem", "ui");
+    string line;
+    int id;
+
+    cin.ignore(numeric_limits<streamsize>::max(), '\n');
+
+    line = promptLine("Item ID to DELETE (or type 'cancel' to return): ");
+    if (isCancel(line) || !toInt(line, id)) { cout << "Cancelled or invalid ID.\n"; return; }
+
+    // Check existence first to show details before deleting
+    const Item* it = defaultStore.findItem(id);
+    if (!it) {
+        cout << "Item not found.\n";
+        return;
+    }
+
+    cout << "Deleting Item: " << defaultStore.strings.view(it->name) << " (Qty: " << it->quantity << ")\n";
+    string confirm = promptLine("Are you sure? (y/n): ");
+    if (toLowerStr(trim(confirm)) != "y") {
+        cout << "Deletion cancelled.\n";
+        return;
+    }
+
+    bool persisted = true;
+    if (logic_deleteItem(id, &persisted)) {
+        cout << "Item deleted successfully.\n";
+        ui_warnNotPersisted(persisted);
+    } else {
+        cout << "Error deleting item.\n";
+    }
+}
+
+/* ================= BENCHMARKS ================= */
+// Run with: inventory.exe --bench
+// Benchmarks work on the global store and never call saveData().
+
+static double elapsedMs(chrono::steady_clock::time_point start) {
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+static void bench_resetData() {
+    defaultStore.clear();
+}
+
+// Fills the store with nItems items and nSales single-unit sales spread over them.
+static void bench_populate(int nItems, int nSales) {
+    bench_resetData();
+    for (int i = 0; i < nItems; ++i) {
+        logic_addItem("Item " + to_string(i), (i % 3 == 0) ? "Assorted colours, large" : "Red",
+                      nSales, 1.0, 2.0);
+    }
+    double profit;
+    for (int i = 0; i < nSales; ++i) {
+        logic_sellItem(1 + i % nItems, 1, profit);
+    }
+}
+
+// Reports the memory breakdown and per-record cost of a synthetic dataset so
+// capacity regressions show up as a change in bytes per record.
+static void bench_memory() {
+    const int nItems = 10000, nSales = 100000;
+    auto start = chrono::steady_clock::now();
+    bench_populate(nItems, nSales);
+    double ms = elapsedMs(start);
+
+    vector<MemoryUsage> rows = collectMemoryUsage();
+    cout << "\n[bench] memory: " << nItems << " items, " << nSales << " sales (built in "
+         << fixed << setprecision(1) << ms << " ms)\n";
+    cout.unsetf(ios::floatfield);
+    printMemoryUsage(rows);
+    cout << "  arena: " << defaultStore.arenaUpstream().bytesInUse() << " bytes from the system\n";
+    for (const auto& r : rows) {
+        if (r.count == 0) continue;
+        cout << "  " << r.component << ": " << setprecision(4)
+             << double(r.totalBytes()) / r.count << " bytes/record ("
+             << double(r.capacity) / r.count << "x capacity)\n";
+    }
+}
+
+// Per-operation hardware counter averages for the sell and search hot paths.
+static void bench_perfCounters() {
+    cout << "\n[bench] hardware counters\n";
+    if (!perf_init()) {
+        cout << "  perf counters unavailable on this system, skipped.\n";
+        return;
+    }
+    const int nItems = 2000, nSales = 20000, nSearches = 200;
+    bench_populate(nItems, nSales);  // stock for the measured sales too, so none is rejected
+    perf_reset();
+    double profit;
+    int rejected = 0;
+    for (int i = 0; i < nSales; ++i) {
+        rejected += logic_sellItem(1 + (i * 7919) % nItems, 1, profit) != 0;
+    }
+    if (rejected) cout << "  warning: " << rejected << " sales were rejected and measured the error path\n";
+    for (int i = 0; i < nSearches; ++i) {
+        logic_searchItems(to_string(i));
+    }
+    printPerfStats();
+}
+
+// The original per-call timestamp formatter, kept as the baseline for bench_clock.
+static string bench_legacyCurrentDate() {
+    time_t now = time(0);
+    tm *ltm = localtime(&now);
+    stringstream ss;
+    ss << 1900 + ltm->tm_year << "-"
+       << setfill('0') << setw(2) << 1 + ltm->tm_mon << "-"
+       << setw(2) << ltm->tm_mday << " "
+       << setw(2) << ltm->tm_hour << ":"
+       << setw(2) << ltm->tm_min << ":"
+       << setw(2) << ltm->tm_sec;
+    return ss.str();
+}
+
+// Cost of producing a sale timestamp: time()+localtime()+stringstream versus WallClock.
+static void bench_clock() {
+    const int n = 1000000;
+    size_t sink = 0;
+
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < n; ++i) sink += bench_legacyCurrentDate().size();
+    double legacyMs = elapsedMs(start);
+
+    char text[WallClock::TEXT_SIZE];
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < n; ++i) {
+        wallClock.format(WallClock::nowNs(), text);
+        sink += text[18];
+    }
+    double clockMs = elapsedMs(start);
+
+    // Four threads hammering the shared cache
+    const int threads = 4;
+    atomic<size_t> threadSink(0);
+    start = chrono::steady_clock::now();
+    vector<thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&threadSink]() {
+            char local[WallClock::TEXT_SIZE];
+            size_t acc = 0;
+            for (int i = 0; i < n / 4; ++i) {
+                wallClock.format(WallClock::nowNs(), local);
+                acc += local[18];
+            }
+            threadSink += acc;
+        });
+    }
+    for (auto& w : workers) w.join();
+    double threadedMs = elapsedMs(start);
+
+    cout << "\n[bench] sale timestamp (" << n << " calls)\n" << fixed << setprecision(1)
+         << "  getCurrentDate (legacy): " << legacyMs * 1e6 / n << " ns/call\n"
+         << "  WallClock::format:       " << clockMs * 1e6 / n << " ns/call\n"
+         << "  WallClock, " << threads << " threads:    " << threadedMs * 1e6 / n << " ns/call"
+         << " (checksum " << sink + threadSink << ")\n";
+    cout.unsetf(ios::floatfield);
+    cout << setprecision(6);
+}
+
+// Heap allocations per sale once names are interned and sale storage is reserved.
+static void bench_sellAllocations() {
+    cout << "\n[bench] sell allocations\n";
+    if (!allocTrackingEnabled) {
+        cout << "  build with -DALLOC_TRACKING (make bench) to count allocations, skipped.\n";
+        return;
+    }
+    const int nItems = 1000, nSales = 2000;
+    bench_populate(nItems, nItems);          // warm-up: one sale per item interns every name
+    sales.reserve(sales.size() + SALES_HEADROOM);
+    double profit;
+    unsigned long long allocations;
+    {
+        ScopedAllocationCheck check("steady-state logic_sellItem");
+        for (int i = 0; i < nSales; ++i) {
+            logic_sellItem(1 + i % nItems, 1, profit);
+        }
+        allocations = check.allocations();
+    }
+    cout << "  " << nSales << " sales: " << allocations << " heap allocations ("
+         << double(allocations) / nSales << " per sale)\n";
+}
+
+// Writes nShops synthetic shop datasets under dir for the aggregation benchmark.
+static void bench_writeShops(const filesystem::path& dir, int nShops, int nItems, int nSales) {
+    filesystem::create_directories(dir);
+    for (int shop = 0; shop < nShops; ++shop) {
+        filesystem::path shopDir = dir / ("shop" + to_string(shop));
+        filesystem::create_directories(shopDir);
+        InventoryStore store((shopDir / ITEMS_FILE).string(), (shopDir / SALES_FILE).string());
+        store.verbose = false;
+        for (int i = 0; i < nItems; ++i) {
+            // Shops carry overlapping ranges of the same catalogue
+            int sku = (i + shop * 37) % (nItems * 2);
+            store.addItem("Item " + to_string(sku), sku % 2 ? "Red" : "Blue", nSales, 1.0, 2.5);
+        }
+        double profit;
+        for (int i = 0; i < nSales; ++i) store.sellItem(1 + i % nItems, 1, profit);
+        store.save();
+    }
+}
+
+// Consolidation of many shops with one worker versus one per core.
+static void bench_aggregate() {
+    const int nShops = 64, nItems = 2000, nSales = 5000;
+    filesystem::path dir = filesystem::temp_directory_path() / "inventory_bench_shops";
+    filesystem::remove_all(dir);
+    bench_writeShops(dir, nShops, nItems, nSales);
+
+    unsigned cores = max(1u, thread::hardware_concurrency());
+    unsigned configured = scheduler.threads();
+    cout << "\n[bench] aggregate " << nShops << " shops (" << nItems << " items, " << nSales << " sales each)\n";
+    for (unsigned threads : {1u, cores}) {
+        scheduler.configure(threads, scheduler.pinning());
+        auto start = chrono::steady_clock::now();
+        AggregationResult result = aggregateStores(dir.string(), "");
+        double ms = elapsedMs(start);
+        cout << "  " << threads << " thread(s): " << fixed << setprecision(1) << ms << " ms, "
+             << result.items.size() << " consolidated items\n";
+        cout.unsetf(ios::floatfield);
+        if (threads == cores) break;
+    }
+    scheduler.configure(configured, scheduler.pinning());
+    filesystem::remove_all(dir);
+}
+
+// Fork/join cost of the shared scheduler against threads started per call, and
+// how evenly it spreads a Zipfian sales-per-item rollup.
+static void bench_scheduler() {
+    const unsigned threads = scheduler.threads();
+    atomic<size_t> touched(0);
+    auto count = [&touched](size_t lo, size_t hi) { touched.fetch_add(hi - lo, memory_order_relaxed); };
+    scheduler.parallelFor(0, threads, 1, count);  // starts the workers
+    cout << "\n[bench] task scheduler (" << threads << " threads, " << scheduler.pinnedWorkers() << " pinned)\n";
+
+    // One empty task per thread, forked and joined repeatedly
+    const int rounds = 2000, spawnRounds = 200;
+    auto start = chrono::steady_clock::now();
+    for (int r = 0; r < rounds; ++r) scheduler.parallelFor(0, threads, 1, count);
+    double forkUs = elapsedMs(start) * 1000 / rounds;
+    start = chrono::steady_clock::now();
+    for (int r = 0; r < spawnRounds; ++r) {
+        vector<thread> spawned;
+        for (unsigned t = 0; t < threads; ++t) spawned.emplace_back([&count, t] { count(t, t + 1); });
+        for (auto& t : spawned) t.join();
+    }
+    double spawnUs = elapsedMs(start) * 1000 / spawnRounds;
+    const size_t tinyTasks = 1 << 18;
+    start = chrono::steady_clock::now();
+    scheduler.parallelFor(0, tinyTasks, 1, count);
+    double taskNs = elapsedMs(start) * 1e6 / tinyTasks;
+
+    // Sales per item follow Zipf (s = 1.1) with the best sellers first, as when
+    // the popular lines were entered first; each item's rollup costs its sales
+    const size_t nItems = 100000, nSales = 4000000;
+    vector<size_t> offsets(nItems + 1, 0);
+    double weightSum = 0;
+    for (size_t i = 0; i < nItems; ++i) weightSum += pow(double(i + 1), -1.1);
+    for (size_t i = 0; i < nItems; ++i) {
+        offsets[i + 1] = offsets[i] + 1 + size_t(nSales * pow(double(i + 1), -1.1) / weightSum);
+    }
+    vector<float> profit(offsets[nItems]);
+    for (size_t j = 0; j < profit.size(); ++j) profit[j] = float(j % 97) * 0.25f;
+    vector<double> rollup(nItems);
+    unique_ptr<atomic<size_t>[]> work(new atomic<size_t>[threads]);
+    auto rollupRange = [&](size_t lo, size_t hi) {
+        for (size_t i = lo; i < hi; ++i) {
+            double sum = 0;
+            for (size_t j = offsets[i]; j < offsets[i + 1]; ++j) sum += sqrt(profit[j] + 1.0);
+            rollup[i] = sum;
+        }
+        work[TaskScheduler::currentSlot()].fetch_add(offsets[hi] - offsets[lo], memory_order_relaxed);
+    };
+    auto run = [&](const char* label, size_t grain) {
+        for (unsigned t = 0; t < threads; ++t) work[t] = 0;
+        uint64_t steals = scheduler.steals();
+        auto begin = chrono::steady_clock::now();
+        scheduler.parallelFor(0, nItems, grain, rollupRange);
+        double ms = elapsedMs(begin);
+        size_t busiest = 0;
+        for (unsigned t = 0; t < threads; ++t) busiest = max(busiest, work[t].load());
+        double checksum = 0;
+        for (double v : rollup) checksum += v;
+        cout << "  " << label << fixed << setprecision(1) << ms << " ms, busiest thread did "
+             << setprecision(2) << double(busiest) * threads / offsets[nItems] << "x its share, "
+             << scheduler.steals() - steals << " steals (checksum " << setprecision(0) << checksum << ")\n";
+    };
+    cout << fixed << setprecision(2)
+         << "  fork/join of " << threads << " tasks: " << forkUs << " us on the scheduler, "
+         << spawnUs << " us starting threads per call\n"
+         << "  " << tinyTasks << " single-index tasks: " << setprecision(1) << taskNs << " ns per task"
+         << " (touched " << touched.load() << ")\n"
+         << "  Zipfian rollup, " << nItems << " items, " << offsets[nItems] << " sales:\n";
+    run("one block per thread:      ", (nItems + threads - 1) / threads);
+    run("work stealing, auto grain: ", 0);
+    cout.unsetf(ios::floatfield);
+    cout << setprecision(6);
+}
+
+// Same add/sell/update workload on every storage backend: mutation cost, checkpoint, reload, file size.
+static void bench_storageBackends() {
+    const int nItems = 2000, nSales = 10000;
+    filesystem::path dir = filesystem::temp_directory_path() / "inventory_bench_storage";
+    cout << "\n[bench] storage backends (" << nItems << " items, " << nSales << " sales, "
+         << nItems << " updates)\n";
+    for (const char* kind : {"csv", "binary", "journal", "lsm", "sharded"}) {
+        filesystem::remove_all(dir);
+        filesystem::create_directories(dir);
+        InventoryStore store;
+        store.verbose = false;
+        store.seedWhenEmpty = false;
+        store.setBackend(makeStorageBackend(kind, dir.string()));
+        store.load();
+
+        auto start = chrono::steady_clock::now();
+        for (int i = 0; i < nItems; ++i) store.addItem("Item " + to_string(i), "Blue", nSales, 1.0, 2.5);
+        double profit;
+        for (int i = 0; i < nSales; ++i) store.sellItem(1 + i % nItems, 1, profit);
+        for (int i = 0; i < nItems; ++i) store.updateItem(1 + i, nSales, 1.5, 3.0);
+        double mutateMs = elapsedMs(start);
+
+        start = chrono::steady_clock::now();
+        bool saved = store.save();
+        double saveMs = elapsedMs(start);
+
+        uintmax_t bytes = 0;
+        for (const auto& entry : filesystem::recursive_directory_iterator(dir)) {
+            if (entry.is_regular_file()) bytes += entry.file_size();
+        }
+
+        start = chrono::steady_clock::now();
+        store.load();
+        double loadMs = elapsedMs(start);
+        size_t loadedItems = 0;  // lsm leaves the items in its table, so count them through it
+        store.forEachItem([&](const Item&, string_view, string_view) { ++loadedItems; });
+
+        cout << "  " << left << setw(8) << kind << right << fixed << setprecision(1)
+             << "mutations " << setw(7) << mutateMs << " ms, checkpoint " << setw(6) << saveMs
+             << " ms, load " << setw(6) << loadMs << " ms, " << bytes / 1024 << " KB"
+             << (saved && loadedItems == size_t(nItems) && store.sales.size() == size_t(nSales) ? "" : " (MISMATCH)")
+             << "\n";
+        cout.unsetf(ios::floatfield);
+    }
+    filesystem::remove_all(dir);
+}
+
+// Generation switches of the binary snapshot vs rewriting the whole file,
+// plus the fallbacks a damaged generation or an interrupted CSV save take.
+static void bench_snapshotGenerations() {
+    const int nItems = 20000, nSales = 200000, rounds = 5;
+    filesystem::path dir = filesystem::temp_directory_path() / "inventory_bench_snapshot";
+    filesystem::remove_all(dir);
+    filesystem::create_directories(dir);
+    string path = (dir / SNAPSHOT_FILE).string();
+    cout << "\n[bench] snapshot generations (" << nItems << " items, " << nSales << " sales)\n";
+
+    InventoryStore store;
+    store.verbose = false;
+    for (int i = 0; i < nItems; ++i) store.addItem("Item " + to_string(i), "Blue", nSales, 1.0, 2.5);
+    double profit;
+    for (int i = 0; i < nSales; ++i) store.sellItem(1 + i % nItems, 1, profit);
+
+    auto start = chrono::steady_clock::now();
+    for (int r = 0; r < rounds; ++r) writeFileAtomic(path, encodeSnapshotBody(store), true);
+    double wholeMs = elapsedMs(start) / rounds;
+    filesystem::remove(path);
+    writeSnapshotFile(path, store, 0);
+    start = chrono::steady_clock::now();
+    for (int r = 0; r < rounds; ++r) writeSnapshotFile(path, store, 0);
+    double generationMs = elapsedMs(start) / rounds;
+
+    InventoryStore loaded;
+    loaded.verbose = false;
+    uint64_t lsn;
+    bool found;
+    string problem;
+    start = chrono::steady_clock::now();
+    bool ok = readSnapshotFile(path, loaded, lsn, found, problem);
+    double loadMs = elapsedMs(start);
+    ok = ok && loaded.items.size() == store.items.size() && loaded.sales.size() == store.sales.size() &&
+         loaded.nextItemId == store.nextItemId && loaded.nextSaleId == store.nextSaleId;
+    cout << fixed << setprecision(1) << "  whole-file rewrite " << wholeMs << " ms, generation switch "
+         << generationMs << " ms, load + consistency check " << loadMs << " ms, file "
+         << filesystem::file_size(path) / 1024 << " KB" << (ok ? "" : " (MISMATCH)") << "\n";
+    cout.unsetf(ios::floatfield);
+
+    // One more sale per generation, so each generation is recognisable by its sale count
+    auto damageNewest = [&](bool header) {
+        writeSnapshotFile(path, store, 0);
+        store.sellItem(1, 1, profit);
+        writeSnapshotFile(path, store, 0);
+        FILE* f = fopen(path.c_str(), "r+b");
+        vector<SnapshotHeader> headers = readSnapshotHeaders(f);
+        const SnapshotHeader& h = headers.front();
+        seekFile(f, header ? h.generation % 2 * SNAPSHOT_SLOT_SIZE + 12 : h.bodyOffset + h.bodyLength / 2);
+        fputc('!', f);
+        fclose(f);
+        loaded.clear();
+        problem.clear();
+        bool newest = readSnapshotFile(path, loaded, lsn, found, problem);
+        return !newest && loaded.sales.size() == store.sales.size() - 1;
+    };
+    bool headerFallback = damageNewest(true);
+    bool bodyFallback = damageNewest(false);
+    cout << "  damaged newest header: " << (headerFallback ? "previous generation loaded" : "FAILED")
+         << "; damaged newest body: " << (bodyFallback ? "previous generation loaded" : "FAILED") << "\n";
+
+    // A CSV save that crashed between its two renames: items.csv replaced, sales.csv.tmp left behind
+    filesystem::path older = dir / "older", newer = dir / "newer";
+    bool csvOk = true;
+    for (const auto& d : {older, newer}) {
+        filesystem::create_directories(d);
+        InventoryStore csv((d / ITEMS_FILE).string(), (d / SALES_FILE).string());
+        csv.verbose = false;
+        csv.seedWhenEmpty = false;
+        csv.addItem("Widget", "Small", 10, 5.0, 8.0);
+        if (d == newer) csv.sellItem(1, 3, profit);
+        csvOk = csvOk && csv.save();
+    }
+    filesystem::copy_file(newer / ITEMS_FILE, older / ITEMS_FILE, filesystem::copy_options::overwrite_existing);
+    filesystem::copy_file(newer / SALES_FILE, older / (SALES_FILE + ".tmp"));
+    InventoryStore csv((older / ITEMS_FILE).string(), (older / SALES_FILE).string());
+    csv.verbose = false;
+    csv.load();
+    csvOk = csvOk && csv.sales.size() == 1 && csv.items[0].quantity == 7 &&
+            !filesystem::exists(older / (SALES_FILE + ".tmp"));
+    cout << "  CSV save interrupted between renames: " << (csvOk ? "finished on load" : "FAILED") << "\n";
+    filesystem::remove_all(dir);
+}
+
+// Time until load() returns (the first prompt) with the indexes built in line
+// and in the background, and whether queries made during the build see the
+// same items as the finished indexes.
+static void bench_backgroundIndexes() {
+    const int nItems = 300000, nSales = 300000;
+    filesystem::path dir = filesystem::temp_directory_path() / "inventory_bench_indexes";
+    filesystem::remove_all(dir);
+    filesystem::create_directories(dir);
+    cout << "\n[bench] startup with background indexes (" << nItems << " items, " << nSales
+         << " sales, binary storage)\n";
+    {
+        InventoryStore store;
+        store.verbose = false;
+        store.setBackend(makeStorageBackend("binary", dir.string()));
+        for (int i = 0; i < nItems; ++i) store.addItem("Item " + to_string(nItems - i), "Blue", 10, 1.0, 2.5);
+        double profit;
+        for (int i = 0; i < nSales; ++i) store.sellItem(1 + i % nItems, 1, profit);
+        store.save();
+    }
+    for (bool background : {false, true}) {
+        InventoryStore store;
+        store.verbose = false;
+        store.backgroundIndexes = background;
+        store.setBackend(makeStorageBackend("binary", dir.string()));
+        auto start = chrono::steady_clock::now();
+        store.load();
+        double promptMs = elapsedMs(start);
+        // Queries while the build runs: scans, which must agree with the indexes afterwards
+        bool duringBuild = !store.indexesReady();
+        const Item* found = store.findItem(nItems / 2);
+        size_t inRange = store.itemsInNameRange("item 2", "item 3").size();
+        size_t byId = store.itemsInIdRange(1000, 1999).size();
+        store.waitForIndexes();
+        double readyMs = elapsedMs(start);
+        bool same = found && found->id == nItems / 2 && found == store.findItem(nItems / 2) &&
+                    inRange == store.itemsInNameRange("item 2", "item 3").size() &&
+                    byId == store.itemsInIdRange(1000, 1999).size() && byId == 1000;
+        cout << fixed << setprecision(1) << "  " << (background ? "background" : "in line   ") << "  first prompt after "
+             << setw(6) << promptMs << " ms, indexes ready after " << setw(6) << readyMs << " ms"
+             << (background ? (duringBuild ? ", queries during the build agree" : ", build finished before the first query")
+                            : "")
+             << (same ? "" : " (MISMATCH)") << "\n";
+        cout.unsetf(ios::floatfield);
+    }
+    filesystem::remove_all(dir);
+}
+
+// A shipment of updates applied one call at a time vs as one transaction, on the journal backend.
+static void bench_transactions() {
+    const int nItems = 20000;
+    filesystem::path dir = filesystem::temp_directory_path() / "inventory_bench_tx";
+    cout << "\n[bench] transactions (" << nItems << " updates)\n";
+
+    auto fresh = [&](const char* kind) {
+        filesystem::remove_all(dir);
+        filesystem::create_directories(dir);
+        auto store = make_unique<InventoryStore>();
+        store->verbose = false;
+        store->seedWhenEmpty = false;
+        store->setBackend(makeStorageBackend(kind, dir.string()));
+        store->load();
+        Transaction tx = store->begin();
+        for (int i = 0; i < nItems; ++i) tx.stageAdd("Item " + to_string(i), "Blue", 10, 1.0, 2.5);
+        tx.commit();
+        return store;
+    };
+    auto report = [](const char* label, double ms) {
+        cout << "  " << left << setw(26) << label << right << fixed << setprecision(1) << setw(8) << ms
+             << " ms (" << setprecision(0) << ms * 1e6 / nItems << " ns/update)\n";
+        cout.unsetf(ios::floatfield);
+    };
+
+    auto memory = fresh("csv");  // does not journal: the cost of the updates alone
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < nItems; ++i) memory->updateItem(1 + i, 20, 1.5, 3.0);
+    report("in memory only", elapsedMs(start));
+    memory.reset();
+
+    auto single = fresh("journal");
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < nItems; ++i) single->updateItem(1 + i, 20, 1.5, 3.0);
+    report("journal, one per call", elapsedMs(start));
+    single.reset();
+
+    auto batched = fresh("journal");
+    start = chrono::steady_clock::now();
+    Transaction tx = batched->begin();
+    for (int i = 0; i < nItems; ++i) tx.stageUpdate(1 + i, 20, 1.5, 3.0);
+    CommitStatus status = tx.commit();
+    report("one transaction + fsync", elapsedMs(start));
+
+    // A rejected transaction changes nothing; a committed one replays whole
+    tx.stageUpdate(1, 99, 1.5, 3.0);
+    tx.stageSell(2, 1000);
+    bool rejected = tx.commit() == CommitStatus::NotEnoughStock && tx.failedAt() == 1 &&
+                    batched->findItem(1)->quantity == 20;
+    batched.reset();
+    InventoryStore replay;
+    replay.verbose = false;
+    replay.setBackend(makeStorageBackend("journal", dir.string()));
+    replay.load();
+    bool replayed = replay.items.size() == size_t(nItems) && replay.findItem(nItems)->quantity == 20;
+    cout << "  commit " << (status == CommitStatus::Committed ? "ok" : "FAILED")
+         << ", rejected batch " << (rejected ? "left no trace" : "CHANGED THE STORE")
+         << ", journal replay " << (replayed ? "matches" : "MISMATCH") << "\n";
+    filesystem::remove_all(dir);
+}
+
+// Concurrent sellers on the journal backend under each durability mode: sales/sec,
+// how long each sale waits, and how many fsyncs group commit saves.
+static void bench_durability() {
+    const int nThreads = 4, nItems = 1000, runMs = 300;
+    const size_t maxSamples = size_t(1) << 21;
+    filesystem::path dir = filesystem::temp_directory_path() / "inventory_bench_durability";
+    cout << "\n[bench] journal durability (" << nThreads << " threads selling for " << runMs << " ms per mode, "
+         << dir.parent_path().string() << ")\n";
+    for (Durability mode : {Durability::None, Durability::Async, Durability::Group, Durability::PerOp}) {
+        filesystem::remove_all(dir);
+        filesystem::create_directories(dir);
+        InventoryStore store;
+        store.verbose = false;
+        store.seedWhenEmpty = false;
+        auto backend = make_unique<JournalBackend>((dir / JOURNAL_SNAPSHOT_FILE).string(), (dir / JOURNAL_FILE).string());
+        JournalBackend* journal = backend.get();
+        journal->setDurability(mode, 10);
+        store.setBackend(move(backend));
+        store.load();
+        Transaction tx = store.begin();
+        for (int i = 0; i < nItems; ++i) tx.stageAdd("Item " + to_string(i), "Blue", 1000000000, 1.0, 2.5);
+        tx.commit();
+        uint64_t syncsBefore = journal->syncs();
+
+        atomic<bool> stop{false};
+        vector<vector<float>> latencies(nThreads);
+        vector<thread> sellers;
+        auto start = chrono::steady_clock::now();
+        for (int t = 0; t < nThreads; ++t) {
+            sellers.emplace_back([&, t] {
+                vector<float>& samples = latencies[t];
+                samples.reserve(maxSamples);
+                double profit;
+                for (unsigned i = t; !stop.load(memory_order_relaxed); i += nThreads) {
+                    auto begin = chrono::steady_clock::now();
+                    store.sellItem(1 + i % nItems, 1, profit);
+                    float us = chrono::duration<float, micro>(chrono::steady_clock::now() - begin).count();
+                    if (samples.size() < maxSamples) samples.push_back(us);
+                }
+            });
+        }
+        this_thread::sleep_for(chrono::milliseconds(runMs));
+        stop = true;
+        for (auto& seller : sellers) seller.join();
+        double seconds = elapsedMs(start) / 1000;
+        uint64_t syncs = journal->syncs() - syncsBefore;
+
+        vector<float> all;
+        for (const auto& samples : latencies) all.insert(all.end(), samples.begin(), samples.end());
+        sort(all.begin(), all.end());
+        auto percentile = [&](double p) { return all.empty() ? 0.0f : all[min(all.size() - 1, size_t(p * all.size()))]; };
+        size_t salesMade = store.sales.size();
+        cout << "  " << left << setw(6) << durabilityName(mode) << right << fixed << setprecision(0)
+             << setw(10) << salesMade / seconds << " sales/s, latency p50 " << setprecision(1) << setw(7)
+             << percentile(0.5) << " us, p99 " << setw(8) << percentile(0.99) << " us, "
+             << syncs << " fsyncs (" << setprecision(3) << (salesMade ? double(syncs) / salesMade : 0) << "/sale)\n";
+        cout.unsetf(ios::floatfield);
+    }
+    filesystem::remove_all(dir);
+}
+
+// Heap and arena allocations made by a CSV load, per MB of input, then string heap compaction.
+static void bench_loadAllocations() {
+    const int nItems = 100000, nSales = 200000;
+    filesystem::path dir = filesystem::temp_directory_path() / "inventory_bench_load";
+    filesystem::remove_all(dir);
+    filesystem::create_directories(dir);
+    string itemsPath = (dir / ITEMS_FILE).string(), salesPath = (dir / SALES_FILE).string();
+    {
+        InventoryStore writer(itemsPath, salesPath);
+        writer.verbose = false;
+        for (int i = 0; i < nItems; ++i) {
+            writer.addItem("Catalog item " + to_string(i), i % 2 ? "Red" : "Blue", 1000, 1.25, 2.5);
+        }
+        // Sales only name the first tenth of the catalogue, which the compaction below keeps
+        double profit;
+        for (int i = 0; i < nSales; ++i) writer.sellItem(1 + i % (nItems / 10), 1, profit);
+        writer.save();
+    }
+    double mb = (filesystem::file_size(itemsPath) + filesystem::file_size(salesPath)) / 1048576.0;
+
+    InventoryStore store(itemsPath, salesPath);
+    store.verbose = false;
+    unsigned long long heapBefore = allocationCount();
+    size_t arenaBefore = store.arenaUpstream().allocations();
+    auto start = chrono::steady_clock::now();
+    store.load();
+    double loadMs = elapsedMs(start);
+    unsigned long long heap = allocationCount() - heapBefore;
+    size_t arena = store.arenaUpstream().allocations() - arenaBefore;
+
+    cout << "\n[bench] csv load (" << fixed << setprecision(1) << mb << " MB, " << nItems << " items, "
+         << nSales << " sales): " << loadMs << " ms\n";
+    if (allocTrackingEnabled) {
+        cout << "  heap allocations:  " << heap << " (" << heap / mb << " per MB)\n";
+    } else {
+        cout << "  heap allocations:  build with -DALLOC_TRACKING (make bench) to count\n";
+    }
+    cout << "  arena blocks:      " << arena << " (" << arena / mb << " per MB)\n";
+
+    // Deleting the unsold 90% of the catalogue triggers compaction, which frees their names
+    size_t heapBytes = store.strings.reservedBytes();
+    for (int id = nItems; id > nItems / 10; --id) store.deleteItem(id);  // from the back: no shifting
+    cout << "  string heap after deleting 90% of items: " << heapBytes / 1024 << " KB -> "
+         << store.strings.reservedBytes() / 1024 << " KB\n";
+    cout.unsetf(ios::floatfield);
+    filesystem::remove_all(dir);
+}
+
+// The exception-based toInt/toDouble that parseNumber replaced, as its baseline.
+static bool legacyToInt(const string& s, int& out) {
+    try {
+        size_t idx;
+        long v = stol(trim(s), &idx);
+        if (idx != trim(s).size()) return false;
+        out = static_cast<int>(v);
+        return true;
+    } catch (...) { return false; }
+}
+
+static bool legacyToDouble(const string& s, double& out) {
+    try {
+        size_t idx;
+        double v = stod(trim(s), &idx);
+        if (idx != trim(s).size()) return false;
+        out = v;
+        return true;
+    } catch (...) { return false; }
+}
+
+// Number parsing on clean and garbage-heavy input, then a CSV load full of bad rows.
+static void bench_numericParsing() {
+    const int n = 500000;
+    vector<string> clean, garbage;
+    for (int i = 0; i < n; ++i) {
+        clean.push_back(i % 2 ? to_string(i * 37) : to_string(i) + "." + to_string(i % 100));
+        const char* junk[] = {"abc", "12x", "", "99999999999", "4.5.6", " 17 "};
+        garbage.push_back(i % 3 ? string(junk[i % 6]) : to_string(i));
+    }
+    cout << "\n[bench] numeric parsing (" << n << " values)   stol/stod -> from_chars\n";
+    for (const vector<string>* input : {&clean, &garbage}) {
+        size_t legacyOk = 0, ok = 0;
+        int iv;
+        double dv;
+        auto start = chrono::steady_clock::now();
+        for (size_t i = 0; i < input->size(); ++i) {
+            legacyOk += i % 2 ? legacyToInt((*input)[i], iv) : legacyToDouble((*input)[i], dv);
+        }
+        double legacyMs = elapsedMs(start);
+        start = chrono::steady_clock::now();
+        for (size_t i = 0; i < input->size(); ++i) {
+            ok += i % 2 ? toInt((*input)[i], iv) : toDouble((*input)[i], dv);
+        }
+        double ms = elapsedMs(start);
+        cout << "  " << left << setw(14) << (input == &clean ? "clean" : "2/3 garbage") << right << fixed
+             << setprecision(1) << setw(8) << legacyMs << " ms -> " << setw(7) << ms << " ms  (accepted "
+             << legacyOk << " -> " << ok << ")\n";
+    }
+    cout.unsetf(ios::floatfield);
+
+    // A CSV load where every fourth row is bad: skipped and reported instead of aborting
+    filesystem::path dir = filesystem::temp_directory_path() / "inventory_bench_parse";
+    filesystem::remove_all(dir);
+    filesystem::create_directories(dir);
+    string text;
+    for (int i = 1; i <= 200000; ++i) {
+        text += to_string(i) + ",Item " + to_string(i) + ",Red," + (i % 4 ? to_string(i % 50) : "lots") + ",1.5,2.5\n";
+    }
+    writeFile((dir / ITEMS_FILE).string(), text);
+    InventoryStore store((dir / ITEMS_FILE).string(), (dir / SALES_FILE).string());
+    store.verbose = false;
+    store.seedWhenEmpty = false;
+    auto start = chrono::steady_clock::now();
+    store.load();
+    cout << "  csv load with 25% bad rows: " << fixed << setprecision(1) << elapsedMs(start) << " ms, "
+         << store.items.size() << " items loaded, " << store.rowsSkipped << " rows skipped\n";
+    cout.unsetf(ios::floatfield);
+    filesystem::remove_all(dir);
+}
+
+// The handwritten field parsers the schema codec replaced, as its baseline.
+static int legacyFieldToInt(string_view field) {
+    char buf[64];
+    size_t n = min(field.size(), sizeof(buf) - 1);
+    memcpy(buf, field.data(), n);
+    buf[n] = '\0';
+    char* end;
+    errno = 0;
+    long value = strtol(buf, &end, 10);
+    if (end == buf) throw invalid_argument("legacyFieldToInt");
+    if (errno == ERANGE || value < numeric_limits<int>::min() || value > numeric_limits<int>::max()) {
+        throw out_of_range("legacyFieldToInt");
+    }
+    return static_cast<int>(value);
+}
+
+static double legacyFieldToDouble(string_view field) {
+    char buf[64];
+    size_t n = min(field.size(), sizeof(buf) - 1);
+    memcpy(buf, field.data(), n);
+    buf[n] = '\0';
+    char* end;
+    errno = 0;
+    double value = strtod(buf, &end);
+    if (end == buf) throw invalid_argument("legacyFieldToDouble");
+    if (errno == ERANGE) throw out_of_range("legacyFieldToDouble");
+    return value;
+}
+
+// Generated (schema) CSV and binary codecs against the handwritten ones they replaced.
+static void bench_schemaCodec() {
+    const int n = 300000;
+    InventoryStore store;
+    store.verbose = false;
+    for (int i = 0; i < n; ++i) {
+        Item item{};
+        item.id = i + 1;
+        item.name = store.strings.intern("Catalog item " + to_string(i % 5000));
+        item.size_color = store.strings.intern(i % 2 ? "Red" : "Blue");
+        item.quantity = i % 700;
+        item.purchase_price = 1.25 + i % 100;
+        item.selling_price = 2.5 + i % 100;
+        store.items.push_back(item);
+    }
+    cout << "\n[bench] schema codec (" << n << " items)   handwritten -> generated\n";
+    auto report = [](const char* what, double handMs, double genMs, bool same) {
+        cout << "  " << left << setw(14) << what << right << fixed << setprecision(1) << setw(8) << handMs
+             << " ms -> " << setw(7) << genMs << " ms" << (same ? "" : " (MISMATCH)") << "\n";
+        cout.unsetf(ios::floatfield);
+    };
+
+    auto start = chrono::steady_clock::now();
+    ostringstream out;
+    for (const auto& item : store.items) {
+        out << item.id << "," << store.strings.view(item.name) << "," << store.strings.view(item.size_color) << ","
+            << item.quantity << "," << item.purchase_price << "," << item.selling_price << "\n";
+    }
+    string handText = out.str();
+    double handMs = elapsedMs(start);
+    start = chrono::steady_clock::now();
+    string genText;
+    PoolText pooled{store.strings};
+    for (const auto& item : store.items) formatCsv(genText, item, pooled);
+    report("csv format", handMs, elapsedMs(start), handText == genText);
+
+    string_view data[fieldCount<Item>()];
+    vector<Item> handItems, genItems;
+    handItems.reserve(n);
+    genItems.reserve(n);
+    start = chrono::steady_clock::now();
+    forEachCsvRecord(genText, data, 6, [&](const CsvRow&) {
+        Item it{};
+        it.id = legacyFieldToInt(data[0]);
+        it.name = store.strings.intern(data[1]);
+        it.size_color = store.strings.intern(data[2]);
+        it.quantity = legacyFieldToInt(data[3]);
+        it.purchase_price = legacyFieldToDouble(data[4]);
+        it.selling_price = legacyFieldToDouble(data[5]);
+        handItems.push_back(it);
+        return true;
+    });
+    handMs = elapsedMs(start);
+    start = chrono::steady_clock::now();
+    InternText interned{store.strings};
+    forEachCsvRecord(genText, data, fieldCount<Item>(), [&](const CsvRow&) {
+        Item it{};
+        parseCsv(data, it, interned);
+        genItems.push_back(it);
+        return true;
+    });
+    report("csv parse", handMs, elapsedMs(start), memcmp(handItems.data(), genItems.data(), n * sizeof(Item)) == 0);
+
+    // Binary: the old handwritten encoder, field by field, against putRecord; best of 3 into reserved buffers
+    ByteWriter hand, gen;
+    handMs = 1e9;
+    double genMs = 1e9;
+    for (int round = 0; round < 3; ++round) {
+        hand.buf.clear();
+        hand.buf.reserve(genText.size() * 2);
+        start = chrono::steady_clock::now();
+        for (const auto& item : store.items) {
+            hand.put<int32_t>(item.id);
+            hand.put<int32_t>(item.quantity);
+            hand.put<double>(item.purchase_price);
+            hand.put<double>(item.selling_price);
+            hand.putString(store.strings.view(item.name));
+            hand.putString(store.strings.view(item.size_color));
+        }
+        handMs = min(handMs, elapsedMs(start));
+        gen.buf.clear();
+        gen.buf.reserve(genText.size() * 2);
+        start = chrono::steady_clock::now();
+        for (const auto& item : store.items) putItem(gen, item, store.strings);
+        genMs = min(genMs, elapsedMs(start));
+    }
+    report("binary encode", handMs, genMs, hand.buf == gen.buf);
+}
+
+// Throughput of every kernel variant this CPU supports; `make test` checks that they agree.
+static void bench_simdKernels() {
+    cout << "\n[bench] simd kernels (detected " << isaName(detectedIsa) << ")\n";
+    vector<SimdKernels> variants;
+    for (CpuIsa isa : {CpuIsa::Scalar, CpuIsa::SSE2, CpuIsa::SSE42, CpuIsa::AVX2, CpuIsa::AVX512}) {
+        if (isa <= detectedIsa && kernelsFor(isa).isa == isa) variants.push_back(kernelsFor(isa));
+    }
+
+    // Throughput: a CSV-like buffer, a name catalogue and a sales-sized profit column
+    string csv;
+    while (csv.size() < (32u << 20)) csv += "12345,Catalog item 12345,Red,17,1.25,2.50\n";
+    vector<string> names;
+    for (int i = 0; i < 200000; ++i) names.push_back("Catalog Item " + to_string(i) + (i % 2 ? " Red" : " BLUE"));
+    vector<Sale> column(2000000);
+    for (size_t i = 0; i < column.size(); ++i) column[i].profit = static_cast<double>(i % 97) * 0.25;
+
+    cout << "  variant     csv scan GB/s  search ms  sum ms  crc32c GB/s\n";
+    vector<uint32_t> hits(4096);
+    for (const SimdKernels& k : variants) {
+        size_t structural = 0;
+        auto start = chrono::steady_clock::now();
+        for (size_t base = 0; base < csv.size(); base += hits.size()) {
+            structural += k.structuralIndex(csv.data() + base, min(hits.size(), csv.size() - base), hits.data());
+        }
+        double scanMs = elapsedMs(start);
+
+        size_t found = 0;
+        start = chrono::steady_clock::now();
+        for (const string& name : names) found += k.containsNoCase(name.data(), name.size(), "item 1999", 9);
+        double searchMs = elapsedMs(start);
+
+        start = chrono::steady_clock::now();
+        double sum = 0;
+        for (int pass = 0; pass < 5; ++pass) sum += k.sumStrided(reinterpret_cast<const char*>(&column[0].profit), column.size(), sizeof(Sale));
+        double sumMs = elapsedMs(start) / 5;
+
+        start = chrono::steady_clock::now();
+        uint32_t crc = k.crc32c(0, csv.data(), csv.size());
+        double crcMs = elapsedMs(start);
+
+        cout << "  " << left << setw(12) << isaName(k.isa) << right << fixed << setprecision(2)
+             << setw(13) << csv.size() / scanMs / 1e6 << setw(11) << searchMs << setw(8) << sumMs
+             << setw(13) << csv.size() / crcMs / 1e6
+             << "  (checksum " << structural + found + static_cast<size_t>(sum) + crc << ")\n";
+    }
+    // What verifying a loaded file's footer costs next to merely copying it once
+    string copy(csv.size(), '\0');
+    auto start = chrono::steady_clock::now();
+    memcpy(&copy[0], csv.data(), csv.size());
+    double copyMs = elapsedMs(start);
+    cout << "  memcpy of the same " << (csv.size() >> 20) << " MB: " << fixed << setprecision(2)
+         << csv.size() / copyMs / 1e6 << " GB/s (checksum " << static_cast<unsigned>(copy[copy.size() / 2]) << ")\n";
+    cout.unsetf(ios::floatfield);
+}
+
+#ifdef __linux__
+// Minor page faults taken by the calling thread so far.
+static long threadMinorFaults() {
+    rusage usage{};
+    getrusage(RUSAGE_THREAD, &usage);
+    return usage.ru_minflt;
+}
+
+// AnonHugePages of this process in KB, or -1 when /proc does not say.
+static long anonHugePagesKb() {
+    ifstream in("/proc/self/smaps_rollup");
+    string line;
+    while (getline(in, line)) {
+        if (line.rfind("AnonHugePages:", 0) == 0) return atol(line.c_str() + 14);
+    }
+    return -1;
+}
+#endif
+
+// Filling and scanning a large sales table from the default heap, from 2 MB pages, and prefaulted.
+static void bench_hugePages() {
+    const int n = 4000000;
+    cout << "\n[bench] huge pages (" << n << " sales, " << n * sizeof(Sale) / 1048576 << " MB)\n";
+#ifdef __linux__
+    string thp = "unknown";
+    {
+        ifstream in("/sys/kernel/mm/transparent_hugepage/enabled");
+        if (in) getline(in, thp);
+    }
+    cout << "  transparent_hugepage: " << thp << "\n";
+    cout << "  mode        fill ms  faults    scan ms  AnonHugePages\n";
+    const char* modes[] = {"heap", "2 MB", "prefault"};
+    for (int mode = 0; mode < 3; ++mode) {
+        HugePageResource pages;
+        pages.setPrefault(mode == 2);
+        InventoryStore store;
+        store.verbose = false;
+        if (mode > 0) store.setUpstream(&pages);
+        long hugeBefore = anonHugePagesKb();
+
+        store.sales.reserve(n);  // with prefault, populating starts here on the background thread
+        long faults = threadMinorFaults();
+        auto start = chrono::steady_clock::now();
+        for (int i = 0; i < n; ++i) {
+            store.sales.push_back(Sale{i + 1, 1 + i % 1000, "Item", 1, 1.5, {}});
+        }
+        double fillMs = elapsedMs(start);
+        faults = threadMinorFaults() - faults;
+        pages.waitForPrefault();
+
+        double profit = 0;
+        start = chrono::steady_clock::now();
+        for (int pass = 0; pass < 5; ++pass) {
+            // Strided reads touch a new page every few sales, so TLB reach dominates
+            for (int i = 0; i < n; i += 61) profit += store.sales[(size_t(i) * 7919) % n].profit;
+        }
+        double scanMs = elapsedMs(start);
+        long huge = anonHugePagesKb();
+        cout << "  " << left << setw(10) << modes[mode] << right << fixed << setprecision(1)
+             << setw(8) << fillMs << setw(9) << faults << setw(10) << scanMs;
+        cout << setw(11);
+        if (huge >= 0) cout << (huge - hugeBefore) / 1024 << " MB"; else cout << "n/a";
+        cout << "  (checksum " << profit << ")\n";
+    }
+    cout.unsetf(ios::floatfield);
+#else
+    cout << "  skipped: huge pages are only requested on Linux\n";
+#endif
+}
+
+// The original Item, with its text inline, as the "before" for bench_itemLayout.
+struct LegacyItem {
+    int id;
+    string name;
+    string size_color;
+    int quantity;
+    double purchase_price;
+    double selling_price;
+};
+
+// Hot/cold split: a stock-value scan and random sells over the old and new record layouts.
+static void bench_itemLayout() {
+    const int n = 1000000, sells = 2000000;
+    vector<LegacyItem> legacy;
+    legacy.reserve(n);
+    InventoryStore store;
+    store.verbose = false;
+    store.items.reserve(n);
+    for (int i = 0; i < n; ++i) {
+        string name = "Catalog item number " + to_string(i), size = i % 2 ? "Red" : "Blue";
+        legacy.push_back({i + 1, name, size, 100, 1.0, 2.5});
+        store.items.push_back({i + 1, 100, 1.0, 2.5, store.strings.intern(name), store.strings.intern(size)});
+    }
+
+    // PerfScope keeps the name pointers, so both are literals
+    auto timeBoth = [&](const char* what, const char* legacyWhat, auto&& onLegacy, auto&& onItems) {
+        auto start = chrono::steady_clock::now();
+        double legacyResult;
+        {
+            PerfScope perf(legacyWhat);
+            legacyResult = onLegacy();
+        }
+        double legacyMs = elapsedMs(start);
+        start = chrono::steady_clock::now();
+        double itemResult;
+        {
+            PerfScope perf(what);
+            itemResult = onItems();
+        }
+        double itemMs = elapsedMs(start);
+        cout << "  " << left << setw(12) << what << right << fixed << setprecision(2) << setw(7) << legacyMs
+             << " ms -> " << setw(7) << itemMs << " ms" << (legacyResult == itemResult ? "" : " (MISMATCH)") << "\n";
+        cout.unsetf(ios::floatfield);
+    };
+
+    cout << "\n[bench] item layout (" << n << " items): " << sizeof(LegacyItem) << "-byte records -> "
+         << sizeof(Item) << "-byte hot records\n";
+    perf_reset();
+    timeBoth("stock scan", "stock scan (legacy)",
+        [&]() { double v = 0; for (const auto& it : legacy) v += it.quantity * it.purchase_price; return v; },
+        [&]() { double v = 0; for (const auto& it : store.items) v += it.quantity * it.purchase_price; return v; });
+    // Index i * 7919 % n visits records in a cache-hostile order, like sells across a large catalog
+    timeBoth("random sell", "random sell (legacy)",
+        [&]() {
+            double profit = 0;
+            for (int i = 0; i < sells; ++i) {
+                LegacyItem& it = legacy[(i * 7919LL) % n];
+                it.quantity -= 1;
+                profit += it.selling_price - it.purchase_price;
+            }
+            return profit;
+        },
+        [&]() {
+            double profit = 0;
+            for (int i = 0; i < sells; ++i) {
+                Item& it = store.items[(i * 7919LL) % n];
+                it.quantity -= 1;
+                profit += it.selling_price - it.purchase_price;
+            }
+            return profit;
+        });
+    if (perfEnabled) printPerfStats();
+}
+
+// B+tree against std::map and a sorted vector: build, point lookups, 1000-key range scans.
+static void bench_orderedIndex() {
+    const int n = 500000, lookups = 500000, scans = 2000, span = 1000;
+    vector<int32_t> keys(n);
+    for (int i = 0; i < n; ++i) keys[i] = static_cast<int32_t>((i * 7919LL) % n) * 2;  // shuffled even keys
+    auto probe = [](int i) { return static_cast<int32_t>((i * 104729LL) % (2 * n)); };  // half hit, half miss
+    cout << "\n[bench] ordered index (" << n << " keys)\n";
+
+    auto report = [](const char* name, double buildMs, double findMs, double scanMs, size_t checksum) {
+        cout << "  " << left << setw(14) << name << right << fixed << setprecision(1)
+             << "build " << setw(6) << buildMs << " ms, lookup " << setprecision(0) << setw(4)
+             << findMs * 1e6 / lookups << " ns, range scan " << setprecision(1) << setw(5)
+             << scanMs * 1e3 / scans << " us (checksum " << checksum << ")\n";
+        cout.unsetf(ios::floatfield);
+    };
+
+    {
+        BPlusTree<int32_t> tree;
+        auto start = chrono::steady_clock::now();
+        for (int32_t k : keys) tree.insert(k, k);
+        double buildMs = elapsedMs(start);
+        size_t sum = 0;
+        start = chrono::steady_clock::now();
+        for (int i = 0; i < lookups; ++i) {
+            int32_t k = probe(i);
+            auto c = tree.lowerBound(k);
+            sum += c.valid() && c.key() == k;
+        }
+        double findMs = elapsedMs(start);
+        auto scanAll = [&]() {
+            auto scanStart = chrono::steady_clock::now();
+            for (int i = 0; i < scans; ++i) {
+                int32_t from = probe(i), to = from + 2 * span;
+                for (auto c = tree.lowerBound(from); c.valid() && c.key() <= to; c.next()) sum += c.value();
+            }
+            return elapsedMs(scanStart);
+        };
+        double scanMs = scanAll();
+        report("B+tree", buildMs, findMs, scanMs, sum);
+
+        // Bulk loading packs leaves contiguously, as loadData does
+        vector<pair<int32_t, int32_t>> sorted;
+        for (int32_t k : keys) sorted.push_back({k, k});
+        start = chrono::steady_clock::now();
+        sort(sorted.begin(), sorted.end());
+        tree.bulkLoad(sorted);
+        double bulkMs = elapsedMs(start);
+        scanMs = scanAll();
+        cout << "  B+tree (bulk) build " << fixed << setprecision(1) << setw(6) << bulkMs
+             << " ms incl. sort, range scan " << setw(5) << scanMs * 1e3 / scans << " us, "
+             << tree.nodeBytes() / 1024 << " KB of nodes\n";
+        cout.unsetf(ios::floatfield);
+
+        // Erase merges underfull nodes, so the tree shrinks with its keys
+        for (int i = 0; i < n; ++i) {
+            if (i % 10) tree.erase(keys[i]);
+        }
+        cout << "  B+tree after erasing 90%: " << tree.size() << " keys in " << tree.nodeBytes() / 1024
+             << " KB of nodes\n";
+    }
+    {
+        map<int32_t, int32_t> tree;
+        auto start = chrono::steady_clock::now();
+        for (int32_t k : keys) tree.emplace(k, k);
+        double buildMs = elapsedMs(start);
+        size_t sum = 0;
+        start = chrono::steady_clock::now();
+        for (int i = 0; i < lookups; ++i) sum += tree.count(probe(i));
+        double findMs = elapsedMs(start);
+        start = chrono::steady_clock::now();
+        for (int i = 0; i < scans; ++i) {
+            int32_t from = probe(i), to = from + 2 * span;
+            for (auto it = tree.lower_bound(from); it != tree.end() && it->first <= to; ++it) sum += it->second;
+        }
+        report("std::map", buildMs, findMs, elapsedMs(start), sum);
+    }
+    {
+        // Sorted vector: append then sort, as "sort when listing" does today
+        vector<pair<int32_t, int32_t>> sorted;
+        auto start = chrono::steady_clock::now();
+        for (int32_t k : keys) sorted.push_back({k, k});
+        sort(sorted.begin(), sorted.end());
+        double buildMs = elapsedMs(start);
+        size_t sum = 0;
+        auto lower = [&sorted](int32_t k) {
+            return lower_bound(sorted.begin(), sorted.end(), make_pair(k, numeric_limits<int32_t>::min()));
+        };
+        start = chrono::steady_clock::now();
+        for (int i = 0; i < lookups; ++i) {
+            auto it = lower(probe(i));
+            sum += it != sorted.end() && it->first == probe(i);
+        }
+        double findMs = elapsedMs(start);
+        start = chrono::steady_clock::now();
+        for (int i = 0; i < scans; ++i) {
+            int32_t from = probe(i), to = from + 2 * span;
+            for (auto it = lower(from); it != sorted.end() && it->first <= to; ++it) sum += it->second;
+        }
+        report("sorted vector", buildMs, findMs, elapsedMs(start), sum);
+    }
+}
+
+// Sharded save and load against the single-file snapshot as workers are added,
+// then a save after one sale, which should rewrite only the shards it touched.
+static void bench_sharded() {
+    const int nItems = 100000, nSales = 1000000;
+    filesystem::path dir = filesystem::temp_directory_path() / "inventory_bench_sharded";
+    filesystem::remove_all(dir);
+    filesystem::create_directories(dir);
+    cout << "\n[bench] sharded storage (" << nItems << " items, " << nSales << " sales)\n";
+
+    InventoryStore store;
+    store.verbose = false;
+    for (int i = 0; i < nItems; ++i) store.addItem("Item " + to_string(i), "Blue", nSales, 1.0, 2.5);
+    double profit;
+    for (int i = 0; i < nSales; ++i) store.sellItem(1 + i % nItems, 1, profit);
+    auto matches = [&](const InventoryStore& loaded) {
+        return loaded.items.size() == store.items.size() && loaded.sales.size() == store.sales.size() &&
+               loaded.nextItemId == store.nextItemId && loaded.nextSaleId == store.nextSaleId;
+    };
+
+    string snapshot = (dir / SNAPSHOT_FILE).string();
+    auto start = chrono::steady_clock::now();
+    bool ok = writeSnapshotFile(snapshot, store, 0);
+    double saveMs = elapsedMs(start);
+    {
+        InventoryStore loaded;
+        loaded.verbose = false;
+        uint64_t lsn;
+        bool found;
+        string problem;
+        start = chrono::steady_clock::now();
+        ok = ok && readSnapshotFile(snapshot, loaded, lsn, found, problem) && matches(loaded);
+        cout << fixed << setprecision(1) << "  single snapshot      save " << setw(6) << saveMs << " ms, load "
+             << setw(6) << elapsedMs(start) << " ms" << (ok ? "" : " (MISMATCH)") << "\n";
+    }
+
+    unsigned cores = max(1u, thread::hardware_concurrency());
+    vector<unsigned> counts;
+    for (unsigned workers : {1u, 2u, 4u, 8u}) {
+        if (workers < cores) counts.push_back(workers);
+    }
+    counts.push_back(cores);
+    for (unsigned workers : counts) {
+        filesystem::path shardDir = dir / ("w" + to_string(workers));
+        ShardedBackend backend(shardDir.string(), workers);
+        backend.open();
+        start = chrono::steady_clock::now();
+        ok = backend.checkpoint(store);
+        saveMs = elapsedMs(start);
+        InventoryStore loaded;
+        loaded.verbose = false;
+        start = chrono::steady_clock::now();
+        ok = backend.load(loaded) && ok && matches(loaded);
+        double loadMs = elapsedMs(start);
+        cout << "  " << setw(2) << workers << " workers/shards  save " << setw(6) << saveMs << " ms, load "
+             << setw(6) << loadMs << " ms" << (ok ? "" : " (MISMATCH)") << "\n";
+        if (workers == cores) {
+            store.sellItem(1, 1, profit);
+            start = chrono::steady_clock::now();
+            ok = backend.checkpoint(store);
+            cout << "  after one more sale: save " << elapsedMs(start) << " ms, " << backend.skippedShards()
+                 << " shards unchanged and skipped" << (ok ? "" : " (FAILED)") << "\n";
+        }
+    }
+    cout.unsetf(ios::floatfield);
+    filesystem::remove_all(dir);
+}
+
+// Exporting a sales segment with the kernel's zero-copy calls vs the buffered
+// copy, into a file, a pipe and a socket (the last two drained by a reader thread).
+static void bench_export() {
+    const size_t segmentBytes = 64 << 20;
+    const int rounds = 3;
+    filesystem::path dir = filesystem::temp_directory_path() / "inventory_bench_export";
+    filesystem::remove_all(dir);
+    filesystem::create_directories(dir);
+    string segment = (dir / "sales.seg").string(), target = (dir / "copy.seg").string();
+    {
+        string row = "1234567,4711,Widget,3,7.5,2026-01-04 19:39:42\n", data;
+        data.reserve(segmentBytes);
+        while (data.size() + row.size() <= segmentBytes) data += row;
+        writeFile(segment, data, true);
+    }
+    uint64_t size = filesystem::file_size(segment);
+    cout << "\n[bench] sales export (" << size / (1 << 20) << " MB segment, best of " << rounds << ")\n";
+
+    // Runs one export into the descriptor open() returns; drain(fd) runs on a reader thread if set
+    auto measure = [&](const char* label, auto open, auto drain) {
+        cout << "  " << left << setw(7) << label << right;
+        for (bool zeroCopy : {false, true}) {
+            double best = 1e300;
+            CopyMethod method = CopyMethod::Buffered;
+            bool ok = true;
+            for (int r = 0; r < rounds; ++r) {
+                int fds[2] = {-1, -1};
+                if (!open(fds)) {
+                    ok = false;
+                    break;
+                }
+                thread reader;
+                if (fds[1] >= 0) reader = thread([&, fd = fds[1]] { drain(fd); });
+                uint64_t bytes = 0;
+                auto start = chrono::steady_clock::now();
+                ok = copyFileTo(segment, fds[0], zeroCopy, method, bytes) && bytes == size && ok;
+#ifdef __linux__
+                ::close(fds[0]);
+#else
+                _close(fds[0]);
+#endif
+                if (reader.joinable()) reader.join();
+                best = min(best, elapsedMs(start));
+            }
+            cout << fixed << setprecision(2) << "  " << setw(15) << copyMethodName(method) << " "
+                 << setw(6) << (ok ? size / best / 1e6 : 0.0) << " GB/s";
+            cout.unsetf(ios::floatfield);
+        }
+        cout << "\n";
+    };
+    auto noDrain = [](int) {};
+    measure("file", [&](int* fds) {
+        FILE* f = fopen(target.c_str(), "wb");
+        if (!f) return false;
+#ifdef __linux__
+        fds[0] = dup(fileno(f));
+#else
+        fds[0] = _dup(_fileno(f));
+#endif
+        fclose(f);
+        return fds[0] >= 0;
+    }, noDrain);
+#ifdef __linux__
+    auto drain = [](int fd) {
+        vector<char> buffer(1 << 16);
+        while (read(fd, buffer.data(), buffer.size()) > 0) {}
+        ::close(fd);
+    };
+    measure("pipe", [](int* fds) {
+        int p[2];
+        if (pipe(p) != 0) return false;
+        fds[0] = p[1];
+        fds[1] = p[0];
+        return true;
+    }, drain);
+    measure("socket", [](int* fds) {
+        int p[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, p) != 0) return false;
+        fds[0] = p[0];
+        fds[1] = p[1];
+        return true;
+    }, drain);
+#endif
+    filesystem::remove_all(dir);
+}
+
+// LSM engine on its own at catalog scale: write throughput, point lookups, full scan.
+static void bench_lsm() {
+    const int nKeys = 500000, nLookups = 200000;
+    filesystem::path dir = filesystem::temp_directory_path() / "inventory_bench_lsm";
+    filesystem::remove_all(dir);
+    cout << "\n[bench] lsm engine (" << nKeys << " items)\n";
+    {
+        LsmTable table(dir.string());
+        ByteWriter w;
+        auto start = chrono::steady_clock::now();
+        for (int i = 0; i < nKeys; ++i) {
+            // Keys arrive out of order so runs overlap and compaction has work to do
+            int32_t id = 1 + static_cast<int32_t>((i * 7919LL) % nKeys);
+            Item item{id, 10, 1.0, 2.5, 0, 0};
+            w.buf.clear();
+            putItem(w, item, "Catalog item", "Blue");
+            table.put(id, w.buf);
+        }
+        double putMs = elapsedMs(start);
+
+        string value;
+        size_t hits = 0;
+        start = chrono::steady_clock::now();
+        for (int i = 0; i < nLookups; ++i) hits += table.get(1 + static_cast<int32_t>((i * 104729LL) % nKeys), value);
+        double getMs = elapsedMs(start);
+        start = chrono::steady_clock::now();
+        for (int i = 0; i < nLookups; ++i) hits += table.get(nKeys + 1 + i, value);
+        double missMs = elapsedMs(start);
+
+        size_t scanned = 0;
+        start = chrono::steady_clock::now();
+        table.scan([&scanned](int32_t, string_view) { ++scanned; });
+        double scanMs = elapsedMs(start);
+
+        cout << fixed << setprecision(2)
+             << "  put:         " << putMs * 1e3 / nKeys << " us/op (WAL + memtable, flushes included)\n"
+             << "  get (hit):   " << getMs * 1e3 / nLookups << " us/op\n"
+             << "  get (miss):  " << missMs * 1e3 / nLookups << " us/op (bloom filters)\n"
+             << "  full scan:   " << scanMs << " ms, " << scanned << " items, " << table.runCount()
+             << " run(s), " << hits << " hits\n";
+        cout.unsetf(ios::floatfield);
+        cout << setprecision(6);
+    }
+    filesystem::remove_all(dir);
+}
+
+/**
+ * @brief Runs the benchmark suite and prints the results.
+ * @return false If an allocation check failed (ALLOC_TRACKING builds), so `make bench` fails.
+ */
+bool runBenchmarks() {
+    cout << "Running benchmarks...\n";
+    bench_memory();
+    bench_perfCounters();
+    bench_sellAllocations();
+    bench_clock();
+    bench_aggregate();
+    bench_scheduler();
+    bench_storageBackends();
+    bench_snapshotGenerations();
+    bench_backgroundIndexes();
+    bench_transactions();
+    bench_durability();
+    bench_lsm();
+    bench_sharded();
+    bench_export();
+    bench_orderedIndex();
+    bench_itemLayout();
+    bench_loadAllocations();
+    bench_hugePages();
+    bench_simdKernels();
+    bench_schemaCodec();
+    bench_numericParsing();
+    bench_resetData();
+    if (allocationCheckFailures) {
+        cerr << " [Error] " << allocationCheckFailures << " allocation check(s) failed; see [AllocCheck] above.\n";
+        return false;
+    }
+    return true;
+}
+
+/* ================= MAIN MENU ================= */
+
+#ifndef UNIT_TEST
+static volatile sig_atomic_t interrupted = 0;  ///< Set by Ctrl-C or SIGTERM; the menu exits without saving
+
+static void onInterrupt(int) { interrupted = 1; }
+
+/**
+ * @brief Turns Ctrl-C and SIGTERM into a normal exit from the menu, so exit
+ *        handlers such as the trace writer still run.
+ */
+static void installInterruptHandler() {
+#ifdef __linux__
+    struct sigaction action {};
+    action.sa_handler = onInterrupt;
+    sigemptyset(&action.sa_mask);
+    // No SA_RESTART: a read blocked on the menu prompt fails and the loop sees the flag
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+#else
+    signal(SIGINT, onInterrupt);
+    signal(SIGTERM, onInterrupt);
+#endif
+}
+
+int main(int argc, char* argv[]) {
+    defaultStore.publishMetrics = true;
+    bool bench = false, useHugePages = false;
+    string metricsFile, aggregateDir, mappingFile, reportFile;
+    string storageKind = "csv", convertFrom, convertTo, durabilityMode, exportDest;
+    unsigned threads = 0, shards = 0;
+    bool pinThreads = false;
+    int metricsIntervalMs = 10000, syncIntervalMs = 100;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--bench") {
+            bench = true;
+        } else if (arg == "--perf") {
+            if (!perf_init()) cout << " [Warning] Hardware counters unavailable, --perf ignored.\n";
+        } else if (arg == "--isa" && i + 1 < argc) {
+            string isa = argv[++i];
+            if (!simd_select(isa)) {
+                cout << " [Error] This CPU has no " << isa << " kernels (detected " << isaName(detectedIsa) << ").\n";
+                return 1;
+            }
+        } else if (arg == "--strict-load") {
+            defaultStore.strictLoad = true;
+        } else if (arg == "--hugepages") {
+            useHugePages = true;
+        } else if (arg == "--prefault") {
+            useHugePages = true;
+            hugePages.setPrefault(true);
+        } else if (arg == "--trace" && i + 1 < argc) {
+            trace_enable();
+            trace_writeAtExit(argv[++i]);
+        } else if (arg == "--metrics" && i + 1 < argc) {
+            metricsFile = argv[++i];
+        } else if (arg == "--metrics-interval" && i + 1 < argc) {
+            int seconds;
+            if (toInt(argv[++i], seconds) && seconds > 0) metricsIntervalMs = seconds * 1000;
+        } else if (arg == "--aggregate" && i + 1 < argc) {
+            aggregateDir = argv[++i];
+        } else if (arg == "--map" && i + 1 < argc) {
+            mappingFile = argv[++i];
+        } else if (arg == "--report" && i + 1 < argc) {
+            reportFile = argv[++i];
+        } else if (arg == "--threads" && i + 1 < argc) {
+            int n;
+            if (toInt(argv[++i], n) && n > 0) threads = n;
+        } else if (arg == "--pin-threads") {
+            pinThreads = true;
+        } else if (arg == "--storage" && i + 1 < argc) {
+            storageKind = argv[++i];
+        } else if (arg == "--shards" && i + 1 < argc) {
+            int n;
+            if (toInt(argv[++i], n) && n > 0) shards = n;
+        } else if (arg == "--durability" && i + 1 < argc) {
+            durabilityMode = argv[++i];
+        } else if (arg == "--sync-interval" && i + 1 < argc) {
+            int ms;
+            if (toInt(argv[++i], ms) && ms > 0) syncIntervalMs = ms;
+        } else if (arg == "--export-sales" && i + 1 < argc) {
+            exportDest = argv[++i];
+        } else if (arg == "--convert" && i + 2 < argc) {
+            convertFrom = argv[++i];
+            convertTo = argv[++i];
+        }
+    }
+    scheduler.configure(threads, pinThreads);
+    auto backendFor = [shards](const string& kind) {
+        return kind == "sharded" ? makeShardedBackend(".", shards) : makeStorageBackend(kind, ".");
+    };
+    if (!convertFrom.empty()) {
+        unique_ptr<StorageBackend> from = backendFor(convertFrom);
+        unique_ptr<StorageBackend> to = backendFor(convertTo);
+        if (!from || !to) {
+            cout << " [Error] Storage must be csv, binary, journal, lsm or sharded.\n";
+            return 1;
+        }
+        if (!convertStorage(*from, *to)) {
+            cout << " [Error] Could not convert " << convertFrom << " to " << convertTo << ".\n";
+            return 1;
+        }
+        cout << " [Saved] Converted " << convertFrom << " storage to " << convertTo << ".\n";
+        return 0;
+    }
+    if (!exportDest.empty()) {
+        // With "-" the sales go to stdout, so messages go to stderr
+        ostream& log = exportDest == "-" ? cerr : cout;
+        unique_ptr<StorageBackend> backend = backendFor(storageKind);
+        if (!backend) {
+            log << " [Error] Storage must be csv, binary, journal, lsm or sharded.\n";
+            return 1;
+        }
+        FILE* file = exportDest == "-" ? nullptr : fopen(exportDest.c_str(), "wb");
+        if (exportDest != "-" && !file) {
+            log << " [Error] Could not open " << exportDest << ".\n";
+            return 1;
+        }
+        cout.flush();
+        ExportStats stats;
+        auto start = chrono::steady_clock::now();
+        bool exported = exportSales(*backend, file ? descriptorOf(file) : descriptorOf(stdout), stats);
+        if (file) exported = fclose(file) == 0 && exported;
+        if (!exported) {
+            log << " [Error] Export of sales stopped after " << stats.bytes << " bytes.\n";
+            return 1;
+        }
+        log << " [Saved] Exported " << stats.bytes << " bytes of sales ("
+            << (stats.files ? to_string(stats.files) + " files, " + copyMethodName(stats.method) : string("formatted as CSV"))
+            << ") in " << elapsedMs(start) << " ms.\n";
+        return 0;
+    }
+    if (!aggregateDir.empty()) {
+        auto start = chrono::steady_clock::now();
+        AggregationResult result = aggregateStores(aggregateDir, mappingFile);
+        for (const auto& failure : result.failures) cout << " [Error] " << failure << "\n";
+        for (const auto& warning : result.warnings) cout << " [Warning] " << warning << "\n";
+        if (reportFile.empty()) {
+            writeAggregateReport(result, cout);
+        } else {
+            ofstream out(reportFile);
+            writeAggregateReport(result, out);
+            cout << " [Saved] Report to " << reportFile << endl;
+        }
+        cout << " [Info] Aggregated " << result.storesLoaded << " stores in "
+             << elapsedMs(start) << " ms.\n";
+        return result.failures.empty() ? 0 : 1;
+    }
+    if (bench) {
+        return runBenchmarks() ? 0 : 1;
+    }
+
+    unique_ptr<StorageBackend> backend = backendFor(storageKind);
+    if (!backend) {
+        cout << " [Error] Storage must be csv, binary, journal, lsm or sharded.\n";
+        return 1;
+    }
+    if (!durabilityMode.empty()) {
+        Durability mode;
+        if (!parseDurability(durabilityMode, mode)) {
+            cout << " [Error] Durability must be none, async, group or fsync.\n";
+            return 1;
+        }
+        if (!backend->setDurability(mode, syncIntervalMs)) {
+            cout << " [Warning] " << backend->name() << " storage has no durability modes, --durability ignored.\n";
+        }
+    }
+    defaultStore.setBackend(move(backend));
+    if (useHugePages && !defaultStore.setUpstream(&hugePages)) {
+        cout << " [Warning] Store already allocated, --hugepages ignored.\n";
+    }
+    cout << "Running in STANDALONE mode (In-Memory + " << defaultStore.backend().name() << " persistence)\n";
+    defaultStore.backgroundIndexes = true;  // the menu comes up while the indexes are built
+    if (!loadData()) return 1;
+    if (!metricsFile.empty()) metrics_startExporter(metricsFile, metricsIntervalMs);
+    installInterruptHandler();
+
+    int choice;
+    do {
+        cout << "\n===== INVENTORY MANAGER (Local Storage) =====\n";
+        cout << "1. Add Item\n";
+        cout << "2. Update Item\n";
+        cout << "3. Delete Item\n";
+        cout << "4. Search Item\n";
+        cout << "5. Low Stock Alert\n";
+        cout << "6. Sell Item\n";
+        cout << "7. Sales History\n";
+        cout << "8. List All Items\n";
+        cout << "9. Check System Status\n";
+        cout << "10. Save & Exit\n";
+        cout << "Choice: ";
+        if (firstPromptMs < 0) {
+            cout.flush();
+            firstPromptMs = elapsedMs(processStart);
+        }
+        if (!(cin >> choice)) {
+            if (cin.eof() || interrupted) break;
+            cin.clear();
+            cin.ignore(numeric_limits<streamsize>::max(), '\n');
+            choice = 0;
+        }
+
+        switch (choice) {
+        case 1: ui_addItem(); break;
+        case 2: ui_updateItem(); break;
+        case 3: ui_deleteItem(); break;
+        case 4: ui_searchItem(); break;
+        case 5: ui_lowStock(); break;
+        case 6: ui_sellItem(); break;
+        case 7: ui_salesHistory(); break;
+        case 8: ui_listItems(); break;
+        case 9: ui_checkConnection(); break;
+        case 10: saveData(); break;
+        }
+    } while (choice != 10 && !interrupted);
+
+    metrics_stopExporter();
+    if (interrupted) cout << "\n [Info] Interrupted, exiting without saving.\n";
+    return 0;
+}
+#endif
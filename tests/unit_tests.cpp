@@ -0,0 +1,317 @@
+// Unit tests for the inventory logic. Build and run with `make test`; the
+// process exits non-zero if any check fails.
+#define UNIT_TEST
+#include "../main.cpp"
+
+static int testFailures = 0;
+
+#define CHECK(cond)                                                                     \
+    do {                                                                                \
+        if (!(cond)) {                                                                  \
+            cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #cond "\n";       \
+            ++testFailures;                                                             \
+        }                                                                               \
+    } while (0)
+
+// Once names are interned and sale storage is reserved, selling stays off the
+// heap and takes no new blocks for the store's arena.
+static void test_sellDoesNotAllocate() {
+    const int nItems = 100;
+    bench_populate(nItems, nItems);  // one sale per item interns every name
+    sales.reserve(sales.size() + SALES_HEADROOM);
+    double profit;
+    int rejected = 0;
+    unsigned long long before = allocationCount();
+    size_t arenaBefore = defaultStore.arenaUpstream().allocations();
+    for (int i = 0; i < 1000; ++i) rejected += logic_sellItem(1 + i % nItems, 1, profit) != 0;
+    CHECK(rejected == 0);
+    CHECK(allocationCount() == before);
+    CHECK(defaultStore.arenaUpstream().allocations() == arenaBefore);
+}
+
+// Every kernel variant this CPU supports must agree exactly with the scalar one
+// on edge-case inputs, and the CRC32C must match its published check value.
+static void test_simdKernelsAgree() {
+    vector<SimdKernels> variants;
+    for (CpuIsa isa : {CpuIsa::Scalar, CpuIsa::SSE2, CpuIsa::SSE42, CpuIsa::AVX2, CpuIsa::AVX512}) {
+        if (isa <= detectedIsa && kernelsFor(isa).isa == isa) variants.push_back(kernelsFor(isa));
+    }
+    CHECK(!variants.empty() && variants[0].isa == CpuIsa::Scalar);
+    if (variants.empty()) return;
+    const SimdKernels& reference = variants[0];
+
+    mt19937 rng(42);
+    const char alphabet[] = "abcXYZ,\n\r \x80\xff@[`{";
+    string text(4096, ' ');
+    for (char& c : text) c = alphabet[rng() % (sizeof(alphabet) - 1)];
+    vector<double> values(4096);
+    for (double& v : values) v = ldexp(static_cast<double>(rng()) - 2147483648.0, static_cast<int>(rng() % 40) - 20);
+
+    for (const SimdKernels& k : variants) {
+        size_t structural = 0, search = 0, crc = 0, sum = 0;
+        uint32_t got[300], want[300];
+        for (size_t start = 0; start < 64; ++start) {
+            for (size_t len = 0; len < 300; len += 1 + len / 16) {
+                const char* p = text.data() + start;
+                size_t n = k.structuralIndex(p, len, got);
+                if (n != reference.structuralIndex(p, len, want) || !equal(got, got + n, want)) ++structural;
+                for (size_t m : {size_t(0), size_t(1), size_t(2), size_t(3), size_t(7), size_t(17), size_t(40)}) {
+                    // Needles cut from the text (folded), so matches are frequent
+                    string needle(text, (start * 7 + m) % 3000, m);
+                    for (char& c : needle) c = foldAscii(c);
+                    if (k.containsNoCase(p, len, needle.data(), m) != reference.containsNoCase(p, len, needle.data(), m)) ++search;
+                }
+            }
+        }
+        // CRC32C across the hardware kernel's block sizes, whole and in two pieces
+        for (size_t len : {size_t(0), size_t(9), 3 * CRC32C_SHORT - 1, 3 * CRC32C_SHORT + 5, 3 * CRC32C_LONG + 77, size_t(100000)}) {
+            string data(len, '\0');
+            for (char& c : data) c = static_cast<char>(rng());
+            size_t split = len / 3;
+            if (k.crc32c(k.crc32c(0, data.data(), split), data.data() + split, len - split) != reference.crc32c(0, data.data(), len)) ++crc;
+        }
+        if (k.crc32c(0, "123456789", 9) != 0xE3069283) ++crc;  // the published check value
+        for (size_t stride : {sizeof(double), sizeof(Item), sizeof(Sale)}) {
+            for (size_t count = 0; count * stride <= values.size() * sizeof(double) && count < 200; ++count) {
+                const char* base = reinterpret_cast<const char*>(values.data());
+                double a = k.sumStrided(base, count, stride), b = reference.sumStrided(base, count, stride);
+                if (memcmp(&a, &b, sizeof(a)) != 0) ++sum;
+            }
+        }
+        if (structural || search || crc || sum) cerr << "  kernels for " << isaName(k.isa) << " differ from scalar:\n";
+        CHECK(structural == 0);
+        CHECK(search == 0);
+        CHECK(crc == 0);
+        CHECK(sum == 0);
+    }
+}
+
+// A journaling backend whose writes always fail.
+class FailingJournal : public StorageBackend {
+public:
+    const char* name() const override { return "failing"; }
+    bool open() override { return true; }
+    bool load(InventoryStore&) override { return false; }
+    bool journals() const override { return true; }
+    bool append(const Mutation&) override { return false; }
+    bool checkpoint(const InventoryStore&) override { return true; }
+};
+
+// Changes a journal could not record are applied, but reported as not persisted.
+static void test_failedAppendIsReported() {
+    InventoryStore store;
+    store.verbose = false;
+    bool persisted = true;
+    int id = store.addItem("Widget", "Red", 10, 1.0, 2.0, &persisted);
+    CHECK(persisted);  // the CSV backend does not journal
+    store.setBackend(make_unique<FailingJournal>());
+
+    double profit;
+    persisted = true;
+    CHECK(store.sellItem(id, 1, profit, &persisted) == 0);
+    CHECK(!persisted);
+    CHECK(store.findItem(id)->quantity == 9);
+    persisted = true;
+    CHECK(store.updateItem(id, 5, 1.0, 2.0, &persisted) && !persisted);
+    persisted = true;
+    CHECK(store.addItem("Gadget", "Blue", 1, 1.0, 2.0, &persisted) > 0 && !persisted);
+    persisted = true;
+    CHECK(store.deleteItem(id, &persisted) && !persisted);
+    persisted = true;
+    CHECK(store.sellItem(id, 1, profit, &persisted) == 1);  // a rejected change records nothing
+    CHECK(persisted);
+}
+
+// A CSV that repeats an ID loads both rows, but only the first is indexed: the
+// ordered views list it once, and deleting it leaves no stale tree entry.
+static void test_repeatedIdIndexedOnce() {
+    filesystem::path dir = filesystem::temp_directory_path() / "inventory_test_repeated_id";
+    filesystem::remove_all(dir);
+    filesystem::create_directories(dir);
+    string itemsPath = (dir / ITEMS_FILE).string(), salesPath = (dir / SALES_FILE).string();
+    {
+        ofstream out(itemsPath);
+        out << "1,Anvil,Black,3,10,20\n2,Bolt,Steel,50,0.1,0.2\n1,Copy of anvil,Grey,7,10,20\n";
+    }
+    InventoryStore store(itemsPath, salesPath);
+    store.verbose = false;
+    store.seedWhenEmpty = false;
+    CHECK(store.load());
+    CHECK(store.items.size() == 3);
+    CHECK(store.findItem(1) && store.strings.view(store.findItem(1)->name) == "Anvil");
+    CHECK(store.itemsInIdRange(1, 2).size() == 2);
+    CHECK(store.itemsById().size() == 2);
+    CHECK(store.itemsInNameRange("", "").size() == 2);
+    CHECK(store.idTree.size() == 2 && store.nameTree.size() == 2);
+
+    CHECK(store.deleteItem(1));
+    CHECK(store.itemsInIdRange(1, 2).size() == 1);
+    CHECK(store.itemsInNameRange("", "").size() == 1);
+    CHECK(store.idTree.size() == 1 && store.nameTree.size() == 1);
+    CHECK(store.findItem(2) && store.findItem(2)->quantity == 50);
+    filesystem::remove_all(dir);
+}
+
+// The lsm backend serves items: a load reads none in, lookups and changes go
+// through its table one item at a time, and listings scan it.
+static void test_lsmServesItems() {
+    filesystem::path dir = filesystem::temp_directory_path() / "inventory_test_lsm_items";
+    filesystem::remove_all(dir);
+    filesystem::create_directories(dir);
+    double profit;
+    {
+        InventoryStore store;
+        store.verbose = false;
+        store.setBackend(makeStorageBackend("lsm", dir.string()));
+        CHECK(store.load() && store.items.size() == 3);  // seeded
+        CHECK(store.addItem("Lamp", "White", 4, 3, 9) == 4);
+    }
+    {
+        InventoryStore store;
+        store.verbose = false;
+        store.setBackend(makeStorageBackend("lsm", dir.string()));
+        CHECK(store.load() && store.itemsServed());
+        CHECK(store.items.empty() && store.nextItemId == 5);
+        const Item* lamp = store.findItem(4);
+        CHECK(lamp && store.strings.view(lamp->name) == "Lamp" && store.items.size() == 1);
+        CHECK(store.sellItem(4, 1, profit) == 0 && profit == 6);
+        CHECK(store.deleteItem(1) && store.updateItem(3, 7, 10, 15));
+        CHECK(!store.findItem(99) && store.sellItem(1, 1, profit) == 1);
+
+        size_t listed = 0, low = 0;
+        store.forEachItem([&](const Item& item, string_view, string_view) {
+            ++listed;
+            low += item.quantity <= LOW_STOCK_THRESHOLD;
+        });
+        CHECK(listed == 3 && low == 2);
+        string found;
+        store.forEachMatch("AMP", [&](const Item&, string_view name, string_view) { found += name; });
+        CHECK(found == "Lamp");
+        CHECK(store.itemsInNameRange("b", "g").size() == 2 && store.itemsById().size() == 3);
+    }
+    {
+        InventoryStore store;
+        store.verbose = false;
+        store.setBackend(makeStorageBackend("lsm", dir.string()));
+        CHECK(store.load() && store.items.empty() && store.sales.size() == 1);
+        CHECK(!store.findItem(1));
+        CHECK(store.findItem(3) && store.findItem(3)->quantity == 7);
+        CHECK(store.findItem(4) && store.findItem(4)->quantity == 3);
+        CHECK(store.addItem("Desk", "Oak", 1, 50, 80) == 5);
+    }
+    filesystem::remove_all(dir);
+}
+
+// A compaction that cannot write its output leaves the runs alone and is tried
+// again after the next flush.
+static void test_failedCompactionRetries() {
+    filesystem::path dir = filesystem::temp_directory_path() / "inventory_test_compaction";
+    filesystem::remove_all(dir);
+    streambuf* errors = cerr.rdbuf();
+    ostringstream log;
+    cerr.rdbuf(log.rdbuf());  // the compactor reports the failure; read only after it has stopped
+    {
+        LsmTable table(dir.string());
+        // Runs 1-4 trigger a merge into run 5, whose temporary file cannot be created
+        filesystem::create_directories(dir / "run-5.sst.tmp");
+        for (int32_t key = 1; key <= int32_t(LSM_COMPACT_RUNS); ++key) CHECK(table.put(key, "v") && table.flush());
+        this_thread::sleep_for(chrono::milliseconds(300));
+        CHECK(table.runCount() == LSM_COMPACT_RUNS);
+
+        filesystem::remove_all(dir / "run-5.sst.tmp");
+        CHECK(table.put(100, "v") && table.flush());
+        for (int i = 0; i < 500 && table.runCount() > 1; ++i) this_thread::sleep_for(chrono::milliseconds(10));
+        CHECK(table.runCount() == 1);
+        string value;
+        CHECK(table.get(1, value) && table.get(100, value) && value == "v");
+    }
+    cerr.rdbuf(errors);
+    CHECK(log.str().find("Could not compact") != string::npos);
+    filesystem::remove_all(dir);
+}
+
+// Flips the last byte of a file, inside the payload of its last log record.
+static void damageLastRecord(const filesystem::path& file) {
+    fstream f(file, ios::in | ios::out | ios::binary);
+    f.seekg(-1, ios::end);
+    char c = char(f.get() ^ 0x5a);
+    f.seekp(-1, ios::end);
+    f.put(c);
+}
+
+// Replay of the journal and of sales.log stops at the first record whose
+// checksum does not match, reports it, and cuts the log back so later
+// appends are read again.
+static void test_damagedLogRecordStopsReplay() {
+    filesystem::path dir = filesystem::temp_directory_path() / "inventory_test_log_crc";
+    filesystem::remove_all(dir);
+    filesystem::create_directories(dir);
+    filesystem::path journal = dir / JOURNAL_FILE;
+    double profit;
+    {
+        InventoryStore store;
+        store.verbose = false;
+        store.setBackend(makeStorageBackend("journal", dir.string()));
+        CHECK(store.load() && store.items.size() == 3);  // seeded
+        CHECK(store.addItem("Lamp", "White", 4, 3, 9) == 4);
+    }
+    uintmax_t whole = filesystem::file_size(journal);
+    damageLastRecord(journal);
+    {
+        InventoryStore store;
+        store.verbose = false;
+        store.setBackend(makeStorageBackend("journal", dir.string()));
+        CHECK(store.load() && store.items.size() == 3 && !store.findItem(4));
+        CHECK(store.loadIssues.size() == 1 && filesystem::file_size(journal) < whole);
+        CHECK(store.addItem("Desk", "Oak", 1, 50, 80) == 4);
+    }
+    {
+        ofstream(journal, ios::app | ios::binary).write("\0\0\0\0\0\0\0\0\0\0\0\0", 12);  // zero-filled tail
+        InventoryStore store;
+        store.verbose = false;
+        store.setBackend(makeStorageBackend("journal", dir.string()));
+        CHECK(store.load() && store.items.size() == 4 && store.loadIssues.size() == 1);
+        CHECK(store.findItem(4) && store.strings.view(store.findItem(4)->name) == "Desk");
+    }
+    filesystem::remove_all(dir);
+    filesystem::create_directories(dir);
+    {
+        InventoryStore store;
+        store.verbose = false;
+        store.setBackend(makeStorageBackend("lsm", dir.string()));
+        CHECK(store.load() && store.sellItem(1, 1, profit) == 0 && store.sellItem(2, 1, profit) == 0);
+    }
+    damageLastRecord(dir / LSM_SALES_FILE);
+    {
+        InventoryStore store;
+        store.verbose = false;
+        store.setBackend(makeStorageBackend("lsm", dir.string()));
+        CHECK(store.load() && store.sales.size() == 1 && store.loadIssues.size() == 1);
+        CHECK(store.sellItem(3, 1, profit) == 0);
+    }
+    {
+        InventoryStore store;
+        store.verbose = false;
+        store.setBackend(makeStorageBackend("lsm", dir.string()));
+        CHECK(store.load() && store.sales.size() == 2 && store.loadIssues.empty());
+        CHECK(store.sales.back().item_id == 3);
+    }
+    filesystem::remove_all(dir);
+}
+
+int main() {
+    defaultStore.verbose = false;
+    test_sellDoesNotAllocate();
+    test_simdKernelsAgree();
+    test_failedAppendIsReported();
+    test_repeatedIdIndexedOnce();
+    test_lsmServesItems();
+    test_failedCompactionRetries();
+    test_damagedLogRecordStopsReplay();
+    if (testFailures) {
+        cerr << testFailures << " check(s) failed.\n";
+        return 1;
+    }
+    cout << "All tests passed.\n";
+    return 0;
+}